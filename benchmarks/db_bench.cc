@@ -94,6 +94,10 @@ static int FLAGS_block_size = 0;
 // Negative means use default settings.
 static int FLAGS_cache_size = -1;
 
+// Number of bytes to use as a cache of point lookup results.
+// Zero means no row cache.
+static int FLAGS_row_cache_size = 0;
+
 // Maximum number of files to keep open at the same time (use default if == 0)
 static int FLAGS_open_files = 0;
 
@@ -101,6 +105,16 @@ static int FLAGS_open_files = 0;
 // Negative means use default settings.
 static int FLAGS_bloom_bits = -1;
 
+// Fraction of the write buffer used for the memtable bloom filter.
+// Zero disables the filter.
+static double FLAGS_memtable_bloom_size_ratio = 0;
+
+// Size of the blocks memtables allocate from.  Zero means use the heap.
+static int FLAGS_memtable_arena_block_size = 0;
+
+// If true, back memtable arena blocks with huge pages.
+static bool FLAGS_memtable_huge_pages = false;
+
 // If true, do not destroy the existing database.  If you set this
 // flag and also specify a benchmark that wants a fresh database, that
 // benchmark will fail.
@@ -313,6 +327,7 @@ struct ThreadState {
 class Benchmark {
  private:
   Cache* cache_;
+  Cache* row_cache_;
   const FilterPolicy* filter_policy_;
   DB* db_;
   int num_;
@@ -403,6 +418,8 @@ class Benchmark {
  public:
   Benchmark()
       : cache_(FLAGS_cache_size >= 0 ? NewLRUCache(FLAGS_cache_size) : nullptr),
+        row_cache_(FLAGS_row_cache_size > 0 ? NewLRUCache(FLAGS_row_cache_size)
+                                            : nullptr),
         filter_policy_(FLAGS_bloom_bits >= 0
                            ? NewBloomFilterPolicy(FLAGS_bloom_bits)
                            : nullptr),
@@ -427,6 +444,7 @@ class Benchmark {
   ~Benchmark() {
     delete db_;
     delete cache_;
+    delete row_cache_;
     delete filter_policy_;
   }
 
@@ -691,11 +709,15 @@ class Benchmark {
     options.env = g_env;
     options.create_if_missing = !FLAGS_use_existing_db;
     options.block_cache = cache_;
+    options.row_cache = row_cache_;
     options.write_buffer_size = FLAGS_write_buffer_size;
     options.max_file_size = FLAGS_max_file_size;
     options.block_size = FLAGS_block_size;
     options.max_open_files = FLAGS_open_files;
     options.filter_policy = filter_policy_;
+    options.memtable_bloom_size_ratio = FLAGS_memtable_bloom_size_ratio;
+    options.memtable_arena_block_size = FLAGS_memtable_arena_block_size;
+    options.memtable_huge_pages = FLAGS_memtable_huge_pages;
     options.reuse_logs = FLAGS_reuse_logs;
     Status s = DB::Open(options, FLAGS_db, &db_);
     if (!s.ok()) {
@@ -963,8 +985,19 @@ int main(int argc, char** argv) {
       FLAGS_block_size = n;
     } else if (sscanf(argv[i], "--cache_size=%d%c", &n, &junk) == 1) {
       FLAGS_cache_size = n;
+    } else if (sscanf(argv[i], "--row_cache_size=%d%c", &n, &junk) == 1) {
+      FLAGS_row_cache_size = n;
     } else if (sscanf(argv[i], "--bloom_bits=%d%c", &n, &junk) == 1) {
       FLAGS_bloom_bits = n;
+    } else if (sscanf(argv[i], "--memtable_bloom_size_ratio=%lf%c", &d,
+                      &junk) == 1) {
+      FLAGS_memtable_bloom_size_ratio = d;
+    } else if (sscanf(argv[i], "--memtable_arena_block_size=%d%c", &n,
+                      &junk) == 1) {
+      FLAGS_memtable_arena_block_size = n;
+    } else if (sscanf(argv[i], "--memtable_huge_pages=%d%c", &n, &junk) == 1 &&
+               (n == 0 || n == 1)) {
+      FLAGS_memtable_huge_pages = n;
     } else if (sscanf(argv[i], "--open_files=%d%c", &n, &junk) == 1) {
       FLAGS_open_files = n;
     } else if (strncmp(argv[i], "--db=", 5) == 0) {
@@ -0,0 +1,199 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/blob_file.h"
+
+#include "db/filename.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace leveldb {
+
+void BlobIndex::EncodeTo(std::string* dst) const {
+  PutVarint64(dst, file_number);
+  PutVarint64(dst, offset);
+  PutVarint64(dst, size);
+}
+
+bool BlobIndex::DecodeFrom(Slice input) {
+  return GetVarint64(&input, &file_number) && GetVarint64(&input, &offset) &&
+         GetVarint64(&input, &size) && input.empty();
+}
+
+BlobFileBuilder::BlobFileBuilder(WritableFile* file, uint64_t file_number)
+    : file_(file), file_number_(file_number), offset_(0), value_bytes_(0) {}
+
+Status BlobFileBuilder::Add(const Slice& key, const Slice& value,
+                            BlobIndex* index) {
+  header_.clear();
+  PutVarint32(&header_, key.size());
+  PutVarint32(&header_, value.size());
+  header_.append(key.data(), key.size());
+  PutFixed32(&header_, crc32c::Mask(crc32c::Value(value.data(), value.size())));
+  Status s = file_->Append(header_);
+  if (s.ok()) {
+    s = file_->Append(value);
+  }
+  if (s.ok()) {
+    index->file_number = file_number_;
+    index->offset = offset_ + header_.size();
+    index->size = value.size();
+    offset_ += header_.size() + value.size();
+    value_bytes_ += value.size();
+  }
+  return s;
+}
+
+static void DeleteFile(const Slice& key, void* value) {
+  delete reinterpret_cast<RandomAccessFile*>(value);
+}
+
+BlobFileCache::BlobFileCache(const std::string& dbname, Env* env, int entries)
+    : env_(env), dbname_(dbname), cache_(NewLRUCache(entries)) {}
+
+BlobFileCache::~BlobFileCache() { delete cache_; }
+
+Status BlobFileCache::FindFile(uint64_t file_number, Cache::Handle** handle) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  Slice key(buf, sizeof(buf));
+  *handle = cache_->Lookup(key);
+  if (*handle != nullptr) {
+    return Status::OK();
+  }
+  RandomAccessFile* file;
+  Status s = env_->NewRandomAccessFile(BlobFileName(dbname_, file_number),
+                                       &file);
+  if (s.ok()) {
+    *handle = cache_->Insert(key, file, 1, &DeleteFile);
+  }
+  return s;
+}
+
+Status BlobFileCache::Get(const BlobIndex& index, std::string* value) {
+  if (index.offset < 4) {
+    return Status::Corruption("bad blob index");
+  }
+  Cache::Handle* handle;
+  Status s = FindFile(index.file_number, &handle);
+  if (!s.ok()) {
+    return s;
+  }
+  RandomAccessFile* file =
+      reinterpret_cast<RandomAccessFile*>(cache_->Value(handle));
+
+  // Read the checksum along with the value.
+  const size_t n = index.size + 4;
+  char* scratch = new char[n];
+  Slice contents;
+  s = file->Read(index.offset - 4, n, &contents, scratch);
+  cache_->Release(handle);
+  if (s.ok()) {
+    if (contents.size() != n) {
+      s = Status::Corruption("truncated blob read");
+    } else if (crc32c::Unmask(DecodeFixed32(contents.data())) !=
+               crc32c::Value(contents.data() + 4, index.size)) {
+      s = Status::Corruption("blob checksum mismatch");
+    } else {
+      value->assign(contents.data() + 4, index.size);
+    }
+  }
+  delete[] scratch;
+  return s;
+}
+
+void BlobFileCache::Evict(uint64_t file_number) {
+  char buf[sizeof(file_number)];
+  EncodeFixed64(buf, file_number);
+  cache_->Erase(Slice(buf, sizeof(buf)));
+}
+
+namespace {
+// Reads a blob file front to back.
+class BlobFileReader {
+ public:
+  explicit BlobFileReader(SequentialFile* file) : file_(file), pos_(0) {}
+
+  // Make at least "n" unread bytes available unless the file ends first.
+  Status Fill(size_t n) {
+    if (pos_ > 0) {
+      buffer_.erase(0, pos_);
+      pos_ = 0;
+    }
+    char scratch[8192];
+    while (buffer_.size() < n) {
+      Slice fragment;
+      Status s = file_->Read(sizeof(scratch), &fragment, scratch);
+      if (!s.ok()) {
+        return s;
+      }
+      if (fragment.empty()) {
+        break;
+      }
+      buffer_.append(fragment.data(), fragment.size());
+    }
+    return Status::OK();
+  }
+
+  Slice Unread() const {
+    return Slice(buffer_.data() + pos_, buffer_.size() - pos_);
+  }
+  void Skip(size_t n) { pos_ += n; }
+
+ private:
+  SequentialFile* const file_;
+  std::string buffer_;
+  size_t pos_;
+};
+}  // namespace
+
+Status ReadBlobFile(Env* env, const std::string& fname, void* arg,
+                    void (*handle_record)(void*, const Slice&, const Slice&)) {
+  SequentialFile* file;
+  Status s = env->NewSequentialFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  BlobFileReader reader(file);
+  while (s.ok()) {
+    // Two varint32s take at most ten bytes.
+    s = reader.Fill(10);
+    if (!s.ok() || reader.Unread().empty()) {
+      break;
+    }
+    Slice header = reader.Unread();
+    const size_t available = header.size();
+    uint32_t key_size, value_size;
+    if (!GetVarint32(&header, &key_size) ||
+        !GetVarint32(&header, &value_size)) {
+      s = Status::Corruption(fname, "bad blob record header");
+      break;
+    }
+    reader.Skip(available - header.size());
+    const size_t body = key_size + 4 + value_size;
+    s = reader.Fill(body);
+    if (!s.ok()) {
+      break;
+    }
+    Slice record = reader.Unread();
+    if (record.size() < body) {
+      s = Status::Corruption(fname, "truncated blob record");
+      break;
+    }
+    Slice key(record.data(), key_size);
+    Slice value(record.data() + key_size + 4, value_size);
+    if (crc32c::Unmask(DecodeFixed32(record.data() + key_size)) !=
+        crc32c::Value(value.data(), value.size())) {
+      s = Status::Corruption(fname, "blob checksum mismatch");
+      break;
+    }
+    (*handle_record)(arg, key, value);
+    reader.Skip(body);
+  }
+  delete file;
+  return s;
+}
+
+}  // namespace leveldb
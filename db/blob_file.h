@@ -0,0 +1,102 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Blob files hold values that are stored apart from their keys (see
+// Options::min_blob_size).  A blob file is a sequence of records
+//
+//    record := key_size: varint32  value_size: varint32  key
+//              crc: fixed32  value
+//
+// where crc is the masked crc32c of the value.  Tables hold a blob index in
+// place of each such value, in an entry of type kTypeBlobIndex:
+//
+//    index := file_number: varint64  offset: varint64  size: varint64
+//
+// "offset" and "size" locate the value in the file.  The key is kept in
+// the record so that the file can be read without the tables.
+
+#ifndef STORAGE_LEVELDB_DB_BLOB_FILE_H_
+#define STORAGE_LEVELDB_DB_BLOB_FILE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/cache.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class WritableFile;
+
+struct BlobIndex {
+  uint64_t file_number;
+  uint64_t offset;
+  uint64_t size;
+
+  void EncodeTo(std::string* dst) const;
+  bool DecodeFrom(Slice input);
+};
+
+class BlobFileBuilder {
+ public:
+  // Append records to "file", which is blob file "file_number".  The
+  // caller keeps ownership of "file" and syncs and closes it when done.
+  BlobFileBuilder(WritableFile* file, uint64_t file_number);
+
+  BlobFileBuilder(const BlobFileBuilder&) = delete;
+  BlobFileBuilder& operator=(const BlobFileBuilder&) = delete;
+
+  // Append a record for "value" of user key "key" and store its location
+  // in *index.
+  Status Add(const Slice& key, const Slice& value, BlobIndex* index);
+
+  // Size of the file so far.
+  uint64_t FileSize() const { return offset_; }
+
+  // Combined size of the values added so far.
+  uint64_t ValueBytes() const { return value_bytes_; }
+
+ private:
+  WritableFile* const file_;
+  const uint64_t file_number_;
+  uint64_t offset_;
+  uint64_t value_bytes_;
+  std::string header_;
+};
+
+// Keeps blob files of "dbname" open for reading.
+//
+// Thread-safe (provides internal synchronization)
+class BlobFileCache {
+ public:
+  BlobFileCache(const std::string& dbname, Env* env, int entries);
+  ~BlobFileCache();
+
+  BlobFileCache(const BlobFileCache&) = delete;
+  BlobFileCache& operator=(const BlobFileCache&) = delete;
+
+  // Read the value located by "index" into *value.
+  Status Get(const BlobIndex& index, std::string* value);
+
+  // Close the specified blob file if it is open.
+  void Evict(uint64_t file_number);
+
+ private:
+  Status FindFile(uint64_t file_number, Cache::Handle** handle);
+
+  Env* const env_;
+  const std::string dbname_;
+  Cache* cache_;
+};
+
+// Call (*handle_record)(arg, key, value) for every record of the blob file
+// "fname", in file order.
+Status ReadBlobFile(Env* env, const std::string& fname, void* arg,
+                    void (*handle_record)(void*, const Slice&, const Slice&));
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BLOB_FILE_H_
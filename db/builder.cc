@@ -4,8 +4,10 @@
 
 #include "db/builder.h"
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
@@ -14,14 +16,54 @@
 
 namespace leveldb {
 
+DeletionWindow::DeletionWindow(int window, int trigger)
+    : deletions_(window > 0 ? window : 0),
+      next_(0),
+      count_(0),
+      trigger_(trigger),
+      triggered_(false) {}
+
+void DeletionWindow::Add(bool is_deletion) {
+  if (deletions_.empty() || triggered_) {
+    return;
+  }
+  if (deletions_[next_]) {
+    count_--;
+  }
+  deletions_[next_] = is_deletion;
+  if (is_deletion) {
+    count_++;
+  }
+  next_ = (next_ + 1) % deletions_.size();
+  triggered_ = (count_ >= trigger_);
+}
+
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob) {
   Status s;
   meta->file_size = 0;
+  meta->has_range_deletions = false;
+  meta->num_entries = 0;
+  meta->num_deletions = 0;
+  meta->creation_time = env->NowMicros() / 1000000;
+  meta->marked_for_compaction = false;
+  if (blob != nullptr) {
+    blob->file_size = 0;
+    blob->total_bytes = 0;
+  }
   iter->SeekToFirst();
+  if (range_del_iter != nullptr) {
+    range_del_iter->SeekToFirst();
+  }
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  std::string blob_fname;
+  WritableFile* blob_file = nullptr;
+  BlobFileBuilder* blob_builder = nullptr;
+  if (iter->Valid() ||
+      (range_del_iter != nullptr && range_del_iter->Valid())) {
     WritableFile* file;
     s = env->NewWritableFile(fname, &file);
     if (!s.ok()) {
@@ -29,11 +71,95 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     }
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    DeletionWindow window(options.deletion_compaction_window,
+                          options.deletion_compaction_trigger);
+    bool empty = true;
+    std::string blob_key, blob_index;
     for (; iter->Valid(); iter->Next()) {
       Slice key = iter->key();
+      Slice value = iter->value();
+      ParsedInternalKey ikey;
+      if (blob != nullptr && value.size() >= options.min_blob_size &&
+          ParseInternalKey(key, &ikey) && ikey.type == kTypeValue) {
+        // Keep the value in the blob file and a reference to it here.
+        if (blob_builder == nullptr) {
+          blob_fname = BlobFileName(dbname, blob->number);
+          s = env->NewWritableFile(blob_fname, &blob_file);
+          if (!s.ok()) {
+            break;
+          }
+          blob_builder = new BlobFileBuilder(blob_file, blob->number);
+        }
+        BlobIndex index;
+        s = blob_builder->Add(ikey.user_key, value, &index);
+        if (!s.ok()) {
+          break;
+        }
+        blob_key.clear();
+        AppendInternalKey(&blob_key, ParsedInternalKey(ikey.user_key,
+                                                       ikey.sequence,
+                                                       kTypeBlobIndex));
+        key = blob_key;
+        blob_index.clear();
+        index.EncodeTo(&blob_index);
+        value = blob_index;
+      }
+      if (empty) {
+        meta->smallest.DecodeFrom(key);
+        empty = false;
+      }
       meta->largest.DecodeFrom(key);
-      builder->Add(key, iter->value());
+      builder->Add(key, value);
+      meta->num_entries++;
+      const bool is_deletion = (ExtractValueType(key) == kTypeDeletion);
+      if (is_deletion) {
+        meta->num_deletions++;
+      }
+      window.Add(is_deletion);
+    }
+    for (; s.ok() && range_del_iter != nullptr && range_del_iter->Valid();
+         range_del_iter->Next()) {
+      Slice key = range_del_iter->key();
+      ParsedInternalKey start;
+      if (!ParseInternalKey(key, &start)) {
+        s = Status::Corruption("corrupted range deletion key");
+        break;
+      }
+      builder->AddRangeDeletion(key, range_del_iter->value());
+      ExtendKeyRange(
+          *static_cast<const InternalKeyComparator*>(options.comparator),
+          RangeTombstone(start.user_key, range_del_iter->value(),
+                         start.sequence),
+          empty, &meta->smallest, &meta->largest);
+      meta->has_range_deletions = true;
+      meta->num_entries++;
+      meta->num_deletions++;
+      empty = false;
+    }
+
+    if (s.ok() && blob_builder != nullptr) {
+      // The blob file must be durable before any table refers to it.
+      s = blob_file->Sync();
+      if (s.ok()) {
+        s = blob_file->Close();
+      }
+      if (s.ok()) {
+        blob->file_size = blob_builder->FileSize();
+        blob->total_bytes = blob_builder->ValueBytes();
+      }
+    }
+    delete blob_builder;
+    delete blob_file;
+
+    if (!s.ok()) {
+      builder->Abandon();
+      delete builder;
+      delete file;
+      env->RemoveFile(fname);
+      if (!blob_fname.empty()) {
+        env->RemoveFile(blob_fname);
+      }
+      return s;
     }
 
     // Finish and check for builder errors
@@ -41,6 +167,7 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     if (s.ok()) {
       meta->file_size = builder->FileSize();
       assert(meta->file_size > 0);
+      meta->marked_for_compaction = window.triggered();
     }
     delete builder;
 
@@ -72,6 +199,11 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
     // Keep it
   } else {
     env->RemoveFile(fname);
+    if (!blob_fname.empty()) {
+      env->RemoveFile(blob_fname);
+      blob->file_size = 0;
+      blob->total_bytes = 0;
+    }
   }
   return s;
 }
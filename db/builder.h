@@ -5,10 +5,14 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include <cstddef>
+#include <vector>
+
 #include "leveldb/status.h"
 
 namespace leveldb {
 
+struct BlobFileMetaData;
 struct Options;
 struct FileMetaData;
 
@@ -17,13 +21,46 @@ class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
+// Watches the entries written to a table for a run of "window"
+// consecutive entries holding at least "trigger" deletions, see
+// Options::deletion_compaction_window.  A zero "window" never triggers.
+class DeletionWindow {
+ public:
+  DeletionWindow(int window, int trigger);
+
+  // Record the next entry written to the table.
+  void Add(bool is_deletion);
+
+  // Returns true if some run of the entries recorded so far held enough
+  // deletions.
+  bool triggered() const { return triggered_; }
+
+ private:
+  std::vector<bool> deletions_;  // Ring of the last "window" entries
+  size_t next_;
+  int count_;  // Deletions in deletions_
+  int trigger_;
+  bool triggered_;
+};
+
+// Build a Table file from the contents of *iter and the range deletions
+// yielded by *range_del_iter, which may be null.  The generated file
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// If no data is present in either iterator, meta->file_size will be set
+// to zero, and no Table file will be produced.
+//
+// If "blob" is non-null, values of at least options.min_blob_size bytes
+// are written to the blob file named according to blob->number, and the
+// table refers to them.  blob->file_size and blob->total_bytes are filled
+// in; they are zero if no value went there, and no blob file is produced.
+//
+// meta->creation_time is set to the current time, and the table is
+// marked for compaction if a DeletionWindow over its entries triggers.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  Iterator* range_del_iter, FileMetaData* meta,
+                  BlobFileMetaData* blob);
 
 }  // namespace leveldb
 
@@ -13,6 +13,7 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/iterator.h"
+#include "leveldb/merge_operator.h"
 #include "leveldb/options.h"
 #include "leveldb/status.h"
 #include "leveldb/write_batch.h"
@@ -28,6 +29,7 @@ using leveldb::Iterator;
 using leveldb::kMajorVersion;
 using leveldb::kMinorVersion;
 using leveldb::Logger;
+using leveldb::MergeOperator;
 using leveldb::NewBloomFilterPolicy;
 using leveldb::NewLRUCache;
 using leveldb::Options;
@@ -137,6 +139,69 @@ struct leveldb_filterpolicy_t : public FilterPolicy {
                         const char* filter, size_t filter_length);
 };
 
+struct leveldb_mergeoperator_t : public MergeOperator {
+  ~leveldb_mergeoperator_t() override { (*destructor_)(state_); }
+
+  const char* Name() const override { return (*name_)(state_); }
+
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    const int n = static_cast<int>(operands.size());
+    std::vector<const char*> operand_pointers(n);
+    std::vector<size_t> operand_sizes(n);
+    for (int i = 0; i < n; i++) {
+      operand_pointers[i] = operands[i].data();
+      operand_sizes[i] = operands[i].size();
+    }
+    uint8_t success = 1;
+    size_t len = 0;
+    char* result = (*full_merge_)(
+        state_, key.data(), key.size(),
+        existing_value != nullptr ? existing_value->data() : nullptr,
+        existing_value != nullptr ? existing_value->size() : 0,
+        operand_pointers.data(), operand_sizes.data(), n, &success, &len);
+    return TakeResult(result, success, len, new_value);
+  }
+
+  bool PartialMerge(const Slice& key, const Slice& left, const Slice& right,
+                    std::string* new_value) const override {
+    if (partial_merge_ == nullptr) {
+      return false;
+    }
+    uint8_t success = 1;
+    size_t len = 0;
+    char* result =
+        (*partial_merge_)(state_, key.data(), key.size(), left.data(),
+                          left.size(), right.data(), right.size(), &success,
+                          &len);
+    return TakeResult(result, success, len, new_value);
+  }
+
+  static bool TakeResult(char* result, uint8_t success, size_t len,
+                         std::string* new_value) {
+    if (success && result != nullptr) {
+      new_value->assign(result, len);
+    }
+    free(result);
+    return success && result != nullptr;
+  }
+
+  void* state_;
+  void (*destructor_)(void*);
+  const char* (*name_)(void*);
+  char* (*full_merge_)(void*, const char* key, size_t key_length,
+                       const char* existing_value,
+                       size_t existing_value_length,
+                       const char* const* operands_list,
+                       const size_t* operands_list_length, int num_operands,
+                       uint8_t* success, size_t* new_value_length);
+  char* (*partial_merge_)(void*, const char* key, size_t key_length,
+                          const char* left, size_t left_length,
+                          const char* right, size_t right_length,
+                          uint8_t* success, size_t* new_value_length);
+};
+
 struct leveldb_env_t {
   Env* rep;
   bool is_default;
@@ -190,6 +255,20 @@ void leveldb_delete(leveldb_t* db, const leveldb_writeoptions_t* options,
   SaveError(errptr, db->rep->Delete(options->rep, Slice(key, keylen)));
 }
 
+void leveldb_delete_range(leveldb_t* db, const leveldb_writeoptions_t* options,
+                          const char* begin_key, size_t blen,
+                          const char* end_key, size_t elen, char** errptr) {
+  SaveError(errptr, db->rep->DeleteRange(options->rep, Slice(begin_key, blen),
+                                         Slice(end_key, elen)));
+}
+
+void leveldb_merge(leveldb_t* db, const leveldb_writeoptions_t* options,
+                   const char* key, size_t keylen, const char* val,
+                   size_t vallen, char** errptr) {
+  SaveError(errptr, db->rep->Merge(options->rep, Slice(key, keylen),
+                                   Slice(val, vallen)));
+}
+
 void leveldb_write(leveldb_t* db, const leveldb_writeoptions_t* options,
                    leveldb_writebatch_t* batch, char** errptr) {
   SaveError(errptr, db->rep->Write(options->rep, &batch->rep));
@@ -336,6 +415,17 @@ void leveldb_writebatch_delete(leveldb_writebatch_t* b, const char* key,
   b->rep.Delete(Slice(key, klen));
 }
 
+void leveldb_writebatch_delete_range(leveldb_writebatch_t* b,
+                                     const char* begin_key, size_t blen,
+                                     const char* end_key, size_t elen) {
+  b->rep.DeleteRange(Slice(begin_key, blen), Slice(end_key, elen));
+}
+
+void leveldb_writebatch_merge(leveldb_writebatch_t* b, const char* key,
+                              size_t klen, const char* val, size_t vlen) {
+  b->rep.Merge(Slice(key, klen), Slice(val, vlen));
+}
+
 void leveldb_writebatch_iterate(const leveldb_writebatch_t* b, void* state,
                                 void (*put)(void*, const char* k, size_t klen,
                                             const char* v, size_t vlen),
@@ -352,6 +442,12 @@ void leveldb_writebatch_iterate(const leveldb_writebatch_t* b, void* state,
     void Delete(const Slice& key) override {
       (*deleted_)(state_, key.data(), key.size());
     }
+    void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+      // Range deletions have no callback and are not reported.
+    }
+    void Merge(const Slice& key, const Slice& value) override {
+      // Merges have no callback and are not reported.
+    }
   };
   H handler;
   handler.state_ = state;
@@ -379,6 +475,11 @@ void leveldb_options_set_filter_policy(leveldb_options_t* opt,
   opt->rep.filter_policy = policy;
 }
 
+void leveldb_options_set_merge_operator(leveldb_options_t* opt,
+                                        leveldb_mergeoperator_t* merge_op) {
+  opt->rep.merge_operator = merge_op;
+}
+
 void leveldb_options_set_create_if_missing(leveldb_options_t* opt, uint8_t v) {
   opt->rep.create_if_missing = v;
 }
@@ -442,6 +543,32 @@ leveldb_comparator_t* leveldb_comparator_create(
 
 void leveldb_comparator_destroy(leveldb_comparator_t* cmp) { delete cmp; }
 
+leveldb_mergeoperator_t* leveldb_mergeoperator_create(
+    void* state, void (*destructor)(void*),
+    char* (*full_merge)(void*, const char* key, size_t key_length,
+                        const char* existing_value,
+                        size_t existing_value_length,
+                        const char* const* operands_list,
+                        const size_t* operands_list_length, int num_operands,
+                        uint8_t* success, size_t* new_value_length),
+    char* (*partial_merge)(void*, const char* key, size_t key_length,
+                           const char* left, size_t left_length,
+                           const char* right, size_t right_length,
+                           uint8_t* success, size_t* new_value_length),
+    const char* (*name)(void*)) {
+  leveldb_mergeoperator_t* result = new leveldb_mergeoperator_t;
+  result->state_ = state;
+  result->destructor_ = destructor;
+  result->full_merge_ = full_merge;
+  result->partial_merge_ = partial_merge;
+  result->name_ = name;
+  return result;
+}
+
+void leveldb_mergeoperator_destroy(leveldb_mergeoperator_t* merge_op) {
+  delete merge_op;
+}
+
 leveldb_filterpolicy_t* leveldb_filterpolicy_create(
     void* state, void (*destructor)(void*),
     char* (*create_filter)(void*, const char* const* key_array,
@@ -142,9 +142,39 @@ uint8_t FilterKeyMatch(void* arg, const char* key, size_t length,
   return fake_filter_result;
 }
 
+// Custom merge operator that concatenates the operands
+static void MergeDestroy(void* arg) { }
+static const char* MergeName(void* arg) {
+  return "TestMerge";
+}
+static char* MergeFull(
+    void* arg, const char* key, size_t key_length,
+    const char* existing_value, size_t existing_value_length,
+    const char* const* operands_list, const size_t* operands_list_length,
+    int num_operands, uint8_t* success, size_t* new_value_length) {
+  size_t len = existing_value_length;
+  for (int i = 0; i < num_operands; i++) {
+    len += operands_list_length[i];
+  }
+  char* result = malloc(len + 1);
+  size_t pos = 0;
+  if (existing_value != NULL) {
+    memcpy(result, existing_value, existing_value_length);
+    pos = existing_value_length;
+  }
+  for (int i = 0; i < num_operands; i++) {
+    memcpy(result + pos, operands_list[i], operands_list_length[i]);
+    pos += operands_list_length[i];
+  }
+  *success = 1;
+  *new_value_length = len;
+  return result;
+}
+
 int main(int argc, char** argv) {
   leveldb_t* db;
   leveldb_comparator_t* cmp;
+  leveldb_mergeoperator_t* merge_op;
   leveldb_cache_t* cache;
   leveldb_env_t* env;
   leveldb_options_t* options;
@@ -369,8 +399,35 @@ int main(int argc, char** argv) {
     leveldb_filterpolicy_destroy(policy);
   }
 
+  StartPhase("merge");
+  {
+    merge_op = leveldb_mergeoperator_create(NULL, MergeDestroy, MergeFull,
+                                            NULL, MergeName);
+    leveldb_close(db);
+    leveldb_destroy_db(options, dbname, &err);
+    leveldb_options_set_merge_operator(options, merge_op);
+    db = leveldb_open(options, dbname, &err);
+    CheckNoError(err);
+    leveldb_put(db, woptions, "foo", 3, "a", 1, &err);
+    CheckNoError(err);
+    leveldb_merge(db, woptions, "foo", 3, "b", 1, &err);
+    CheckNoError(err);
+    leveldb_writebatch_t* wb = leveldb_writebatch_create();
+    leveldb_writebatch_merge(wb, "foo", 3, "c", 1);
+    leveldb_writebatch_merge(wb, "bar", 3, "d", 1);
+    leveldb_write(db, woptions, wb, &err);
+    CheckNoError(err);
+    leveldb_writebatch_destroy(wb);
+    CheckGet(db, roptions, "foo", "abc");
+    CheckGet(db, roptions, "bar", "d");
+    leveldb_compact_range(db, NULL, 0, NULL, 0);
+    CheckGet(db, roptions, "foo", "abc");
+    CheckGet(db, roptions, "bar", "d");
+  }
+
   StartPhase("cleanup");
   leveldb_close(db);
+  leveldb_mergeoperator_destroy(merge_op);
   leveldb_options_destroy(options);
   leveldb_readoptions_destroy(roptions);
   leveldb_writeoptions_destroy(woptions);
@@ -8,10 +8,13 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <limits>
+#include <map>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_iter.h"
 #include "db/dbformat.h"
@@ -19,9 +22,13 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_helper.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
+#include "db/tailing_iter.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/status.h"
@@ -31,6 +38,7 @@
 #include "table/block.h"
 #include "table/merger.h"
 #include "table/two_level_iterator.h"
+#include "util/arena.h"
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -39,6 +47,8 @@ namespace leveldb {
 
 const int kNumNonTableCacheFiles = 10;
 
+const uint64_t kFileAgeCheckIntervalSeconds = 60;
+
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
@@ -57,6 +67,11 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_deletions;
+    uint64_t num_entries;    // Counting range deletions
+    uint64_t num_deletions;  // Likewise
+    uint64_t creation_time;
+    bool marked_for_compaction;
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
@@ -64,9 +79,29 @@ struct DBImpl::CompactionState {
   explicit CompactionState(Compaction* c)
       : compaction(c),
         smallest_snapshot(0),
+        covering(nullptr),
+        has_output_lower(false),
+        reserved_number(0),
+        deletion_window(0, 0),
         outfile(nullptr),
         builder(nullptr),
-        total_bytes(0) {}
+        total_bytes(0),
+        tables_hold_blob_indexes(false),
+        blob_number(0),
+        blob_outfile(nullptr),
+        blob_builder(nullptr),
+        blob_file_size(0),
+        blob_value_bytes(0) {}
+
+  ~CompactionState() { delete covering; }
+
+  // Record that the compaction drops the reference "blob_index".
+  void AddBlobGarbage(const Slice& blob_index) {
+    BlobIndex index;
+    if (index.DecodeFrom(blob_index)) {
+      blob_garbage[index.file_number] += index.size;
+    }
+  }
 
   Compaction* const compaction;
 
@@ -76,13 +111,52 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // Range deletions of the inputs that must be kept, sorted by start key.
+  // Each output keeps the parts of them that lie inside its key range.
+  std::vector<RangeTombstone> range_deletions;
+
+  // Range deletions visible to every snapshot, which hide the entries
+  // they cover for good.  nullptr if there are none.
+  RangeDelAggregator* covering;
+
+  // User key at which the current output starts, unless it is the first.
+  std::string output_lower;
+  bool has_output_lower;
+
   std::vector<Output> outputs;
 
+  // Number taken up front for the next output, or 0 if there is none.
+  uint64_t reserved_number;
+
   // State kept for output being generated
+  DeletionWindow deletion_window;
   WritableFile* outfile;
   TableBuilder* builder;
 
   uint64_t total_bytes;
+
+  // Some blob files are live, so tables may refer to them.
+  bool tables_hold_blob_indexes;
+
+  // Blob file receiving the values that the compaction moves out of the
+  // tables or out of the blob files being collected.  Opened lazily.
+  uint64_t blob_number;
+  WritableFile* blob_outfile;
+  BlobFileBuilder* blob_builder;
+  uint64_t blob_file_size;
+  uint64_t blob_value_bytes;
+
+  // Blob files whose values the compaction copies elsewhere, see
+  // Options::blob_gc_live_ratio.
+  std::set<uint64_t> blobs_to_collect;
+
+  // Bytes of blob values no longer referenced, by blob file number.
+  std::map<uint64_t, uint64_t> blob_garbage;
+
+  // Backing store for entries rewritten by PlaceCompactionValue()
+  std::string blob_key;
+  std::string blob_value;
+  std::string blob_index;
 };
 
 // Fix user-supplied options to be reasonable
@@ -98,10 +172,26 @@ Options SanitizeOptions(const std::string& dbname,
   Options result = src;
   result.comparator = icmp;
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
-  ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
+  if (result.max_open_files != -1) {
+    ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
+  }
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
+  ClipToRange(&result.max_bytes_for_level_base, 64 << 10, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  ClipToRange(&result.memtable_bloom_size_ratio, 0.0, 0.25);
+  ClipToRange(&result.blob_gc_live_ratio, 0.0, 1.0);
+  ClipToRange(&result.tiered_size_ratio, 0, 100);
+  ClipToRange(&result.tiered_max_size_amplification_percent, 1, 10000);
+  if (result.deletion_compaction_window > 0) {
+    ClipToRange(&result.deletion_compaction_trigger, 1,
+                result.deletion_compaction_window);
+  }
+  ClipToRange(&result.max_recovery_threads, 1, 64);
+  ClipToRange(&result.table_warmup_threads, 1, 64);
+  if (result.memtable_arena_block_size != 0) {
+    ClipToRange(&result.memtable_arena_block_size, 64 << 10, 256 << 20);
+  }
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -119,10 +209,30 @@ Options SanitizeOptions(const std::string& dbname,
 }
 
 static int TableCacheSize(const Options& sanitized_options) {
+  if (sanitized_options.max_open_files == -1) {
+    // Tables are never closed.
+    return std::numeric_limits<int>::max();
+  }
   // Reserve ten files or so for other uses and give the rest to TableCache.
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+static ArenaBlockPool* NewArenaBlockPool(const Options& sanitized_options) {
+  if (sanitized_options.memtable_arena_block_size == 0) {
+    return nullptr;
+  }
+  // Cache enough blocks for the mutable and the immutable memtable,
+  // counting in blocks of the size the pool hands out.
+  const size_t block_size = ArenaBlockPool::RoundBlockSize(
+      sanitized_options.memtable_arena_block_size,
+      sanitized_options.memtable_huge_pages);
+  const size_t max_cached_blocks =
+      2 * (sanitized_options.write_buffer_size / block_size + 1);
+  return new ArenaBlockPool(block_size, max_cached_blocks,
+                            sanitized_options.memtable_huge_pages,
+                            sanitized_options.memtable_numa_node);
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
@@ -133,6 +243,8 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      blob_cache_(new BlobFileCache(dbname_, env_, TableCacheSize(options_))),
+      arena_pool_(NewArenaBlockPool(options_)),
       db_lock_(nullptr),
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
@@ -143,11 +255,18 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
+      next_file_age_check_(0),
+      super_version_(nullptr),
+      super_version_number_(0),
       tmp_batch_(new WriteBatch),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)) {
+  for (SuperVersionSlot& slot : super_version_slots_) {
+    slot.sv.store(nullptr, std::memory_order_relaxed);
+  }
+}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
@@ -156,6 +275,11 @@ DBImpl::~DBImpl() {
   while (background_compaction_scheduled_) {
     background_work_finished_signal_.Wait();
   }
+  ClearSuperVersionSlots();
+  if (super_version_ != nullptr) {
+    UnrefSuperVersion(super_version_);
+    super_version_ = nullptr;
+  }
   mutex_.Unlock();
 
   if (db_lock_ != nullptr) {
@@ -169,6 +293,8 @@ DBImpl::~DBImpl() {
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete blob_cache_;
+  delete arena_pool_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -210,6 +336,12 @@ Status DBImpl::NewDB() {
   return s;
 }
 
+MemTable* DBImpl::NewMemTable() const {
+  const size_t bloom_bytes = static_cast<size_t>(
+      options_.write_buffer_size * options_.memtable_bloom_size_ratio);
+  return new MemTable(internal_comparator_, bloom_bytes, arena_pool_);
+}
+
 void DBImpl::MaybeIgnoreError(Status* s) const {
   if (s->ok() || options_.paranoid_checks) {
     // No change needed
@@ -251,6 +383,7 @@ void DBImpl::RemoveObsoleteFiles() {
           keep = (number >= versions_->ManifestFileNumber());
           break;
         case kTableFile:
+        case kBlobFile:
           keep = (live.find(number) != live.end());
           break;
         case kTempFile:
@@ -269,6 +402,8 @@ void DBImpl::RemoveObsoleteFiles() {
         files_to_delete.push_back(std::move(filename));
         if (type == kTableFile) {
           table_cache_->Evict(number);
+        } else if (type == kBlobFile) {
+          blob_cache_->Evict(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
             static_cast<unsigned long long>(number));
@@ -377,6 +512,24 @@ Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   return Status::OK();
 }
 
+// State shared by the threads that replay one log file in parallel.
+struct DBImpl::RecoveryState {
+  RecoveryState() : done(&mu), in_flight(0) {}
+
+  port::Mutex mu;
+  port::CondVar done;  // Signalled whenever a job finishes
+  int in_flight GUARDED_BY(mu);
+  Status status GUARDED_BY(mu);  // First error reported by a job
+};
+
+struct DBImpl::RecoveryJob {
+  DBImpl* db;
+  RecoveryState* state;
+  VersionEdit* edit;
+  uint64_t file_number;  // Level-0 table reserved for this job
+  std::string records;   // Length-prefixed log records, in log order
+};
+
 Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
                               bool* save_manifest, VersionEdit* edit,
                               SequenceNumber* max_sequence) {
@@ -418,12 +571,20 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   Log(options_.info_log, "Recovering log #%llu",
       (unsigned long long)log_number);
 
-  // Read all the records and add to a memtable
+  // Read all the records and add to a memtable.  With several recovery
+  // threads, each memtable's worth of records is handed to a worker that
+  // builds and flushes the memtable while this thread keeps reading.
+  const bool parallel = options_.max_recovery_threads > 1;
+  const uint64_t start_micros = env_->NowMicros();
+  uint64_t record_bytes = 0;
   std::string scratch;
   Slice record;
   WriteBatch batch;
   int compactions = 0;
   MemTable* mem = nullptr;
+  RecoveryState state;
+  RecoveryJob* job = nullptr;
+  mutex_.Unlock();
   while (reader.ReadRecord(&record, &scratch) && status.ok()) {
     if (record.size() < 12) {
       reporter.Corruption(record.size(),
@@ -431,9 +592,53 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
       continue;
     }
     WriteBatchInternal::SetContents(&batch, record);
+    record_bytes += record.size();
+    const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                    WriteBatchInternal::Count(&batch) - 1;
+    if (last_seq > *max_sequence) {
+      *max_sequence = last_seq;
+    }
+
+    if (parallel) {
+      if (job == nullptr) {
+        job = new RecoveryJob;
+        job->db = this;
+        job->state = &state;
+        job->edit = edit;
+      }
+      PutLengthPrefixedSlice(&job->records, record);
+      if (job->records.size() <= options_.write_buffer_size) {
+        continue;
+      }
+
+      {
+        MutexLock l(&state.mu);
+        while (state.in_flight >= options_.max_recovery_threads) {
+          state.done.Wait();
+        }
+        status = state.status;
+        if (status.ok()) {
+          state.in_flight++;
+        }
+      }
+      if (!status.ok()) {
+        break;
+      }
+      compactions++;
+      *save_manifest = true;
+      // Reserve the table number now so that level-0 tables are ordered
+      // like the log records they hold, whatever order they finish in.
+      mutex_.Lock();
+      job->file_number = versions_->NewFileNumber();
+      pending_outputs_.insert(job->file_number);
+      mutex_.Unlock();
+      env_->StartThread(&DBImpl::RecoveryWork, job);
+      job = nullptr;
+      continue;
+    }
 
     if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
+      mem = NewMemTable();
       mem->Ref();
     }
     status = WriteBatchInternal::InsertInto(&batch, mem);
@@ -441,16 +646,13 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (!status.ok()) {
       break;
     }
-    const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
-                                    WriteBatchInternal::Count(&batch) - 1;
-    if (last_seq > *max_sequence) {
-      *max_sequence = last_seq;
-    }
 
     if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
       compactions++;
       *save_manifest = true;
+      mutex_.Lock();
       status = WriteLevel0Table(mem, edit, nullptr);
+      mutex_.Unlock();
       mem->Unref();
       mem = nullptr;
       if (!status.ok()) {
@@ -463,6 +665,27 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 
   delete file;
 
+  // Wait for the workers, then replay the records that did not fill a
+  // memtable here so that the tail of the log can still be reused.
+  {
+    MutexLock l(&state.mu);
+    while (state.in_flight > 0) {
+      state.done.Wait();
+    }
+    if (status.ok()) {
+      status = state.status;
+    }
+  }
+  if (job != nullptr) {
+    if (status.ok()) {
+      mem = NewMemTable();
+      mem->Ref();
+      status = InsertLogRecords(job->records, mem);
+    }
+    delete job;
+  }
+  mutex_.Lock();
+
   // See if we should keep reusing the last log file.
   if (status.ok() && options_.reuse_logs && last_log && compactions == 0) {
     assert(logfile_ == nullptr);
@@ -479,7 +702,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = NewMemTable();
         mem_->Ref();
       }
     }
@@ -494,32 +717,167 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     mem->Unref();
   }
 
+  if (status.ok()) {
+    const double seconds = (env_->NowMicros() - start_micros) * 1e-6;
+    Log(options_.info_log,
+        "Recovered log #%llu: %llu bytes in %.3f seconds (%.1f MB/s)",
+        static_cast<unsigned long long>(log_number),
+        static_cast<unsigned long long>(record_bytes), seconds,
+        seconds > 0 ? record_bytes / 1048576.0 / seconds : 0.0);
+  }
   return status;
 }
 
+void DBImpl::RecoveryWork(void* arg) {
+  RecoveryJob* job = reinterpret_cast<RecoveryJob*>(arg);
+  DBImpl* db = job->db;
+  RecoveryState* state = job->state;
+
+  MemTable* mem = db->NewMemTable();
+  mem->Ref();
+  Status s = db->InsertLogRecords(job->records, mem);
+  db->mutex_.Lock();
+  if (s.ok()) {
+    s = db->WriteLevel0Table(mem, job->file_number, job->edit, nullptr);
+  } else {
+    db->pending_outputs_.erase(job->file_number);
+  }
+  db->mutex_.Unlock();
+  mem->Unref();
+  delete job;
+
+  MutexLock l(&state->mu);
+  if (state->status.ok()) {
+    state->status = s;
+  }
+  state->in_flight--;
+  state->done.SignalAll();
+}
+
+Status DBImpl::InsertLogRecords(Slice records, MemTable* mem) const {
+  Status status;
+  Slice record;
+  WriteBatch batch;
+  while (GetLengthPrefixedSlice(&records, &record)) {
+    WriteBatchInternal::SetContents(&batch, record);
+    status = WriteBatchInternal::InsertInto(&batch, mem);
+    MaybeIgnoreError(&status);
+    if (!status.ok()) {
+      break;
+    }
+  }
+  return status;
+}
+
+// State shared by the threads that warm up the table cache.
+struct DBImpl::WarmupState {
+  WarmupState() : done(&mu), next(0), running(0), opened(0) {}
+
+  port::Mutex mu;
+  port::CondVar done;  // Signalled when a thread runs out of work
+  TableCache* table_cache;
+  std::vector<FileMetaData> files;  // Tables to open, in order
+  size_t next GUARDED_BY(mu);       // Index of the next table to open
+  int running GUARDED_BY(mu);
+  int opened GUARDED_BY(mu);
+  Status status GUARDED_BY(mu);  // First error
+};
+
+void DBImpl::WarmupWork(void* arg) {
+  WarmupState* state = reinterpret_cast<WarmupState*>(arg);
+  MutexLock l(&state->mu);
+  while (state->next < state->files.size()) {
+    const FileMetaData& f = state->files[state->next++];
+    state->mu.Unlock();
+    Status s = state->table_cache->Load(f.number, f.file_size);
+    state->mu.Lock();
+    if (s.ok()) {
+      state->opened++;
+    } else if (state->status.ok()) {
+      state->status = s;
+    }
+  }
+  state->running--;
+  state->done.SignalAll();
+}
+
+void DBImpl::WarmUpTableCache() {
+  const int limit =
+      std::min(options_.table_warmup_files, TableCacheSize(options_));
+  if (limit <= 0) {
+    return;
+  }
+
+  const uint64_t start_micros = env_->NowMicros();
+  WarmupState state;
+  state.table_cache = table_cache_;
+  mutex_.Lock();
+  versions_->GetCurrentFiles(&state.files);
+  mutex_.Unlock();
+  if (state.files.size() > static_cast<size_t>(limit)) {
+    state.files.resize(limit);
+  }
+
+  const int threads = std::min<int>(options_.table_warmup_threads,
+                                    static_cast<int>(state.files.size()));
+  MutexLock l(&state.mu);
+  for (int i = 0; i < threads; i++) {
+    state.running++;
+    env_->StartThread(&DBImpl::WarmupWork, &state);
+  }
+  while (state.running > 0) {
+    state.done.Wait();
+  }
+
+  Log(options_.info_log, "Warmed up %d of %d tables in %.3f seconds: %s",
+      state.opened, static_cast<int>(state.files.size()),
+      (env_->NowMicros() - start_micros) * 1e-6,
+      state.status.ToString().c_str());
+}
+
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
                                 Version* base) {
   mutex_.AssertHeld();
+  const uint64_t file_number = versions_->NewFileNumber();
+  pending_outputs_.insert(file_number);
+  return WriteLevel0Table(mem, file_number, edit, base);
+}
+
+Status DBImpl::WriteLevel0Table(MemTable* mem, uint64_t file_number,
+                                VersionEdit* edit, Version* base) {
+  mutex_.AssertHeld();
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
-  meta.number = versions_->NewFileNumber();
-  pending_outputs_.insert(meta.number);
+  meta.number = file_number;
+  BlobFileMetaData blob;
+  if (options_.min_blob_size > 0) {
+    blob.number = versions_->NewFileNumber();
+    pending_outputs_.insert(blob.number);
+  }
   Iterator* iter = mem->NewIterator();
+  Iterator* range_del_iter = mem->NewRangeDeletionIterator();
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter, range_del_iter,
+                   &meta, blob.number != 0 ? &blob : nullptr);
     mutex_.Lock();
   }
 
   Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
       (unsigned long long)meta.number, (unsigned long long)meta.file_size,
       s.ToString().c_str());
+  if (blob.total_bytes > 0) {
+    Log(options_.info_log, "Blob file #%llu: %lld bytes",
+        (unsigned long long)blob.number, (unsigned long long)blob.file_size);
+  }
   delete iter;
+  delete range_del_iter;
   pending_outputs_.erase(meta.number);
+  pending_outputs_.erase(blob.number);
 
   // Note that if file_size is zero, the file has been deleted and
   // should not be added to the manifest.
@@ -531,12 +889,17 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
     edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+                  meta.largest, meta.has_range_deletions, meta.num_entries,
+                  meta.num_deletions, meta.creation_time,
+                  meta.marked_for_compaction);
+    if (blob.total_bytes > 0) {
+      edit->AddBlobFile(blob.number, blob.file_size, blob.total_bytes);
+    }
   }
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros;
-  stats.bytes_written = meta.file_size;
+  stats.bytes_written = meta.file_size + blob.file_size;
   stats_[level].Add(stats);
   return s;
 }
@@ -568,6 +931,7 @@ void DBImpl::CompactMemTable() {
     imm_->Unref();
     imm_ = nullptr;
     has_imm_.store(false, std::memory_order_release);
+    InstallSuperVersion();
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -646,6 +1010,13 @@ Status DBImpl::TEST_CompactMemTable() {
   return s;
 }
 
+void DBImpl::TEST_WaitForCompactions() {
+  MutexLock l(&mutex_);
+  while (background_compaction_scheduled_ && bg_error_.ok()) {
+    background_work_finished_signal_.Wait();
+  }
+}
+
 void DBImpl::RecordBackgroundError(const Status& s) {
   mutex_.AssertHeld();
   if (bg_error_.ok()) {
@@ -671,6 +1042,25 @@ void DBImpl::MaybeScheduleCompaction() {
   }
 }
 
+void DBImpl::MaybeCheckFileAges() {
+  if (options_.periodic_compaction_seconds == 0 ||
+      options_.compaction_style == kTieredCompaction) {
+    return;
+  }
+  const uint64_t now = env_->NowMicros() / 1000000;
+  uint64_t next = next_file_age_check_.load(std::memory_order_relaxed);
+  if (now < next ||
+      !next_file_age_check_.compare_exchange_strong(
+          next, now + kFileAgeCheckIntervalSeconds,
+          std::memory_order_relaxed)) {
+    // Checked recently, or another reader is checking now
+    return;
+  }
+  MutexLock l(&mutex_);
+  versions_->CheckFileAges();
+  MaybeScheduleCompaction();
+}
+
 void DBImpl::BGWork(void* db) {
   reinterpret_cast<DBImpl*>(db)->BackgroundCall();
 }
@@ -729,15 +1119,19 @@ void DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->RemoveFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+    c->edit()->AddFile(c->output_level(), f->number, f->file_size, f->smallest,
+                       f->largest, f->has_range_deletions, f->num_entries,
+                       f->num_deletions, f->creation_time,
+                       f->marked_for_compaction);
     status = versions_->LogAndApply(c->edit(), &mutex_);
-    if (!status.ok()) {
+    if (status.ok()) {
+      InstallSuperVersion();
+    } else {
       RecordBackgroundError(status);
     }
     VersionSet::LevelSummaryStorage tmp;
     Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-        static_cast<unsigned long long>(f->number), c->level() + 1,
+        static_cast<unsigned long long>(f->number), c->output_level(),
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(), versions_->LevelSummary(&tmp));
   } else {
@@ -789,24 +1183,136 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  pending_outputs_.erase(compact->reserved_number);
+  delete compact->blob_builder;
+  delete compact->blob_outfile;
+  pending_outputs_.erase(compact->blob_number);
   delete compact;
 }
 
+Status DBImpl::AddTableBlobGarbage(CompactionState* compact,
+                                   FileMetaData* f) {
+  ReadOptions options;
+  options.fill_cache = false;
+  Iterator* iter = table_cache_->NewIterator(options, f, false);
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    if (ExtractValueType(iter->key()) == kTypeBlobIndex) {
+      compact->AddBlobGarbage(iter->value());
+    }
+  }
+  Status s = iter->status();
+  delete iter;
+  return s;
+}
+
+Status DBImpl::ReadCompactionRangeDeletions(CompactionState* compact) {
+  Compaction* const c = compact->compaction;
+  const Comparator* const ucmp = user_comparator();
+  std::vector<RangeTombstone> tombstones;
+  Status s;
+  auto read = [&](FileMetaData* f) {
+    if (!s.ok() || !f->has_range_deletions) {
+      return;
+    }
+    Iterator* iter = table_cache_->NewRangeDeletionIterator(f, false);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ParsedInternalKey start;
+      if (!ParseInternalKey(iter->key(), &start)) {
+        s = Status::Corruption("corrupted range deletion key");
+        break;
+      }
+      tombstones.emplace_back(start.user_key, iter->value(), start.sequence);
+    }
+    if (s.ok()) {
+      s = iter->status();
+    }
+    delete iter;
+  };
+
+  const int output = c->num_input_levels() - 1;
+  for (int which = 0; which < output; which++) {
+    for (int i = 0; i < c->num_input_files(which); i++) {
+      read(c->input(which, i));
+    }
+  }
+  // The other inputs are newer than those from "output_level", so a range
+  // deletion visible to every snapshot among the former hides every entry
+  // of the files of the latter that lie inside it.  Such files need not
+  // be read at all.
+  for (int i = c->num_input_files(output) - 1; s.ok() && i >= 0; i--) {
+    FileMetaData* f = c->input(output, i);
+    for (const RangeTombstone& t : tombstones) {
+      if (t.sequence <= compact->smallest_snapshot &&
+          ucmp->Compare(t.start, f->smallest.user_key()) <= 0 &&
+          ucmp->Compare(f->largest.user_key(), t.end) < 0) {
+        Log(options_.info_log, "Dropping table #%llu under a range deletion",
+            static_cast<unsigned long long>(f->number));
+        if (compact->tables_hold_blob_indexes) {
+          s = AddTableBlobGarbage(compact, f);
+        }
+        c->SkipInput(i);
+        break;
+      }
+    }
+  }
+  for (int i = 0; i < c->num_input_files(output); i++) {
+    read(c->input(output, i));
+  }
+  if (!s.ok() || tombstones.empty()) {
+    return s;
+  }
+
+  compact->covering =
+      new RangeDelAggregator(ucmp, compact->smallest_snapshot);
+  for (const RangeTombstone& t : tombstones) {
+    compact->covering->Add(t);
+    // A range deletion visible to every snapshot can be dropped once
+    // nothing older than this compaction's output can lie inside it.
+    if (t.sequence > compact->smallest_snapshot ||
+        !c->IsBaseLevelForRange(t.start, t.end)) {
+      compact->range_deletions.push_back(t);
+    }
+  }
+  if (compact->covering->empty()) {
+    delete compact->covering;
+    compact->covering = nullptr;
+  }
+  const InternalKeyComparator* icmp = &internal_comparator_;
+  std::sort(compact->range_deletions.begin(), compact->range_deletions.end(),
+            [icmp](const RangeTombstone& a, const RangeTombstone& b) {
+              return icmp->Compare(a.StartKey(), b.StartKey()) < 0;
+            });
+  return s;
+}
+
 Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   assert(compact != nullptr);
   assert(compact->builder == nullptr);
   uint64_t file_number;
   {
     mutex_.Lock();
-    file_number = versions_->NewFileNumber();
-    pending_outputs_.insert(file_number);
+    if (compact->reserved_number != 0) {
+      file_number = compact->reserved_number;
+      compact->reserved_number = 0;
+    } else {
+      file_number = versions_->NewFileNumber();
+      pending_outputs_.insert(file_number);
+    }
     CompactionState::Output out;
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_deletions = false;
+    out.num_entries = 0;
+    out.num_deletions = 0;
+    out.creation_time = env_->NowMicros() / 1000000;
+    out.marked_for_compaction = false;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
+  compact->deletion_window =
+      DeletionWindow(options_.deletion_compaction_window,
+                     options_.deletion_compaction_trigger);
 
   // Make the output file
   std::string fname = TableFileName(dbname_, file_number);
@@ -817,6 +1323,53 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   return s;
 }
 
+// Add to the current output the parts of the kept range deletions that
+// lie before the user key "*upper", or all of them if "upper" is nullptr.
+// The next output starts at "*upper".
+void DBImpl::AddOutputRangeDeletions(CompactionState* compact,
+                                     const Slice* upper) {
+  const Comparator* const ucmp = user_comparator();
+  std::vector<RangeTombstone> pieces;
+  for (const RangeTombstone& t : compact->range_deletions) {
+    if (upper != nullptr && ucmp->Compare(t.start, *upper) >= 0) {
+      break;  // This and all later range deletions start past the output
+    }
+    RangeTombstone piece = t;
+    if (compact->has_output_lower &&
+        ucmp->Compare(piece.start, compact->output_lower) < 0) {
+      piece.start = compact->output_lower;
+    }
+    if (upper != nullptr && ucmp->Compare(*upper, piece.end) < 0) {
+      piece.end = upper->ToString();
+    }
+    if (ucmp->Compare(piece.start, piece.end) < 0) {
+      pieces.push_back(piece);
+    }
+  }
+
+  // Cutting the start keys may have changed their order.
+  const InternalKeyComparator* icmp = &internal_comparator_;
+  std::sort(pieces.begin(), pieces.end(),
+            [icmp](const RangeTombstone& a, const RangeTombstone& b) {
+              return icmp->Compare(a.StartKey(), b.StartKey()) < 0;
+            });
+  CompactionState::Output* out = compact->current_output();
+  for (const RangeTombstone& piece : pieces) {
+    const bool empty =
+        compact->builder->NumEntries() == 0 && !out->has_range_deletions;
+    compact->builder->AddRangeDeletion(piece.StartKey().Encode(), piece.end);
+    ExtendKeyRange(internal_comparator_, piece, empty, &out->smallest,
+                   &out->largest);
+    out->has_range_deletions = true;
+    out->num_entries++;
+    out->num_deletions++;
+  }
+  if (upper != nullptr) {
+    compact->output_lower = upper->ToString();
+    compact->has_output_lower = true;
+  }
+}
+
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
                                           Iterator* input) {
   assert(compact != nullptr);
@@ -836,6 +1389,11 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   }
   const uint64_t current_bytes = compact->builder->FileSize();
   compact->current_output()->file_size = current_bytes;
+  // Tables in the last level can go no further down, and their deletions
+  // are kept only for the sake of snapshots.
+  compact->current_output()->marked_for_compaction =
+      compact->deletion_window.triggered() &&
+      compact->compaction->output_level() < config::kNumLevels - 1;
   compact->total_bytes += current_bytes;
   delete compact->builder;
   compact->builder = nullptr;
@@ -868,20 +1426,191 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
 
 Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
+  const int level = compact->compaction->output_level();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
       compact->compaction->num_input_files(0), compact->compaction->level(),
-      compact->compaction->num_input_files(1), compact->compaction->level() + 1,
-      static_cast<long long>(compact->total_bytes));
+      compact->compaction->num_input_files(
+          compact->compaction->num_input_levels() - 1),
+      level, static_cast<long long>(compact->total_bytes));
 
   // Add compaction outputs
   compact->compaction->AddInputDeletions(compact->compaction->edit());
-  const int level = compact->compaction->level();
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    compact->compaction->edit()->AddFile(
+        level, out.number, out.file_size, out.smallest, out.largest,
+        out.has_range_deletions, out.num_entries, out.num_deletions,
+        out.creation_time, out.marked_for_compaction);
+  }
+  if (compact->blob_value_bytes > 0) {
+    compact->compaction->edit()->AddBlobFile(compact->blob_number,
+                                             compact->blob_file_size,
+                                             compact->blob_value_bytes);
+  }
+  for (const auto& garbage : compact->blob_garbage) {
+    compact->compaction->edit()->AddBlobGarbage(garbage.first, garbage.second);
+  }
+  Status s = versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+  if (s.ok()) {
+    InstallSuperVersion();
+  }
+  return s;
+}
+
+Status DBImpl::MergeCompactionEntries(CompactionState* compact,
+                                      Iterator* input,
+                                      std::vector<std::string>* keys,
+                                      std::vector<std::string>* values) {
+  ParsedInternalKey ikey;
+  ParseInternalKey(input->key(), &ikey);
+  assert(ikey.type == kTypeMerge);
+  const std::string user_key = ikey.user_key.ToString();
+  const SequenceNumber sequence = ikey.sequence;
+
+  // Collect the merge operands, newest first, up to the value or deletion
+  // beneath them.  Entries older than that are dropped by the caller.
+  std::vector<std::string> operand_keys;
+  std::vector<std::string> operands;
+  std::string existing_value;
+  bool has_existing_value = false;
+  bool found_base = false;
+  for (; input->Valid(); input->Next()) {
+    if (!ParseInternalKey(input->key(), &ikey) ||
+        user_comparator()->Compare(ikey.user_key, user_key) != 0) {
+      break;
+    }
+    const bool deleted =
+        compact->covering != nullptr && compact->covering->ShouldDelete(ikey);
+    if (ikey.type == kTypeMerge && !deleted) {
+      operand_keys.push_back(input->key().ToString());
+      operands.push_back(input->value().ToString());
+      continue;
+    }
+    if (ikey.type == kTypeBlobIndex) {
+      compact->AddBlobGarbage(input->value());
+    }
+    if (ikey.type == kTypeValue && !deleted) {
+      existing_value = input->value().ToString();
+      has_existing_value = true;
+    } else if (ikey.type == kTypeBlobIndex && !deleted) {
+      Status s = ReadBlob(input->value(), &existing_value);
+      if (!s.ok()) {
+        return s;
+      }
+      has_existing_value = true;
+    }
+    found_base = true;
+    input->Next();
+    break;
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
+
+  std::string result;
+  if (found_base || compact->compaction->IsBaseLevelForKey(user_key)) {
+    // Nothing older can affect the result, so replace the operands with
+    // the value they produce.
+    Slice existing(existing_value);
+    Status s = ApplyMergeOperands(
+        options_.merge_operator, user_key,
+        has_existing_value ? &existing : nullptr, operands, &result);
+    if (!s.ok()) {
+      return s;
+    }
+    keys->push_back(InternalKey(user_key, sequence, kTypeValue).Encode()
+                        .ToString());
+    values->push_back(result);
+  } else if (operands.size() > 1 &&
+             CombineMergeOperands(options_.merge_operator, user_key,
+                                  operands, &result)) {
+    keys->push_back(operand_keys[0]);
+    values->push_back(result);
+  } else {
+    keys->swap(operand_keys);
+    values->swap(operands);
+  }
+  return Status::OK();
+}
+
+Status DBImpl::PlaceCompactionValue(CompactionState* compact, Slice* key,
+                                    Slice* value) {
+  ParsedInternalKey ikey;
+  if (!ParseInternalKey(*key, &ikey)) {
+    return Status::OK();
+  }
+  Status s;
+  if (ikey.type == kTypeBlobIndex) {
+    // Copy the value out of a blob file that is being collected.
+    BlobIndex index;
+    if (!index.DecodeFrom(*value) ||
+        compact->blobs_to_collect.count(index.file_number) == 0) {
+      return s;
+    }
+    s = ReadBlob(*value, &compact->blob_value);
+    if (!s.ok()) {
+      return s;
+    }
+    compact->AddBlobGarbage(*value);
+    ikey.type = kTypeValue;
+    compact->blob_key.clear();
+    AppendInternalKey(&compact->blob_key, ikey);
+    *key = compact->blob_key;
+    *value = compact->blob_value;
+  }
+  if (ikey.type != kTypeValue || options_.min_blob_size == 0 ||
+      value->size() < options_.min_blob_size) {
+    return s;
+  }
+
+  // Move the value to the blob file of the compaction.
+  if (compact->blob_builder == nullptr) {
+    mutex_.Lock();
+    compact->blob_number = versions_->NewFileNumber();
+    pending_outputs_.insert(compact->blob_number);
+    mutex_.Unlock();
+    s = env_->NewWritableFile(BlobFileName(dbname_, compact->blob_number),
+                              &compact->blob_outfile);
+    if (!s.ok()) {
+      return s;
+    }
+    compact->blob_builder =
+        new BlobFileBuilder(compact->blob_outfile, compact->blob_number);
+  }
+  BlobIndex index;
+  s = compact->blob_builder->Add(ikey.user_key, *value, &index);
+  if (!s.ok()) {
+    return s;
+  }
+  std::string new_key;
+  AppendInternalKey(&new_key, ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                                kTypeBlobIndex));
+  compact->blob_key.swap(new_key);
+  compact->blob_index.clear();
+  index.EncodeTo(&compact->blob_index);
+  *key = compact->blob_key;
+  *value = compact->blob_index;
+  return s;
+}
+
+Status DBImpl::FinishCompactionBlobFile(CompactionState* compact) {
+  if (compact->blob_builder == nullptr) {
+    return Status::OK();
+  }
+  // The blob file must be durable before any table refers to it.
+  Status s = compact->blob_outfile->Sync();
+  if (s.ok()) {
+    s = compact->blob_outfile->Close();
+  }
+  if (s.ok()) {
+    compact->blob_file_size = compact->blob_builder->FileSize();
+    compact->blob_value_bytes = compact->blob_builder->ValueBytes();
+    Log(options_.info_log, "Generated blob file #%llu: %lld bytes",
+        (unsigned long long)compact->blob_number,
+        (unsigned long long)compact->blob_file_size);
+  }
+  delete compact->blob_builder;
+  compact->blob_builder = nullptr;
+  delete compact->blob_outfile;
+  compact->blob_outfile = nullptr;
+  return s;
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
@@ -890,8 +1619,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
-      compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1);
+      compact->compaction->num_input_files(
+          compact->compaction->num_input_levels() - 1),
+      compact->compaction->output_level());
 
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == nullptr);
@@ -901,19 +1631,36 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
+  versions_->GetBlobFilesToCollect(options_.blob_gc_live_ratio,
+                                   &compact->blobs_to_collect);
+  compact->tables_hold_blob_indexes = versions_->current()->NumBlobFiles() > 0;
+  if (compact->compaction->output_level() == compact->compaction->level()) {
+    // Level-0 files are ordered by number, so the output of an intra-level-0
+    // compaction must be numbered before the memtables flushed meanwhile.
+    compact->reserved_number = versions_->NewFileNumber();
+    pending_outputs_.insert(compact->reserved_number);
+  }
 
+  // Range deletions decide which inputs are read, and are read from the
+  // tables without holding the mutex.
+  mutex_.Unlock();
+  Status status = ReadCompactionRangeDeletions(compact);
+  mutex_.Lock();
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
   input->SeekToFirst();
-  Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-  while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+  bool stop_pending = false;  // The current output should be finished
+  std::vector<std::string> merged_keys, merged_values;
+  std::string filtered_key, filtered_value, blob_value;
+  while (status.ok() && input->Valid() &&
+         !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
@@ -930,7 +1677,22 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     Slice key = input->key();
     if (compact->compaction->ShouldStopBefore(key) &&
         compact->builder != nullptr) {
+      stop_pending = true;
+    }
+    // Outputs with range deletions may not split the entries for a user
+    // key, as the range deletions are cut at the output boundaries.
+    if (stop_pending &&
+        (compact->range_deletions.empty() ||
+         (key.size() >= 8 &&
+          user_comparator()->Compare(
+              ExtractUserKey(key),
+              compact->current_output()->largest.user_key()) != 0))) {
+      if (!compact->range_deletions.empty()) {
+        const Slice upper = ExtractUserKey(key);
+        AddOutputRangeDeletions(compact, &upper);
+      }
       status = FinishCompactionOutputFile(compact, input);
+      stop_pending = false;
       if (!status.ok()) {
         break;
       }
@@ -938,7 +1700,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 
     // Handle key/value, add to state, etc.
     bool drop = false;
-    if (!ParseInternalKey(key, &ikey)) {
+    const bool parsed = ParseInternalKey(key, &ikey);
+    if (!parsed) {
       // Do not hide error keys
       current_user_key.clear();
       has_current_user_key = false;
@@ -956,6 +1719,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
       if (last_sequence_for_key <= compact->smallest_snapshot) {
         // Hidden by an newer entry for same user key
         drop = true;  // (A)
+      } else if (compact->covering != nullptr &&
+                 compact->covering->ShouldDelete(ikey)) {
+        // Hidden by a range deletion that every snapshot sees
+        drop = true;
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
                  compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
@@ -981,7 +1748,83 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         (int)last_sequence_for_key, (int)compact->smallest_snapshot);
 #endif
 
-    if (!drop) {
+    // Every snapshot sees a value this old, so the compaction filter may
+    // delete or change it.
+    Slice value = input->value();
+    if (parsed && !drop &&
+        (ikey.type == kTypeValue || ikey.type == kTypeBlobIndex) &&
+        ikey.sequence <= compact->smallest_snapshot &&
+        options_.compaction_filter != nullptr) {
+      Slice existing = value;
+      if (ikey.type == kTypeBlobIndex) {
+        status = ReadBlob(value, &blob_value);
+        if (!status.ok()) {
+          break;
+        }
+        existing = blob_value;
+      }
+      bool value_changed = false;
+      if (options_.compaction_filter->Filter(compact->compaction->level(),
+                                             ikey.user_key, existing,
+                                             &filtered_value, &value_changed)) {
+        if (compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+          drop = true;
+        } else {
+          // Older values of the key may remain in higher levels, so a
+          // deletion has to take the place of the value.
+          if (ikey.type == kTypeBlobIndex) {
+            compact->AddBlobGarbage(value);
+          }
+          filtered_key.clear();
+          AppendInternalKey(&filtered_key,
+                            ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                              kTypeDeletion));
+          key = filtered_key;
+          value = Slice();
+        }
+      } else if (value_changed) {
+        if (ikey.type == kTypeBlobIndex) {
+          compact->AddBlobGarbage(value);
+          filtered_key.clear();
+          AppendInternalKey(&filtered_key,
+                            ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                              kTypeValue));
+          key = filtered_key;
+        }
+        value = filtered_value;
+      }
+    }
+    if (parsed && drop && ikey.type == kTypeBlobIndex) {
+      compact->AddBlobGarbage(input->value());
+    }
+
+    // Every snapshot sees a merge operand this old and the entries
+    // beneath it, so they can be folded together.  This moves input past
+    // them.
+    bool merged = false;
+    if (parsed && !drop && ikey.type == kTypeMerge &&
+        ikey.sequence <= compact->smallest_snapshot &&
+        options_.merge_operator != nullptr) {
+      merged_keys.clear();
+      merged_values.clear();
+      status = MergeCompactionEntries(compact, input, &merged_keys,
+                                      &merged_values);
+      if (!status.ok()) {
+        break;
+      }
+      merged = true;
+    }
+
+    const size_t num_entries = drop ? 0 : merged ? merged_keys.size() : 1;
+    for (size_t i = 0; i < num_entries; i++) {
+      Slice entry_value = merged ? Slice(merged_values[i]) : value;
+      if (merged) {
+        key = merged_keys[i];
+      }
+      status = PlaceCompactionValue(compact, &key, &entry_value);
+      if (!status.ok()) {
+        break;
+      }
       // Open output file if necessary
       if (compact->builder == nullptr) {
         status = OpenCompactionOutputFile(compact);
@@ -993,36 +1836,59 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         compact->current_output()->smallest.DecodeFrom(key);
       }
       compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
+      compact->builder->Add(key, entry_value);
+      compact->current_output()->num_entries++;
+      const bool is_deletion = (ExtractValueType(key) == kTypeDeletion);
+      if (is_deletion) {
+        compact->current_output()->num_deletions++;
+      }
+      compact->deletion_window.Add(is_deletion);
 
-      // Close output file if it is big enough
+      // Close output file before the next key if it is big enough
       if (compact->builder->FileSize() >=
           compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
-        }
+        stop_pending = true;
       }
     }
+    if (!status.ok()) {
+      break;
+    }
 
-    input->Next();
+    if (!merged) {
+      input->Next();
+    }
   }
 
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && compact->builder == nullptr) {
+    // Range deletions may extend past the last entry written.
+    for (const RangeTombstone& t : compact->range_deletions) {
+      if (!compact->has_output_lower ||
+          user_comparator()->Compare(t.end, compact->output_lower) > 0) {
+        status = OpenCompactionOutputFile(compact);
+        break;
+      }
+    }
+  }
   if (status.ok() && compact->builder != nullptr) {
+    AddOutputRangeDeletions(compact, nullptr);
     status = FinishCompactionOutputFile(compact, input);
   }
   if (status.ok()) {
     status = input->status();
   }
+  if (status.ok()) {
+    status = FinishCompactionBlobFile(compact);
+  }
   delete input;
   input = nullptr;
 
   CompactionStats stats;
   stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
+  for (int which = 0; which < compact->compaction->num_input_levels();
+       which++) {
     for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
       stats.bytes_read += compact->compaction->input(which, i)->file_size;
     }
@@ -1030,9 +1896,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     stats.bytes_written += compact->outputs[i].file_size;
   }
+  stats.bytes_written += compact->blob_file_size;
 
   mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  stats_[compact->compaction->output_level()].Add(stats);
 
   if (status.ok()) {
     status = InstallCompactionResults(compact);
@@ -1045,55 +1912,203 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   return status;
 }
 
-namespace {
+SequenceNumber DBImpl::LastSequence() const {
+  return versions_->LastSequence();
+}
 
-struct IterState {
-  port::Mutex* const mu;
-  Version* const version GUARDED_BY(mu);
-  MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
+void DBImpl::InstallSuperVersion() {
+  mutex_.AssertHeld();
+  SuperVersion* sv = new SuperVersion;
+  sv->mem = mem_;
+  sv->mem->Ref();
+  sv->imm = imm_;
+  if (sv->imm != nullptr) sv->imm->Ref();
+  sv->current = versions_->current();
+  sv->current->Ref();
+  sv->number = super_version_number_.load(std::memory_order_relaxed) + 1;
+  sv->refs = 1;
+
+  SuperVersion* old = super_version_;
+  super_version_ = sv;
+  // Sequentially consistent, so that ReleaseSuperVersion() sees the new
+  // number unless ClearSuperVersionSlots() sees the SuperVersion it caches.
+  super_version_number_.store(sv->number);
+  ClearSuperVersionSlots();
+  if (old != nullptr) {
+    UnrefSuperVersion(old);
+  }
+}
 
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
-};
+// Readers are spread over the slots by thread, so that with no more
+// threads than slots every thread has a slot of its own.
+static int SuperVersionSlotForThread(int num_slots) {
+  static std::atomic<int> next_thread_slot(0);
+  thread_local int slot =
+      next_thread_slot.fetch_add(1, std::memory_order_relaxed);
+  return slot % num_slots;
+}
 
-static void CleanupIteratorState(void* arg1, void* arg2) {
-  IterState* state = reinterpret_cast<IterState*>(arg1);
-  state->mu->Lock();
-  state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
-  state->version->Unref();
-  state->mu->Unlock();
-  delete state;
+DBImpl::SuperVersion* DBImpl::AcquireSuperVersion() {
+  SuperVersionSlot* slot =
+      &super_version_slots_[SuperVersionSlotForThread(kNumSuperVersionSlots)];
+  // Take the slot's reference, leaving the slot empty while in use.
+  SuperVersion* sv = slot->sv.exchange(nullptr, std::memory_order_acquire);
+  if (sv != nullptr &&
+      sv->number == super_version_number_.load(std::memory_order_acquire)) {
+    return sv;
+  }
+
+  MutexLock l(&mutex_);
+  if (sv != nullptr) {
+    UnrefSuperVersion(sv);  // Stale
+  }
+  sv = super_version_;
+  sv->refs++;
+  return sv;
 }
 
-}  // anonymous namespace
+void DBImpl::ReleaseSuperVersion(SuperVersion* sv) {
+  // Keep the reference cached in the slot unless the slot has been
+  // refilled or a newer SuperVersion has been installed meanwhile.
+  const uint64_t number = sv->number;
+  if (number == super_version_number_.load()) {
+    SuperVersionSlot* slot =
+        &super_version_slots_[SuperVersionSlotForThread(kNumSuperVersionSlots)];
+    SuperVersion* expected = nullptr;
+    if (slot->sv.compare_exchange_strong(expected, sv)) {
+      // InstallSuperVersion() may have cleared the slots just before this
+      // one was filled.  If so, take the stale SuperVersion back out,
+      // unless whoever emptied the slot since then has dropped it.
+      if (number == super_version_number_.load()) {
+        return;
+      }
+      expected = sv;
+      if (!slot->sv.compare_exchange_strong(expected, nullptr)) {
+        return;
+      }
+    }
+  }
+  MutexLock l(&mutex_);
+  UnrefSuperVersion(sv);
+}
+
+void DBImpl::ReleaseIteratorSuperVersion(void* db, void* sv) {
+  reinterpret_cast<DBImpl*>(db)->ReleaseSuperVersion(
+      reinterpret_cast<SuperVersion*>(sv));
+}
+
+void DBImpl::UnrefSuperVersion(SuperVersion* sv) {
+  mutex_.AssertHeld();
+  assert(sv->refs > 0);
+  if (--sv->refs == 0) {
+    sv->mem->Unref();
+    if (sv->imm != nullptr) sv->imm->Unref();
+    sv->current->Unref();
+    delete sv;
+  }
+}
+
+void DBImpl::ClearSuperVersionSlots() {
+  mutex_.AssertHeld();
+  for (SuperVersionSlot& slot : super_version_slots_) {
+    SuperVersion* sv = slot.sv.exchange(nullptr);
+    if (sv != nullptr) {
+      UnrefSuperVersion(sv);
+    }
+  }
+}
+
+static void DeleteIterateBounds(void* arg1, void* arg2) {
+  delete reinterpret_cast<InternalIterateBounds*>(arg1);
+}
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
                                       uint32_t* seed) {
-  mutex_.Lock();
-  *latest_snapshot = versions_->LastSequence();
+  // Read the sequence number before pinning the state to read from, so
+  // that every write up to it is visible in that state.
+  *latest_snapshot = LastSequence();
+  SuperVersion* sv = AcquireSuperVersion();
+  *seed = seed_.fetch_add(1, std::memory_order_relaxed) + 1;
+  return NewSuperVersionIterator(options, sv);
+}
+
+Iterator* DBImpl::NewSuperVersionIterator(const ReadOptions& options,
+                                          SuperVersion* sv) {
+  InternalIterateBounds* bounds = nullptr;
+  if (options.iterate_lower_bound != nullptr ||
+      options.iterate_upper_bound != nullptr) {
+    bounds = new InternalIterateBounds(options);
+  }
 
   // Collect together all needed child iterators
   std::vector<Iterator*> list;
-  list.push_back(mem_->NewIterator());
-  mem_->Ref();
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  list.push_back(sv->mem->NewIterator());
+  if (sv->imm != nullptr) {
+    list.push_back(sv->imm->NewIterator());
   }
-  versions_->current()->AddIterators(options, &list);
+  sv->current->AddIterators(bounds != nullptr ? bounds->options() : options,
+                            &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
-  versions_->current()->Ref();
+  internal_iter->RegisterCleanup(&DBImpl::ReleaseIteratorSuperVersion, this,
+                                 sv);
+  if (bounds != nullptr) {
+    // Cleanups run after the child iterators have been deleted.
+    internal_iter->RegisterCleanup(&DeleteIterateBounds, bounds, nullptr);
+  }
+  return internal_iter;
+}
 
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
-  internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
+Iterator* DBImpl::NewSuperVersionDBIterator(const ReadOptions& options,
+                                            SuperVersion* sv,
+                                            SequenceNumber sequence,
+                                            uint32_t seed) {
+  RangeDelAggregator* range_del;
+  Status s = CollectRangeDeletions(options, sv, sequence, &range_del);
+  if (!s.ok()) {
+    ReleaseSuperVersion(sv);
+    return NewErrorIterator(s);
+  }
+  return NewDBIterator(this, user_comparator(),
+                       NewSuperVersionIterator(options, sv), range_del,
+                       options_.merge_operator, sequence, seed, options);
+}
 
-  *seed = ++seed_;
-  mutex_.Unlock();
-  return internal_iter;
+Status DBImpl::CollectRangeDeletions(const ReadOptions& options,
+                                     SuperVersion* sv,
+                                     SequenceNumber sequence,
+                                     RangeDelAggregator** result) {
+  RangeDelAggregator* range_del =
+      new RangeDelAggregator(user_comparator(), sequence);
+  Status s;
+  MemTable* mems[2] = {sv->mem, sv->imm};
+  for (MemTable* mem : mems) {
+    Iterator* iter = (mem != nullptr) ? mem->NewRangeDeletionIterator()
+                                      : nullptr;
+    if (iter != nullptr) {
+      s = range_del->AddTombstones(iter);
+      delete iter;
+      if (!s.ok()) {
+        break;
+      }
+    }
+  }
+  if (s.ok()) {
+    if (options.iterate_lower_bound != nullptr ||
+        options.iterate_upper_bound != nullptr) {
+      InternalIterateBounds bounds(options);
+      s = sv->current->AddRangeDeletions(bounds.options(), range_del);
+    } else {
+      s = sv->current->AddRangeDeletions(options, range_del);
+    }
+  }
+  if (!s.ok() || range_del->empty()) {
+    delete range_del;
+    range_del = nullptr;
+  }
+  *result = range_del;
+  return s;
 }
 
 Iterator* DBImpl::TEST_NewInternalIterator() {
@@ -1110,60 +2125,144 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
   Status s;
-  MutexLock l(&mutex_);
   SequenceNumber snapshot;
   if (options.snapshot != nullptr) {
     snapshot =
         static_cast<const SnapshotImpl*>(options.snapshot)->sequence_number();
   } else {
-    snapshot = versions_->LastSequence();
+    snapshot = LastSequence();
   }
+  SuperVersion* sv = AcquireSuperVersion();
 
-  MemTable* mem = mem_;
-  MemTable* imm = imm_;
-  Version* current = versions_->current();
-  mem->Ref();
-  if (imm != nullptr) imm->Ref();
-  current->Ref();
-
-  bool have_stat_update = false;
   Version::GetStats stats;
+  stats.seek_file = nullptr;
 
-  // Unlock while reading from files and memtables
-  {
-    mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
-    LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
-      s = current->Get(options, lkey, value, &stats);
-      have_stat_update = true;
+  // First look in the memtable, then in the immutable memtable (if any).
+  LookupKey lkey(key, snapshot);
+  std::vector<std::string> operands;
+  if (sv->mem->Get(lkey, value, &s, &operands)) {
+    // Done
+  } else if (sv->imm != nullptr && sv->imm->Get(lkey, value, &s, &operands)) {
+    // Done
+  } else {
+    bool is_blob_index;
+    s = sv->current->Get(options, lkey, value, &stats, &operands,
+                         &is_blob_index);
+    if (s.ok() && is_blob_index) {
+      s = ReadBlob(*value, value);
     }
-    mutex_.Lock();
+  }
+  if (!operands.empty() && (s.ok() || s.IsNotFound())) {
+    // Apply the merge operands to the value beneath them, if any.
+    Slice existing(*value);
+    s = ApplyMergeOperands(options_.merge_operator, key,
+                           s.ok() ? &existing : nullptr, operands, value);
   }
 
-  if (have_stat_update && current->UpdateStats(stats)) {
-    MaybeScheduleCompaction();
+  // Charging a seek to a file needs the lock, but reads that found their
+  // answer in the first file they looked at have nothing to charge.
+  if (stats.seek_file != nullptr) {
+    MutexLock l(&mutex_);
+    if (sv->current->UpdateStats(stats)) {
+      MaybeScheduleCompaction();
+    }
   }
-  mem->Unref();
-  if (imm != nullptr) imm->Unref();
-  current->Unref();
+  ReleaseSuperVersion(sv);
+  MaybeCheckFileAges();
   return s;
 }
 
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
-  SequenceNumber latest_snapshot;
-  uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
-  return NewDBIterator(this, user_comparator(), iter,
-                       (options.snapshot != nullptr
-                            ? static_cast<const SnapshotImpl*>(options.snapshot)
-                                  ->sequence_number()
-                            : latest_snapshot),
-                       seed);
+  if (options.tailing) {
+    return NewTailingIterator(this, options);
+  }
+  // Read the sequence number before pinning the state to read from, so
+  // that every write up to it is visible in that state.
+  const SequenceNumber sequence =
+      (options.snapshot != nullptr
+           ? static_cast<const SnapshotImpl*>(options.snapshot)
+                 ->sequence_number()
+           : LastSequence());
+  MaybeCheckFileAges();
+  SuperVersion* sv = AcquireSuperVersion();
+  const uint32_t seed = seed_.fetch_add(1, std::memory_order_relaxed) + 1;
+  return NewSuperVersionDBIterator(options, sv, sequence, seed);
+}
+
+namespace {
+
+// The bounds of one of the iterators returned by NewRangeIterators().
+struct RangeShard {
+  std::string lower;
+  std::string upper;
+  Slice lower_slice;
+  Slice upper_slice;
+};
+
+void DeleteRangeShard(void* arg1, void* arg2) {
+  delete reinterpret_cast<RangeShard*>(arg1);
+}
+
+}  // namespace
+
+Status DBImpl::NewRangeIterators(const ReadOptions& options,
+                                 const Slice* start, const Slice* limit,
+                                 int max_shards,
+                                 std::vector<Iterator*>* iterators) {
+  iterators->clear();
+  if (max_shards < 1) {
+    return Status::InvalidArgument("max_shards must be positive");
+  }
+
+  // All shards read from one SuperVersion, which keeps the tables they
+  // read alive, at one sequence number.
+  const SequenceNumber sequence =
+      (options.snapshot != nullptr
+           ? static_cast<const SnapshotImpl*>(options.snapshot)
+                 ->sequence_number()
+           : LastSequence());
+  SuperVersion* sv = AcquireSuperVersion();
+
+  std::vector<std::string> split_points;
+  int num_shards;
+  {
+    MutexLock l(&mutex_);
+    versions_->GetSplitPoints(sv->current, start, limit, max_shards,
+                              &split_points);
+    num_shards = static_cast<int>(split_points.size()) + 1;
+    sv->refs += num_shards - 1;  // One reference per shard
+  }
+
+  for (int i = 0; i < num_shards; i++) {
+    RangeShard* shard = new RangeShard;
+    ReadOptions shard_options = options;
+    shard_options.iterate_lower_bound = nullptr;
+    shard_options.iterate_upper_bound = nullptr;
+    if (i > 0 || start != nullptr) {
+      shard->lower = (i > 0) ? split_points[i - 1] : start->ToString();
+      shard->lower_slice = shard->lower;
+      shard_options.iterate_lower_bound = &shard->lower_slice;
+    }
+    if (i < num_shards - 1 || limit != nullptr) {
+      shard->upper = (i < num_shards - 1) ? split_points[i] : limit->ToString();
+      shard->upper_slice = shard->upper;
+      shard_options.iterate_upper_bound = &shard->upper_slice;
+    }
+    const uint32_t seed = seed_.fetch_add(1, std::memory_order_relaxed) + 1;
+    Iterator* iter =
+        NewSuperVersionDBIterator(shard_options, sv, sequence, seed);
+    iter->RegisterCleanup(&DeleteRangeShard, shard, nullptr);
+    iterators->push_back(iter);
+  }
+  return Status::OK();
+}
+
+Status DBImpl::ReadBlob(const Slice& blob_index, std::string* value) {
+  BlobIndex index;
+  if (!index.DecodeFrom(blob_index)) {
+    return Status::Corruption("bad blob index");
+  }
+  return blob_cache_->Get(index, value);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1192,6 +2291,19 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
+Status DBImpl::DeleteRange(const WriteOptions& options, const Slice& begin_key,
+                           const Slice& end_key) {
+  return DB::DeleteRange(options, begin_key, end_key);
+}
+
+Status DBImpl::Merge(const WriteOptions& options, const Slice& key,
+                     const Slice& value) {
+  if (options_.merge_operator == nullptr) {
+    return Status::InvalidArgument("no merge operator configured");
+  }
+  return DB::Merge(options, key, value);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   Writer w(&mutex_);
   w.batch = updates;
@@ -1370,8 +2482,9 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       log_ = new log::Writer(lfile);
       imm_ = mem_;
       has_imm_.store(true, std::memory_order_release);
-      mem_ = new MemTable(internal_comparator_);
+      mem_ = NewMemTable();
       mem_->Ref();
+      InstallSuperVersion();
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
     }
@@ -1420,6 +2533,12 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
       }
     }
     return true;
+  } else if (in == "num-blob-files") {
+    char buf[50];
+    std::snprintf(buf, sizeof(buf), "%d",
+                  versions_->current()->NumBlobFiles());
+    *value = buf;
+    return true;
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
@@ -1473,6 +2592,20 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin_key,
+                       const Slice& end_key) {
+  WriteBatch batch;
+  batch.DeleteRange(begin_key, end_key);
+  return Write(opt, &batch);
+}
+
+Status DB::Merge(const WriteOptions& opt, const Slice& key,
+                 const Slice& value) {
+  WriteBatch batch;
+  batch.Merge(key, value);
+  return Write(opt, &batch);
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1495,7 +2628,7 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
       impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->mem_ = impl->NewMemTable();
       impl->mem_->Ref();
     }
   }
@@ -1505,10 +2638,14 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
   }
   if (s.ok()) {
+    impl->InstallSuperVersion();
     impl->RemoveObsoleteFiles();
     impl->MaybeScheduleCompaction();
   }
   impl->mutex_.Unlock();
+  if (s.ok()) {
+    impl->WarmUpTableCache();
+  }
   if (s.ok()) {
     assert(impl->mem_ != nullptr);
     *dbptr = impl;
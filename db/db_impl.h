@@ -20,7 +20,11 @@
 
 namespace leveldb {
 
+class ArenaBlockPool;
+class BlobFileCache;
+struct FileMetaData;
 class MemTable;
+class RangeDelAggregator;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -39,6 +43,10 @@ class DBImpl : public DB {
   Status Put(const WriteOptions&, const Slice& key,
              const Slice& value) override;
   Status Delete(const WriteOptions&, const Slice& key) override;
+  Status DeleteRange(const WriteOptions&, const Slice& begin_key,
+                     const Slice& end_key) override;
+  Status Merge(const WriteOptions&, const Slice& key,
+               const Slice& value) override;
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
@@ -47,6 +55,9 @@ class DBImpl : public DB {
   void ReleaseSnapshot(const Snapshot* snapshot) override;
   bool GetProperty(const Slice& property, std::string* value) override;
   void GetApproximateSizes(const Range* range, int n, uint64_t* sizes) override;
+  Status NewRangeIterators(const ReadOptions& options, const Slice* start,
+                           const Slice* limit, int max_shards,
+                           std::vector<Iterator*>* iterators) override;
   void CompactRange(const Slice* begin, const Slice* end) override;
 
   // Extra methods (for testing) that are not in the public DB interface
@@ -57,6 +68,10 @@ class DBImpl : public DB {
   // Force current memtable contents to be compacted.
   Status TEST_CompactMemTable();
 
+  // Wait until no background compaction is scheduled or running, at which
+  // point the current version needs no further compaction.
+  void TEST_WaitForCompactions();
+
   // Return an internal iterator over the current state of the database.
   // The keys of this iterator are internal keys (see format.h).
   // The returned iterator should be deleted when no longer needed.
@@ -71,11 +86,35 @@ class DBImpl : public DB {
   // bytes.
   void RecordReadSample(Slice key);
 
+  // Read the value that "blob_index", the value of a kTypeBlobIndex
+  // entry, refers to.  REQUIRES: a version that lists the blob file is
+  // pinned.
+  Status ReadBlob(const Slice& blob_index, std::string* value);
+
  private:
   friend class DB;
+  friend class TailingIterator;
   struct CompactionState;
   struct Writer;
 
+  // The memtables and version that a read consults, bundled so that a
+  // reader can pin all three at once without taking mutex_.
+  struct SuperVersion {
+    MemTable* mem;
+    MemTable* imm;      // May be null
+    Version* current;
+    uint64_t number;    // Matches super_version_number_ while current
+    int refs;           // Protected by DBImpl::mutex_
+  };
+
+  // A per-thread cache of the current SuperVersion.  Each non-null slot
+  // holds a reference.  Padded to a cache line to avoid false sharing.
+  struct SuperVersionSlot {
+    std::atomic<SuperVersion*> sv;
+    char padding[64 - sizeof(std::atomic<SuperVersion*>)];
+  };
+  static constexpr int kNumSuperVersionSlots = 64;
+
   // Information for a manual compaction
   struct ManualCompaction {
     int level;
@@ -105,8 +144,50 @@ class DBImpl : public DB {
                                 SequenceNumber* latest_snapshot,
                                 uint32_t* seed);
 
+  // Return an internal iterator over "sv", which takes over one of the
+  // caller's references to "sv".
+  Iterator* NewSuperVersionIterator(const ReadOptions& options,
+                                    SuperVersion* sv);
+
+  // Return a user-facing iterator over "sv" at "sequence", which takes
+  // over one of the caller's references to "sv".
+  Iterator* NewSuperVersionDBIterator(const ReadOptions& options,
+                                      SuperVersion* sv,
+                                      SequenceNumber sequence, uint32_t seed);
+
+  // Store in *result the range deletions of "sv" visible at "sequence"
+  // that may hide keys inside the iterate bounds of the options, or
+  // nullptr if there are none.
+  Status CollectRangeDeletions(const ReadOptions& options, SuperVersion* sv,
+                               SequenceNumber sequence,
+                               RangeDelAggregator** result);
+
   Status NewDB();
 
+  // Publish a SuperVersion for the current mem_, imm_ and version.  Must
+  // be called whenever any of them changes.
+  void InstallSuperVersion() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Return a reference to the current SuperVersion.  In the common case
+  // it comes from the calling thread's slot without locking mutex_.
+  SuperVersion* AcquireSuperVersion() LOCKS_EXCLUDED(mutex_);
+
+  // Give back a SuperVersion obtained from AcquireSuperVersion().
+  void ReleaseSuperVersion(SuperVersion* sv) LOCKS_EXCLUDED(mutex_);
+  static void ReleaseIteratorSuperVersion(void* db, void* sv);
+
+  void UnrefSuperVersion(SuperVersion* sv) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Drop the SuperVersions cached in the per-thread slots.
+  void ClearSuperVersionSlots() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns the sequence number of the last completed write, which
+  // VersionSet keeps in an atomic so that readers need not lock mutex_.
+  SequenceNumber LastSequence() const NO_THREAD_SAFETY_ANALYSIS;
+
+  // Return a new, unreferenced memtable configured according to options_.
+  MemTable* NewMemTable() const;
+
   // Recover the descriptor from persistent storage.  May do a significant
   // amount of work to recover recently logged updates.  Any changes to
   // be made to the descriptor are added to *edit.
@@ -127,9 +208,29 @@ class DBImpl : public DB {
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Parallel log replay: a RecoveryJob holds a run of log records that a
+  // worker thread inserts into a fresh memtable and writes to level-0.
+  struct RecoveryState;
+  struct RecoveryJob;
+  static void RecoveryWork(void* job);
+
+  // Insert the length-prefixed log records in "records" into "mem".
+  Status InsertLogRecords(Slice records, MemTable* mem) const;
+
+  // Open the tables selected by options_.table_warmup_files.
+  struct WarmupState;
+  static void WarmupWork(void* state);
+  void WarmUpTableCache() LOCKS_EXCLUDED(mutex_);
+
   Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Like WriteLevel0Table(), but writes to "file_number", which the
+  // caller has already allocated and added to pending_outputs_.
+  Status WriteLevel0Table(MemTable* mem, uint64_t file_number,
+                          VersionEdit* edit, Version* base)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status MakeRoomForWrite(bool force /* compact even if there is room? */)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer)
@@ -138,6 +239,11 @@ class DBImpl : public DB {
   void RecordBackgroundError(const Status& s);
 
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Tables age between changes to the set of tables, so reads look again
+  // for tables older than Options::periodic_compaction_seconds, at most
+  // once every kFileAgeCheckIntervalSeconds.
+  void MaybeCheckFileAges() LOCKS_EXCLUDED(mutex_);
   static void BGWork(void* db);
   void BackgroundCall();
   void BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -146,8 +252,19 @@ class DBImpl : public DB {
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  Status ReadCompactionRangeDeletions(CompactionState* compact);
+  // Count the blob values referred to by "f", a table the compaction
+  // drops unread, as garbage.
+  Status AddTableBlobGarbage(CompactionState* compact, FileMetaData* f);
   Status OpenCompactionOutputFile(CompactionState* compact);
+  void AddOutputRangeDeletions(CompactionState* compact, const Slice* upper);
+  Status MergeCompactionEntries(CompactionState* compact, Iterator* input,
+                                std::vector<std::string>* keys,
+                                std::vector<std::string>* values);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  Status PlaceCompactionValue(CompactionState* compact, Slice* key,
+                              Slice* value);
+  Status FinishCompactionBlobFile(CompactionState* compact);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -167,6 +284,13 @@ class DBImpl : public DB {
   // table_cache_ provides its own synchronization
   TableCache* const table_cache_;
 
+  // blob_cache_ provides its own synchronization
+  BlobFileCache* const blob_cache_;
+
+  // Source of memtable memory, or nullptr if memtables allocate from the
+  // heap.  Provides its own synchronization.
+  ArenaBlockPool* const arena_pool_;
+
   // Lock over the persistent DB state.  Non-null iff successfully acquired.
   FileLock* db_lock_;
 
@@ -180,7 +304,13 @@ class DBImpl : public DB {
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
-  uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
+  std::atomic<uint32_t> seed_;  // For sampling.
+  std::atomic<uint64_t> next_file_age_check_;  // In seconds.
+
+  // Read state published for lock-free readers.
+  SuperVersion* super_version_ GUARDED_BY(mutex_);
+  std::atomic<uint64_t> super_version_number_;
+  SuperVersionSlot super_version_slots_[kNumSuperVersionSlots];
 
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
@@ -4,9 +4,14 @@
 
 #include "db/db_iter.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/merge_helper.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
@@ -43,31 +48,46 @@ class DBIter : public Iterator {
   //     the exact entry that yields this->key(), this->value()
   // (2) When moving backwards, the internal iterator is positioned
   //     just before all entries whose user key == this->key().
+  // Entries made of merge operands, and values read from blob files, are
+  // exceptions to (1): the key and value are saved instead, and in the
+  // case of merge operands the internal iterator has moved past them.
   enum Direction { kForward, kReverse };
 
-  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
-         uint32_t seed)
+  DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter,
+         RangeDelAggregator* range_del, const MergeOperator* merge_operator,
+         SequenceNumber s, uint32_t seed, const ReadOptions& options)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
+        range_del_(range_del),
+        merge_operator_(merge_operator),
         sequence_(s),
+        lower_bound_(options.iterate_lower_bound),
+        upper_bound_(options.iterate_upper_bound),
         direction_(kForward),
         valid_(false),
+        saved_entry_(false),
         rnd_(seed),
         bytes_until_read_sampling_(RandomCompactionPeriod()) {}
 
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    delete range_del_;
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
-    return (direction_ == kForward) ? ExtractUserKey(iter_->key()) : saved_key_;
+    return (direction_ == kForward && !saved_entry_)
+               ? ExtractUserKey(iter_->key())
+               : saved_key_;
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    return (direction_ == kForward && !saved_entry_) ? iter_->value()
+                                                     : saved_value_;
   }
   Status status() const override {
     if (status_.ok()) {
@@ -86,8 +106,15 @@ class DBIter : public Iterator {
  private:
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
+  void MergeValuesForward(const Slice& user_key);
+  bool ReadBlobValue(const Slice& blob_index);
   bool ParseKey(ParsedInternalKey* key);
 
+  // Return true iff a range deletion hides the entry "key".
+  bool IsRangeDeleted(const ParsedInternalKey& key) {
+    return range_del_ != nullptr && range_del_->ShouldDelete(key);
+  }
+
   inline void SaveKey(const Slice& k, std::string* dst) {
     dst->assign(k.data(), k.size());
   }
@@ -109,12 +136,18 @@ class DBIter : public Iterator {
   DBImpl* db_;
   const Comparator* const user_comparator_;
   Iterator* const iter_;
+  RangeDelAggregator* const range_del_;  // May be nullptr
+  const MergeOperator* const merge_operator_;  // May be nullptr
   SequenceNumber const sequence_;
+  const Slice* const lower_bound_;  // May be nullptr
+  const Slice* const upper_bound_;  // May be nullptr
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
   Direction direction_;
   bool valid_;
+  // Forward, and the current entry is in saved_key_ and saved_value_
+  bool saved_entry_;
   Random rnd_;
   size_t bytes_until_read_sampling_;
 };
@@ -157,6 +190,15 @@ void DBIter::Next() {
       return;
     }
     // saved_key_ already contains the key to skip past.
+  } else if (saved_entry_) {
+    // iter_ is at or past the entries of this->key(), which saved_key_
+    // holds, so skip whatever remains of them.
+    if (!iter_->Valid()) {
+      valid_ = false;
+      saved_entry_ = false;
+      saved_key_.clear();
+      return;
+    }
   } else {
     // Store in saved_key_ the current key so we skip it below.
     SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
@@ -178,9 +220,17 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   // Loop until we hit an acceptable entry to yield
   assert(iter_->Valid());
   assert(direction_ == kForward);
+  saved_entry_ = false;
   do {
     ParsedInternalKey ikey;
-    if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+    if (!ParseKey(&ikey)) {
+      // Skip corrupted entries
+    } else if (upper_bound_ != nullptr &&
+               user_comparator_->Compare(ikey.user_key, *upper_bound_) >= 0) {
+      // Stop before reading past the end of the range, even if that means
+      // not skipping some deleted entries.
+      break;
+    } else if (ikey.sequence <= sequence_) {
       switch (ikey.type) {
         case kTypeDeletion:
           // Arrange to skip all upcoming entries for this key since
@@ -189,15 +239,43 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
           skipping = true;
           break;
         case kTypeValue:
+        case kTypeBlobIndex:
           if (skipping &&
               user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
             // Entry hidden
+          } else if (IsRangeDeleted(ikey)) {
+            // Deleted along with all upcoming entries for this key
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
+          } else if (ikey.type == kTypeBlobIndex) {
+            SaveKey(ikey.user_key, &saved_key_);
+            if (ReadBlobValue(iter_->value())) {
+              valid_ = true;
+              saved_entry_ = true;
+            }
+            return;
           } else {
             valid_ = true;
             saved_key_.clear();
             return;
           }
           break;
+        case kTypeMerge:
+          if (skipping &&
+              user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+            // Entry hidden
+          } else if (IsRangeDeleted(ikey)) {
+            // Deleted along with all upcoming entries for this key
+            SaveKey(ikey.user_key, skip);
+            skipping = true;
+          } else {
+            MergeValuesForward(ikey.user_key);
+            return;
+          }
+          break;
+        case kTypeRangeDeletion:
+          // Range deletions are kept apart from the entries iterated here.
+          break;
       }
     }
     iter_->Next();
@@ -206,26 +284,91 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   valid_ = false;
 }
 
+void DBIter::MergeValuesForward(const Slice& user_key) {
+  // iter_ is at the newest visible merge operand for "user_key".  Collect
+  // it and the operands beneath it, stopping at the value or deletion
+  // that they apply to.
+  SaveKey(user_key, &saved_key_);
+  std::vector<std::string> operands;
+  operands.push_back(iter_->value().ToString());
+  bool has_value = false;
+  for (iter_->Next(); iter_->Valid(); iter_->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseKey(&ikey)) {
+      continue;  // Skip corrupted entries
+    }
+    if (user_comparator_->Compare(ikey.user_key, saved_key_) != 0) {
+      break;
+    }
+    if (ikey.type == kTypeMerge && !IsRangeDeleted(ikey)) {
+      operands.push_back(iter_->value().ToString());
+      continue;
+    }
+    if (ikey.type == kTypeValue && !IsRangeDeleted(ikey)) {
+      saved_value_.assign(iter_->value().data(), iter_->value().size());
+      has_value = true;
+    } else if (ikey.type == kTypeBlobIndex && !IsRangeDeleted(ikey)) {
+      if (!ReadBlobValue(iter_->value())) {
+        return;
+      }
+      has_value = true;
+    }
+    break;
+  }
+
+  Slice existing(saved_value_);
+  Status s = ApplyMergeOperands(merge_operator_, saved_key_,
+                                has_value ? &existing : nullptr, operands,
+                                &saved_value_);
+  if (s.ok()) {
+    valid_ = true;
+    saved_entry_ = true;
+  } else {
+    status_ = s;
+    valid_ = false;
+    saved_key_.clear();
+  }
+}
+
+bool DBIter::ReadBlobValue(const Slice& blob_index) {
+  Status s = db_->ReadBlob(blob_index, &saved_value_);
+  if (!s.ok()) {
+    status_ = s;
+    valid_ = false;
+    saved_key_.clear();
+    ClearSavedValue();
+    return false;
+  }
+  return true;
+}
+
 void DBIter::Prev() {
   assert(valid_);
 
   if (direction_ == kForward) {  // Switch directions?
     // iter_ is pointing at the current entry.  Scan backwards until
     // the key changes so we can use the normal reverse scanning code.
-    assert(iter_->Valid());  // Otherwise valid_ would have been false
-    SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
-    while (true) {
-      iter_->Prev();
+    if (saved_entry_) {
+      // iter_ is at or past the entries of the current key, and
+      // saved_key_ already holds it.
+      saved_entry_ = false;
       if (!iter_->Valid()) {
-        valid_ = false;
-        saved_key_.clear();
-        ClearSavedValue();
-        return;
-      }
-      if (user_comparator_->Compare(ExtractUserKey(iter_->key()), saved_key_) <
-          0) {
-        break;
+        iter_->SeekToLast();
       }
+    } else {
+      assert(iter_->Valid());  // Otherwise valid_ would have been false
+      SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+    }
+    while (iter_->Valid() &&
+           user_comparator_->Compare(ExtractUserKey(iter_->key()),
+                                     saved_key_) >= 0) {
+      iter_->Prev();
+    }
+    if (!iter_->Valid()) {
+      valid_ = false;
+      saved_key_.clear();
+      ClearSavedValue();
+      return;
     }
     direction_ = kReverse;
   }
@@ -237,20 +380,40 @@ void DBIter::FindPrevUserEntry() {
   assert(direction_ == kReverse);
 
   ValueType value_type = kTypeDeletion;
+  // Merge operands of saved_key_, oldest first, and whether a value in
+  // saved_value_ lies beneath them.
+  std::vector<std::string> operands;
+  bool has_value = false;
+  bool has_blob_index = false;  // saved_value_ holds a blob index
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
-      if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
+      if (!ParseKey(&ikey)) {
+        // Skip corrupted entries
+      } else if (lower_bound_ != nullptr &&
+                 user_comparator_->Compare(ikey.user_key, *lower_bound_) < 0) {
+        // Before the start of the range
+        break;
+      } else if (ikey.sequence <= sequence_) {
         if ((value_type != kTypeDeletion) &&
             user_comparator_->Compare(ikey.user_key, saved_key_) < 0) {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
-        value_type = ikey.type;
+        value_type = IsRangeDeleted(ikey) ? kTypeDeletion : ikey.type;
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
           ClearSavedValue();
+          operands.clear();
+          has_value = false;
+          has_blob_index = false;
+        } else if (value_type == kTypeMerge) {
+          SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+          operands.push_back(iter_->value().ToString());
         } else {
+          operands.clear();
+          has_value = true;
+          has_blob_index = (value_type == kTypeBlobIndex);
           Slice raw_value = iter_->value();
           if (saved_value_.capacity() > raw_value.size() + 1048576) {
             std::string empty;
@@ -264,6 +427,25 @@ void DBIter::FindPrevUserEntry() {
     } while (iter_->Valid());
   }
 
+  if (has_blob_index) {
+    const std::string blob_index = saved_value_;
+    if (!ReadBlobValue(blob_index)) {
+      direction_ = kForward;
+      return;
+    }
+  }
+
+  if (value_type == kTypeMerge) {
+    std::reverse(operands.begin(), operands.end());
+    Slice existing(saved_value_);
+    status_ = ApplyMergeOperands(merge_operator_, saved_key_,
+                                 has_value ? &existing : nullptr, operands,
+                                 &saved_value_);
+    if (!status_.ok()) {
+      value_type = kTypeDeletion;
+    }
+  }
+
   if (value_type == kTypeDeletion) {
     // End
     valid_ = false;
@@ -277,10 +459,16 @@ void DBIter::FindPrevUserEntry() {
 
 void DBIter::Seek(const Slice& target) {
   direction_ = kForward;
+  saved_entry_ = false;
   ClearSavedValue();
   saved_key_.clear();
+  const Slice& start =
+      (lower_bound_ != nullptr &&
+       user_comparator_->Compare(target, *lower_bound_) < 0)
+          ? *lower_bound_
+          : target;
   AppendInternalKey(&saved_key_,
-                    ParsedInternalKey(target, sequence_, kValueTypeForSeek));
+                    ParsedInternalKey(start, sequence_, kValueTypeForSeek));
   iter_->Seek(saved_key_);
   if (iter_->Valid()) {
     FindNextUserEntry(false, &saved_key_ /* temporary storage */);
@@ -290,7 +478,12 @@ void DBIter::Seek(const Slice& target) {
 }
 
 void DBIter::SeekToFirst() {
+  if (lower_bound_ != nullptr) {
+    Seek(*lower_bound_);
+    return;
+  }
   direction_ = kForward;
+  saved_entry_ = false;
   ClearSavedValue();
   iter_->SeekToFirst();
   if (iter_->Valid()) {
@@ -302,17 +495,35 @@ void DBIter::SeekToFirst() {
 
 void DBIter::SeekToLast() {
   direction_ = kReverse;
+  saved_entry_ = false;
   ClearSavedValue();
-  iter_->SeekToLast();
+  if (upper_bound_ != nullptr) {
+    // Position just before the first entry past the range.
+    saved_key_.clear();
+    AppendInternalKey(&saved_key_, ParsedInternalKey(*upper_bound_,
+                                                     kMaxSequenceNumber,
+                                                     kValueTypeForSeek));
+    iter_->Seek(saved_key_);
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  } else {
+    iter_->SeekToLast();
+  }
   FindPrevUserEntry();
 }
 
 }  // anonymous namespace
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
-                        Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        Iterator* internal_iter, RangeDelAggregator* range_del,
+                        const MergeOperator* merge_operator,
+                        SequenceNumber sequence, uint32_t seed,
+                        const ReadOptions& options) {
+  return new DBIter(db, user_key_comparator, internal_iter, range_del,
+                    merge_operator, sequence, seed, options);
 }
 
 }  // namespace leveldb
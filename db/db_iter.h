@@ -13,13 +13,22 @@
 namespace leveldb {
 
 class DBImpl;
+class MergeOperator;
+class RangeDelAggregator;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Only user keys within the iterate bounds
+// of "options" are returned, and entries deleted by the range deletions
+// in "*range_del" are hidden.  The iterator takes ownership of
+// "range_del", which may be nullptr if there are no range deletions.
+// Merge operands are combined with "merge_operator", which may be nullptr
+// if the database has none.
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
-                        Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        Iterator* internal_iter, RangeDelAggregator* range_del,
+                        const MergeOperator* merge_operator,
+                        SequenceNumber sequence, uint32_t seed,
+                        const ReadOptions& options);
 
 }  // namespace leveldb
 
@@ -13,8 +13,11 @@
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/persistent_cache.h"
 #include "leveldb/table.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
@@ -39,6 +42,34 @@ static std::string RandomKey(Random* rnd) {
 }
 
 namespace {
+// Joins the value and the operands merged into it with commas.
+class AppendMergeOperator : public MergeOperator {
+ public:
+  const char* Name() const override { return "test.AppendMergeOperator"; }
+
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    new_value->clear();
+    if (existing_value != nullptr) {
+      new_value->assign(existing_value->data(), existing_value->size());
+    }
+    for (size_t i = 0; i < operands.size(); i++) {
+      if (existing_value != nullptr || i > 0) {
+        new_value->push_back(',');
+      }
+      new_value->append(operands[i].data(), operands[i].size());
+    }
+    return true;
+  }
+
+  bool PartialMerge(const Slice& key, const Slice& left, const Slice& right,
+                    std::string* new_value) const override {
+    *new_value = left.ToString() + "," + right.ToString();
+    return true;
+  }
+};
+
 class AtomicCounter {
  public:
   AtomicCounter() : count_(0) {}
@@ -120,6 +151,9 @@ class SpecialEnv : public EnvWrapper {
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
+  // Added to the time returned by NowMicros().
+  std::atomic<uint64_t> clock_offset_micros_;
+
   explicit SpecialEnv(Env* base)
       : EnvWrapper(base),
         delay_data_sync_(false),
@@ -128,7 +162,8 @@ class SpecialEnv : public EnvWrapper {
         non_writable_(false),
         manifest_sync_error_(false),
         manifest_write_error_(false),
-        count_random_reads_(false) {}
+        count_random_reads_(false),
+        clock_offset_micros_(0) {}
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
     class DataFile : public WritableFile {
@@ -224,6 +259,11 @@ class SpecialEnv : public EnvWrapper {
     }
     return s;
   }
+
+  uint64_t NowMicros() override {
+    return target()->NowMicros() +
+           clock_offset_micros_.load(std::memory_order_relaxed);
+  }
 };
 
 class DBTest : public testing::Test {
@@ -265,6 +305,7 @@ class DBTest : public testing::Test {
   Options CurrentOptions() {
     Options options;
     options.reuse_logs = false;
+    options.merge_operator = &merge_operator_;
     switch (option_config_) {
       case kReuse:
         options.reuse_logs = true;
@@ -275,6 +316,15 @@ class DBTest : public testing::Test {
       case kUncompressed:
         options.compression = kNoCompression;
         break;
+      case kMemTableBloom:
+        options.memtable_bloom_size_ratio = 0.1;
+        break;
+      case kUnlimitedOpenFiles:
+        options.max_open_files = -1;
+        break;
+      case kBlobFiles:
+        options.min_blob_size = 1000;
+        break;
       default:
         break;
     }
@@ -389,6 +439,15 @@ class DBTest : public testing::Test {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeMerge:
+              result += "MERGE " + iter->value().ToString();
+              break;
+            case kTypeBlobIndex:
+              result += "BLOB";
+              break;
+            case kTypeRangeDeletion:
+              result += "RANGEDEL";
+              break;
           }
         }
         iter->Next();
@@ -440,6 +499,49 @@ class DBTest : public testing::Test {
     return static_cast<int>(files.size());
   }
 
+  int NumBlobFiles() {
+    std::string property;
+    EXPECT_TRUE(db_->GetProperty("leveldb.num-blob-files", &property));
+    return std::stoi(property);
+  }
+
+  int CountBlobFilesOnDisk() {
+    std::vector<std::string> files;
+    env_->GetChildren(dbname_, &files);
+    int result = 0;
+    uint64_t number;
+    FileType type;
+    for (const std::string& file : files) {
+      if (ParseFileName(file, &number, &type) && type == kBlobFile) {
+        result++;
+      }
+    }
+    return result;
+  }
+
+  // Return the number of sorted runs of a tiered database: every level-0
+  // file and every other non-empty level.
+  int NumSortedRuns() {
+    int runs = NumTableFilesAtLevel(0);
+    for (int level = 1; level < config::kNumLevels; level++) {
+      if (NumTableFilesAtLevel(level) > 0) {
+        runs++;
+      }
+    }
+    return runs;
+  }
+
+  // Wait for the background compactions of a tiered database to bring
+  // the number of sorted runs under the trigger.
+  void WaitForTieredCompactions() {
+    for (int i = 0; i < 1000; i++) {
+      if (NumSortedRuns() < config::kL0_CompactionTrigger) {
+        break;
+      }
+      DelayMilliseconds(10);
+    }
+  }
+
   uint64_t Size(const Slice& start, const Slice& limit) {
     Range r(start, limit);
     uint64_t size;
@@ -511,6 +613,22 @@ class DBTest : public testing::Test {
     return false;
   }
 
+  // Returns the number of the newest MANIFEST file, or 0 if there is none.
+  uint64_t NewestManifestNumber() {
+    std::vector<std::string> filenames;
+    EXPECT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+    uint64_t number;
+    FileType type;
+    uint64_t newest = 0;
+    for (size_t i = 0; i < filenames.size(); i++) {
+      if (ParseFileName(filenames[i], &number, &type) &&
+          type == kDescriptorFile && number > newest) {
+        newest = number;
+      }
+    }
+    return newest;
+  }
+
   // Returns number of files renamed.
   int RenameLDBToSST() {
     std::vector<std::string> filenames;
@@ -531,9 +649,19 @@ class DBTest : public testing::Test {
 
  private:
   // Sequence of option configurations to try
-  enum OptionConfig { kDefault, kReuse, kFilter, kUncompressed, kEnd };
+  enum OptionConfig {
+    kDefault,
+    kReuse,
+    kFilter,
+    kUncompressed,
+    kMemTableBloom,
+    kUnlimitedOpenFiles,
+    kBlobFiles,
+    kEnd
+  };
 
   const FilterPolicy* filter_policy_;
+  AppendMergeOperator merge_operator_;
   int option_config_;
 };
 
@@ -625,6 +753,28 @@ TEST_F(DBTest, GetMemUsage) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetFollowsStateChanges) {
+  do {
+    ASSERT_LEVELDB_OK(Put("foo", "v1"));
+    ASSERT_EQ("v1", Get("foo"));  // Caches the read state in a slot
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    ASSERT_LEVELDB_OK(Put("foo", "v2"));
+    ASSERT_EQ("v2", Get("foo"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("v2", Get("foo"));
+    ASSERT_LEVELDB_OK(Put("foo", "v3"));
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_EQ("v3", Get("foo"));
+
+    // The iterator keeps reading from the state it was created with.
+    iter->SeekToFirst();
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ("v1", iter->value().ToString());
+    delete iter;
+    ASSERT_EQ("v3", Get("foo"));
+  } while (ChangeOptions());
+}
+
 TEST_F(DBTest, GetSnapshot) {
   do {
     // Try with both a short key and a long key
@@ -946,6 +1096,132 @@ TEST_F(DBTest, IterSmallAndLargeMix) {
   delete iter;
 }
 
+TEST_F(DBTest, TailingIterator) {
+  do {
+    ReadOptions options;
+    options.tailing = true;
+    Iterator* iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    // Every seek sees the writes made before it.
+    ASSERT_LEVELDB_OK(Put("a", "va"));
+    iter->Seek("a");
+    ASSERT_EQ(IterStatus(iter), "a->va");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    ASSERT_LEVELDB_OK(Put("b", "vb"));
+    iter->Seek("b");
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+
+    // Also across memtable switches and compactions.
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(Put("c", "vc"));
+    iter->Seek("b");
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    ASSERT_LEVELDB_OK(Delete("a"));
+    dbfull()->TEST_CompactMemTable();
+    dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+    ASSERT_LEVELDB_OK(Put("d", "vd"));
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "b->vb");
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    delete iter;
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, IterateBounds) {
+  do {
+    for (char c = 'a'; c <= 'z'; c++) {
+      ASSERT_LEVELDB_OK(Put(std::string(1, c), std::string("v") + c));
+    }
+    dbfull()->TEST_CompactMemTable();
+    // Deleted entries past the bound are not visited.
+    for (char c = 'f'; c <= 'y'; c++) {
+      ASSERT_LEVELDB_OK(Delete(std::string(1, c)));
+    }
+
+    Slice lower("c");
+    Slice upper("f");
+    ReadOptions options;
+    options.iterate_lower_bound = &lower;
+    options.iterate_upper_bound = &upper;
+    Iterator* iter = db_->NewIterator(options);
+    iter->SeekToFirst();
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "e->ve");
+    iter->Next();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    iter->SeekToLast();
+    ASSERT_EQ(IterStatus(iter), "e->ve");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+
+    iter->Seek("a");
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    iter->Seek("d");
+    ASSERT_EQ(IterStatus(iter), "d->vd");
+    iter->Prev();
+    ASSERT_EQ(IterStatus(iter), "c->vc");
+    iter->Seek("f");
+    ASSERT_EQ(IterStatus(iter), "(invalid)");
+    delete iter;
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, IterateBoundsSkipTables) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("b", "vb"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put("x", "vx"));
+  ASSERT_LEVELDB_OK(Put("y", "vy"));
+  dbfull()->TEST_CompactMemTable();
+
+  // Count the reads of a scan of ["a", "c").
+  Slice upper("c");
+  int reads[2];
+  for (int bounded = 0; bounded < 2; bounded++) {
+    Reopen(&options);  // Close the tables
+    env_->random_read_counter_.Reset();
+    ReadOptions read_options;
+    if (bounded) {
+      read_options.iterate_upper_bound = &upper;
+    }
+    Iterator* iter = db_->NewIterator(read_options);
+    std::string result;
+    for (iter->SeekToFirst(); iter->Valid() && iter->key().compare(upper) < 0;
+         iter->Next()) {
+      result += iter->key().ToString();
+    }
+    ASSERT_EQ("ab", result);
+    delete iter;
+    reads[bounded] = env_->random_read_counter_.Read();
+  }
+  // The table holding "x" and "y" is never opened.
+  ASSERT_LT(reads[1], reads[0]);
+
+  Close();
+  delete options.block_cache;
+}
+
 TEST_F(DBTest, IterMultiWithDelete) {
   do {
     ASSERT_LEVELDB_OK(Put("a", "va"));
@@ -1028,6 +1304,65 @@ static std::string Key(int i) {
   return std::string(buf);
 }
 
+TEST_F(DBTest, RangeIterators) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;  // Small write buffer
+  Reopen(&options);
+
+  const int kNumKeys = 2000;
+  Random rnd(301);
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_GT(TotalTableFiles(), 4);
+
+  // Shards cover the range exactly once, in order, at one snapshot.
+  const std::string expected = Contents();
+  std::vector<Iterator*> iters;
+  ASSERT_LEVELDB_OK(
+      db_->NewRangeIterators(ReadOptions(), nullptr, nullptr, 4, &iters));
+  ASSERT_GT(iters.size(), 1);
+  ASSERT_LE(iters.size(), 4);
+  for (int i = 0; i < kNumKeys; i += 2) {
+    ASSERT_LEVELDB_OK(Delete(Key(i)));
+  }
+  std::string actual;
+  size_t smallest_shard = kNumKeys;
+  for (Iterator* iter : iters) {
+    size_t count = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      actual += "(" + IterStatus(iter) + ")";
+      count++;
+    }
+    ASSERT_LEVELDB_OK(iter->status());
+    smallest_shard = std::min(smallest_shard, count);
+    delete iter;
+  }
+  ASSERT_EQ(expected, actual);
+  ASSERT_GT(smallest_shard, kNumKeys / iters.size() / 4);
+
+  // A bounded range
+  Slice start(Key(100));
+  Slice limit(Key(900));
+  ASSERT_LEVELDB_OK(db_->NewRangeIterators(ReadOptions(), &start, &limit, 3,
+                                           &iters));
+  ASSERT_GE(iters.size(), 1);
+  int count = 0;
+  std::string last;
+  for (Iterator* iter : iters) {
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      ASSERT_GE(iter->key().ToString(), Key(100));
+      ASSERT_LT(iter->key().ToString(), Key(900));
+      ASSERT_GT(iter->key().ToString(), last);
+      last = iter->key().ToString();
+      count++;
+    }
+    delete iter;
+  }
+  ASSERT_EQ(400, count);  // Odd keys only
+}
+
 TEST_F(DBTest, MinorCompactionsHappen) {
   Options options = CurrentOptions();
   options.write_buffer_size = 10000;
@@ -1077,6 +1412,84 @@ TEST_F(DBTest, RecoverWithLargeLog) {
   ASSERT_GT(NumTableFilesAtLevel(0), 1);
 }
 
+TEST_F(DBTest, ParallelRecovery) {
+  // Overwrite every key several times so that tables built from later
+  // parts of the log must shadow the earlier ones.
+  {
+    Options options = CurrentOptions();
+    options.write_buffer_size = 10 << 20;
+    Reopen(&options);
+    for (int round = 0; round < 4; round++) {
+      for (int i = 0; i < 500; i++) {
+        ASSERT_LEVELDB_OK(Put(Key(i), std::string(1000, 'a' + round)));
+      }
+    }
+    ASSERT_EQ(NumTableFilesAtLevel(0), 0);
+  }
+
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;
+  options.max_recovery_threads = 4;
+  Reopen(&options);
+  for (int i = 0; i < 500; i++) {
+    ASSERT_EQ(std::string(1000, 'd'), Get(Key(i)));
+  }
+  ASSERT_LEVELDB_OK(Put(Key(0), "new"));
+  Reopen(&options);
+  ASSERT_EQ("new", Get(Key(0)));
+  ASSERT_EQ(std::string(1000, 'd'), Get(Key(499)));
+}
+
+TEST_F(DBTest, ManifestRollover) {
+  Options options = CurrentOptions();
+  options.max_file_size = 1 << 20;  // Also the MANIFEST size limit
+  Reopen(&options);
+  const uint64_t initial_manifest = NewestManifestNumber();
+
+  // Every flush records a table whose boundary keys are large, so the
+  // MANIFEST quickly grows past its limit.
+  for (int i = 0; i < 40; i++) {
+    const std::string key = std::string(100000, 'k') + Key(i);
+    ASSERT_LEVELDB_OK(Put(key, Key(i)));
+    dbfull()->TEST_CompactMemTable();
+  }
+  ASSERT_GT(NewestManifestNumber(), initial_manifest);
+
+  Reopen(&options);
+  for (int i = 0; i < 40; i++) {
+    ASSERT_EQ(Key(i), Get(std::string(100000, 'k') + Key(i)));
+  }
+}
+
+TEST_F(DBTest, MemTableArenaBlockPool) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 100000;
+  options.memtable_arena_block_size = 64 << 10;
+  options.memtable_huge_pages = true;
+  options.memtable_numa_node = 0;
+  Reopen(&options);
+
+  // Fill several memtables so that pooled blocks are recycled.
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 200; i++) {
+    values.push_back(RandomString(&rnd, 5000));
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_GT(NumTableFilesAtLevel(0) + NumTableFilesAtLevel(1) +
+                NumTableFilesAtLevel(2),
+            1);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+
+  // Recovery builds its memtables from the pool as well.
+  Reopen(&options);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
 TEST_F(DBTest, CompactionsGenerateMultipleFiles) {
   Options options = CurrentOptions();
   options.write_buffer_size = 100000000;  // Large write buffer
@@ -1174,6 +1587,9 @@ static bool Between(uint64_t val, uint64_t low, uint64_t high) {
 
 TEST_F(DBTest, ApproximateSizes) {
   do {
+    if (CurrentOptions().min_blob_size > 0) {
+      continue;  // Approximate sizes do not cover values in blob files
+    }
     Options options = CurrentOptions();
     options.write_buffer_size = 100000000;  // Large write buffer
     options.compression = kNoCompression;
@@ -1233,6 +1649,9 @@ TEST_F(DBTest, ApproximateSizes) {
 
 TEST_F(DBTest, ApproximateSizes_MixOfSmallAndLarge) {
   do {
+    if (CurrentOptions().min_blob_size > 0) {
+      continue;  // Approximate sizes do not cover values in blob files
+    }
     Options options = CurrentOptions();
     options.compression = kNoCompression;
     Reopen();
@@ -1328,6 +1747,9 @@ TEST_F(DBTest, Snapshot) {
 
 TEST_F(DBTest, HiddenValuesAreRemoved) {
   do {
+    if (CurrentOptions().min_blob_size > 0) {
+      continue;  // Approximate sizes do not cover values in blob files
+    }
     Random rnd(301);
     FillLevels("a", "z");
 
@@ -1412,68 +1834,786 @@ TEST_F(DBTest, DeletionMarkers2) {
   ASSERT_EQ(AllEntriesFor("foo"), "[ ]");
 }
 
-TEST_F(DBTest, OverlapInLevel0) {
+TEST_F(DBTest, DeleteRange) {
   do {
-    ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
-
-    // Fill levels 1 and 2 to disable the pushing of new memtables to levels >
-    // 0.
-    ASSERT_LEVELDB_OK(Put("100", "v100"));
-    ASSERT_LEVELDB_OK(Put("999", "v999"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_LEVELDB_OK(Delete("100"));
-    ASSERT_LEVELDB_OK(Delete("999"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("0,1,1", FilesPerLevel());
-
-    // Make files spanning the following ranges in level-0:
-    //  files[0]  200 .. 900
-    //  files[1]  300 .. 500
-    // Note that files are sorted by smallest key.
-    ASSERT_LEVELDB_OK(Put("300", "v300"));
-    ASSERT_LEVELDB_OK(Put("500", "v500"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_LEVELDB_OK(Put("200", "v200"));
-    ASSERT_LEVELDB_OK(Put("600", "v600"));
-    ASSERT_LEVELDB_OK(Put("900", "v900"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("2,1,1", FilesPerLevel());
-
-    // Compact away the placeholder files we created initially
-    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
-    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
-    ASSERT_EQ("2", FilesPerLevel());
+    ASSERT_LEVELDB_OK(Put("a", "va"));
+    ASSERT_LEVELDB_OK(Put("b", "vb"));
+    ASSERT_LEVELDB_OK(Put("bb", "vbb"));
+    ASSERT_LEVELDB_OK(Put("c", "vc"));
+    ASSERT_LEVELDB_OK(Put("d", "vd"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+    ASSERT_LEVELDB_OK(Put("c", "vc2"));
+
+    // The range deletion is read from the memtable, a level-0 table and
+    // then the compacted table.
+    for (int i = 0; i < 3; i++) {
+      ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+      ASSERT_EQ("NOT_FOUND", Get("b"));
+      ASSERT_EQ("NOT_FOUND", Get("bb"));
+      ASSERT_EQ("vc2", Get("c"));
+      ASSERT_EQ("vd", Get("d"));
+      ASSERT_EQ("vb", Get("b", snapshot));
+      ASSERT_EQ("vc", Get("c", snapshot));
+      if (i == 0) {
+        ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+      } else if (i == 1) {
+        db_->CompactRange(nullptr, nullptr);
+      }
+    }
+    db_->ReleaseSnapshot(snapshot);
 
-    // Do a memtable compaction.  Before bug-fix, the compaction would
-    // not detect the overlap with level-0 files and would incorrectly place
-    // the deletion in a deeper level.
-    ASSERT_LEVELDB_OK(Delete("600"));
-    dbfull()->TEST_CompactMemTable();
-    ASSERT_EQ("3", FilesPerLevel());
-    ASSERT_EQ("NOT_FOUND", Get("600"));
+    Reopen();
+    ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+    ASSERT_EQ("NOT_FOUND", Get("b"));
   } while (ChangeOptions());
 }
 
-TEST_F(DBTest, L0_CompactionBug_Issue44_a) {
-  Reopen();
-  ASSERT_LEVELDB_OK(Put("b", "v"));
-  Reopen();
-  ASSERT_LEVELDB_OK(Delete("b"));
-  ASSERT_LEVELDB_OK(Delete("a"));
-  Reopen();
-  ASSERT_LEVELDB_OK(Delete("a"));
-  Reopen();
-  ASSERT_LEVELDB_OK(Put("a", "v"));
-  Reopen();
-  Reopen();
-  ASSERT_EQ("(a->v)", Contents());
-  DelayMilliseconds(1000);  // Wait for compaction to finish
-  ASSERT_EQ("(a->v)", Contents());
+TEST_F(DBTest, DeleteRangeOverlapping) {
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v1"));
+  }
+  const Snapshot* before = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), Key(2), Key(6)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(3)));
+  ASSERT_EQ("v1", Get(Key(7)));
+
+  // A range deletion added after a lookup is seen by the next one.
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), Key(4), Key(8)));
+  ASSERT_LEVELDB_OK(Put(Key(3), "v2"));
+  const Snapshot* middle = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), Key(3), Key(5)));
+
+  // The range deletions are read from the memtable, then from a table.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ("v1", Get(Key(1)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(2)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(3)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(4)));
+    ASSERT_EQ("NOT_FOUND", Get(Key(7)));
+    ASSERT_EQ("v1", Get(Key(8)));
+    ASSERT_EQ("v1", Get(Key(3), before));
+    ASSERT_EQ("v1", Get(Key(7), before));
+    ASSERT_EQ("v2", Get(Key(3), middle));
+    ASSERT_EQ("NOT_FOUND", Get(Key(4), middle));
+    ASSERT_EQ("NOT_FOUND", Get(Key(2), middle));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  db_->ReleaseSnapshot(middle);
+  db_->ReleaseSnapshot(before);
 }
 
-TEST_F(DBTest, L0_CompactionBug_Issue44_b) {
-  Reopen();
-  Put("", "");
+TEST_F(DBTest, DeleteRangeDropsCoveredEntries) {
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("b", "vb"));
+  ASSERT_LEVELDB_OK(Put("c", "vc"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), "b", "c"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  ASSERT_EQ("[ vb ]", AllEntriesFor("b"));
+
+  // Merging level 1 into the last level drops "b" along with the range
+  // deletion, which has nothing left to delete.
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ ]", AllEntriesFor("b"));
+  ASSERT_EQ("(a->va)(c->vc)", Contents());
+}
+
+TEST_F(DBTest, DeleteRangeSkipsCoveredTables) {
+  for (int i = 0; i < 100; i++) {
+    char key[10];
+    std::snprintf(key, sizeof(key), "k%03d", i);
+    ASSERT_LEVELDB_OK(Put(key, std::string(1000, 'v')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  std::vector<std::string> filenames;
+  ASSERT_LEVELDB_OK(env_->GetChildren(dbname_, &filenames));
+  std::string covered;
+  uint64_t number;
+  FileType type;
+  for (const std::string& filename : filenames) {
+    if (ParseFileName(filename, &number, &type) && type == kTableFile) {
+      covered = dbname_ + "/" + filename;
+    }
+  }
+  ASSERT_FALSE(covered.empty());
+
+  // The range deletion lands in level 1, above the table it covers.
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), "k", "l"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  ASSERT_EQ("", Contents());
+
+  // Compacting level 1 drops the covered table without reading it, so
+  // the compaction succeeds even though the table is gone.
+  Reopen();
+  ASSERT_LEVELDB_OK(env_->RemoveFile(covered));
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("", FilesPerLevel());
+  ASSERT_EQ("", Contents());
+  ASSERT_LEVELDB_OK(Put("k050", "v"));
+  ASSERT_EQ("v", Get("k050"));
+}
+
+TEST_F(DBTest, Merge) {
+  do {
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "1"));
+    ASSERT_LEVELDB_OK(Put("b", "x"));
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "b", "2"));
+    ASSERT_LEVELDB_OK(Put("c", "y"));
+    ASSERT_LEVELDB_OK(Delete("c"));
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "c", "3"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "4"));
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "b", "5"));
+
+    // The operands are read from the memtable, a level-0 table and then
+    // the compacted table.
+    for (int i = 0; i < 3; i++) {
+      ASSERT_EQ("(a->1,4)(b->x,2,5)(c->3)", Contents());
+      ASSERT_EQ("1,4", Get("a"));
+      ASSERT_EQ("x,2,5", Get("b"));
+      ASSERT_EQ("3", Get("c"));
+      ASSERT_EQ("1", Get("a", snapshot));
+      ASSERT_EQ("x,2", Get("b", snapshot));
+      if (i == 0) {
+        ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+      } else if (i == 1) {
+        db_->CompactRange(nullptr, nullptr);
+      }
+    }
+    db_->ReleaseSnapshot(snapshot);
+
+    // Operands in the memtable apply to values in the tables.
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "b", "6"));
+    Reopen();
+    ASSERT_EQ("(a->1,4)(b->x,2,5,6)(c->3)", Contents());
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, MergeFoldsOperandsInCompaction) {
+  ASSERT_LEVELDB_OK(Put("a", "begin"));
+  ASSERT_LEVELDB_OK(Put("k", "v"));
+  ASSERT_LEVELDB_OK(Put("z", "end"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "k", "1"));
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "k", "2"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "k", "3"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+  ASSERT_EQ("[ MERGE 3, MERGE 2, MERGE 1, v ]", AllEntriesFor("k"));
+
+  // Operands are combined while the value beneath them is out of reach...
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ("[ MERGE 1,2,3, v ]", AllEntriesFor("k"));
+  ASSERT_EQ("v,1,2,3", Get("k"));
+
+  // ...and applied to the value once the compaction reaches it.
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("[ v,1,2,3 ]", AllEntriesFor("k"));
+  ASSERT_EQ("v,1,2,3", Get("k"));
+}
+
+namespace {
+// Deletes the values "drop" and changes the values "change".
+class TestCompactionFilter : public CompactionFilter {
+ public:
+  const char* Name() const override { return "test.CompactionFilter"; }
+
+  bool Filter(int level, const Slice& key, const Slice& value,
+              std::string* new_value, bool* value_changed) const override {
+    if (value == "change") {
+      *new_value = "changed";
+      *value_changed = true;
+    }
+    return value == "drop";
+  }
+};
+}  // namespace
+
+TEST_F(DBTest, CompactionFilter) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("k", "old"));
+  ASSERT_LEVELDB_OK(Put("z", "vz"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(Put("b", "vb"));
+  ASSERT_LEVELDB_OK(Put("y", "vy"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(Put("c", "change"));
+  ASSERT_LEVELDB_OK(Put("k", "drop"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("s", "drop"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("1,1,1", FilesPerLevel());
+  ASSERT_EQ("drop", Get("k"));
+
+  // The older value of "k" below the compaction must stay hidden, so a
+  // deletion replaces the dropped value.  The snapshot keeps "s".
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ("[ DEL, old ]", AllEntriesFor("k"));
+  ASSERT_EQ("NOT_FOUND", Get("k"));
+  ASSERT_EQ("changed", Get("c"));
+  ASSERT_EQ("drop", Get("s"));
+
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("[ ]", AllEntriesFor("k"));
+  ASSERT_EQ("NOT_FOUND", Get("s"));
+  ASSERT_EQ("(a->va)(b->vb)(c->changed)(y->vy)(z->vz)", Contents());
+}
+
+TEST_F(DBTest, TTLCompactionFilter) {
+  const CompactionFilter* filter = NewTTLCompactionFilter(3600, env_);
+  Options options = CurrentOptions();
+  options.compaction_filter = filter;
+  Reopen(&options);
+
+  const uint64_t now = env_->NowMicros() / 1000000;
+  std::string expired = "v1", live = "v2";
+  AppendTTLTimestamp(&expired, now - 7200);
+  AppendTTLTimestamp(&live, now - 60);
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("z", "vz"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(Put("expired", expired));
+  ASSERT_LEVELDB_OK(Put("live", live));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  ASSERT_EQ(expired, Get("expired"));
+
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get("expired"));
+  ASSERT_EQ(live, Get("live"));
+  ASSERT_EQ("va", Get("a"));
+
+  Close();
+  delete filter;
+}
+
+TEST_F(DBTest, BlobFiles) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  const std::string big1(1000, 'x'), big2(2000, 'y');
+  ASSERT_LEVELDB_OK(Put("a", "small"));
+  ASSERT_LEVELDB_OK(Put("b", big1));
+  ASSERT_LEVELDB_OK(Put("c", big2));
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "c", "z"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(1, NumBlobFiles());
+  ASSERT_EQ("[ small ]", AllEntriesFor("a"));
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("b"));
+  ASSERT_EQ("[ MERGE z, BLOB ]", AllEntriesFor("c"));
+
+  ASSERT_EQ(big1, Get("b"));
+  ASSERT_EQ(big2 + ",z", Get("c"));
+  const std::string contents =
+      "(a->small)(b->" + big1 + ")(c->" + big2 + ",z)";
+  ASSERT_EQ(contents, Contents());
+
+  // The merge result is moved to a blob file of its own.
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("[ BLOB ]", AllEntriesFor("c"));
+  ASSERT_EQ(2, NumBlobFiles());
+  ASSERT_EQ(contents, Contents());
+
+  Reopen(&options);
+  ASSERT_EQ(contents, Contents());
+  ASSERT_EQ(2, CountBlobFilesOnDisk());
+
+  // Repair finds the blob files that the tables refer to.
+  Close();
+  ASSERT_LEVELDB_OK(RepairDB(dbname_, options));
+  Reopen(&options);
+  ASSERT_EQ(contents, Contents());
+  ASSERT_EQ(2, NumBlobFiles());
+}
+
+TEST_F(DBTest, BlobGarbageCollection) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  options.blob_gc_live_ratio = 0.5;
+  Reopen(&options);
+
+  Random rnd(301);
+  std::string values[10];
+  for (int i = 0; i < 10; i++) {
+    values[i] = RandomString(&rnd, 1000);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(1, NumBlobFiles());
+
+  // Overwrite most of the values, leaving little of the first blob file
+  // referenced once the old values are compacted away.
+  for (int i = 0; i < 7; i++) {
+    values[i] = RandomString(&rnd, 1000);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(2, NumBlobFiles());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  std::string property;
+  ASSERT_TRUE(db_->GetProperty("leveldb.sstables", &property));
+  ASSERT_NE(std::string::npos, property.find(" live 3000 of 10000 bytes"));
+
+  // The next compaction copies the remaining values out of the first
+  // blob file, which is then deleted.
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_TRUE(db_->GetProperty("leveldb.sstables", &property));
+  ASSERT_EQ(std::string::npos, property.find(" live 3000 of 10000 bytes"));
+  ASSERT_NE(std::string::npos, property.find(" live 3000 of 3000 bytes"));
+  ASSERT_EQ(2, NumBlobFiles());
+  ASSERT_EQ(2, CountBlobFilesOnDisk());
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+
+  // Without value separation, collected values move back into the tables.
+  for (int i = 0; i < 9; i++) {
+    ASSERT_LEVELDB_OK(Delete(Key(i)));
+  }
+  options.min_blob_size = 0;
+  Reopen(&options);
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+  }
+  ASSERT_EQ(0, NumBlobFiles());
+  ASSERT_EQ(0, CountBlobFilesOnDisk());
+  ASSERT_EQ("[ " + values[9] + " ]", AllEntriesFor(Key(9)));
+}
+
+TEST_F(DBTest, BlobGarbageOfTablesUnderRangeDeletion) {
+  Options options = CurrentOptions();
+  options.min_blob_size = 100;
+  Reopen(&options);
+
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(1000, 'v')));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ(1, NumBlobFiles());
+
+  // Dropping the covered table without copying it still releases the
+  // values it held in the blob file.
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), Key(0), Key(10)));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("", FilesPerLevel());
+  ASSERT_EQ(0, NumBlobFiles());
+  ASSERT_EQ(0, CountBlobFilesOnDisk());
+  ASSERT_EQ("", Contents());
+}
+
+TEST_F(DBTest, TieredCompaction) {
+  Options options = CurrentOptions();
+  options.compaction_style = kTieredCompaction;
+  Reopen(&options);
+
+  Random rnd(301);
+  std::map<std::string, std::string> model;
+  for (int run = 0; run < 20; run++) {
+    for (int i = 0; i < 100; i++) {
+      const std::string key = Key(rnd.Uniform(1000));
+      model[key] = RandomString(&rnd, 200);
+      ASSERT_LEVELDB_OK(Put(key, model[key]));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    if (run == 0) {
+      // Flushes always start a new run in level-0.
+      ASSERT_EQ("1", FilesPerLevel());
+    }
+    WaitForTieredCompactions();
+    ASSERT_LT(NumSortedRuns(), config::kL0_CompactionTrigger);
+  }
+  ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+  for (const auto& kv : model) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+
+  // The database may be reopened with leveled compaction.
+  options.compaction_style = kLeveledCompaction;
+  Reopen(&options);
+  dbfull()->CompactRange(nullptr, nullptr);
+  for (const auto& kv : model) {
+    ASSERT_EQ(kv.second, Get(kv.first));
+  }
+}
+
+TEST_F(DBTest, TieredCompactionSpaceAmplification) {
+  Options options = CurrentOptions();
+  options.compaction_style = kTieredCompaction;
+  options.tiered_max_size_amplification_percent = 200;
+  Reopen(&options);
+
+  // Each run overwrites every key, so merging runs yields a run no larger
+  // than one of them.  Whenever there are enough runs to compact, the
+  // newer ones hold three times the bytes of the oldest, so everything is
+  // merged into a single run in the last level.
+  Random rnd(301);
+  for (int run = 1; run <= 12; run++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), RandomString(&rnd, 1000)));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    WaitForTieredCompactions();
+    if (run < config::kL0_CompactionTrigger) {
+      ASSERT_EQ(run, NumTableFilesAtLevel(0));
+    } else {
+      const int newer_runs =
+          (run - config::kL0_CompactionTrigger) %
+          (config::kL0_CompactionTrigger - 1);
+      ASSERT_EQ(newer_runs, NumTableFilesAtLevel(0));
+      ASSERT_EQ(newer_runs + 1, NumSortedRuns());
+      ASSERT_EQ(1, NumTableFilesAtLevel(config::kNumLevels - 1));
+    }
+  }
+}
+
+TEST_F(DBTest, DynamicLevelBytes) {
+  Options options = CurrentOptions();
+  options.write_buffer_size = 64 << 10;
+  options.max_bytes_for_level_base = 64 << 10;
+  options.dynamic_level_bytes = true;
+  Reopen(&options);
+
+  // Each batch fits in one memtable, and compactions settle after every
+  // flush, so the shape of the tree does not depend on timing.
+  Random rnd(301);
+  std::vector<std::string> values;
+  auto write_batches = [&](size_t limit) {
+    while (values.size() < limit) {
+      const int i = static_cast<int>(values.size());
+      values.push_back(RandomString(&rnd, 1000));
+      ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+      if (values.size() % 40 == 0 || values.size() == limit) {
+        ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+        dbfull()->TEST_WaitForCompactions();
+      }
+    }
+  };
+
+  // Level-0 compacts straight into the last level while it is small.
+  write_batches(300);
+  for (int level = 1; level < config::kNumLevels - 1; level++) {
+    ASSERT_EQ(0, NumTableFilesAtLevel(level)) << level;
+  }
+  ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 1), 0);
+
+  // Once the last level is ten times the base size, the level before it
+  // comes into use, but no earlier one.
+  write_batches(2000);
+  for (int level = 1; level < config::kNumLevels - 2; level++) {
+    ASSERT_EQ(0, NumTableFilesAtLevel(level)) << level;
+  }
+  ASSERT_GT(NumTableFilesAtLevel(config::kNumLevels - 2), 0);
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+
+  // Data placed in the unused levels by static limits drains away. The
+  // first flush is pushed down to level 2, and the second one overlaps it
+  // and so stops in level 1.
+  options.dynamic_level_bytes = false;
+  Reopen(&options);
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 40; i++) {
+      values[i] = RandomString(&rnd, 1000);
+      ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  ASSERT_EQ(1, NumTableFilesAtLevel(1));
+  ASSERT_EQ(1, NumTableFilesAtLevel(2));
+  options.dynamic_level_bytes = true;
+  Reopen(&options);
+  dbfull()->TEST_WaitForCompactions();
+  for (int level = 1; level < config::kNumLevels - 2; level++) {
+    ASSERT_EQ(0, NumTableFilesAtLevel(level)) << level;
+  }
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, CompactionPickPolicies) {
+  const CompactionPickPolicy policies[] = {kPickRoundRobin, kPickMinOverlap,
+                                           kPickMostDeletions};
+  for (CompactionPickPolicy policy : policies) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.write_buffer_size = 64 << 10;
+    options.max_bytes_for_level_base = 64 << 10;
+    options.compaction_pick_policy = policy;
+    DestroyAndReopen(&options);
+
+    Random rnd(301);
+    std::map<std::string, std::string> model;
+    for (int i = 0; i < 4000; i++) {
+      const std::string key = Key(rnd.Uniform(1000));
+      if (rnd.OneIn(4)) {
+        model.erase(key);
+        ASSERT_LEVELDB_OK(Delete(key));
+      } else {
+        model[key] = RandomString(&rnd, 500);
+        ASSERT_LEVELDB_OK(Put(key, model[key]));
+      }
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    DelayMilliseconds(1000);  // Wait for compaction to finish
+    ASSERT_GT(NumTableFilesAtLevel(2), 0) << policy;
+
+    Reopen(&options);
+    for (int i = 0; i < 1000; i++) {
+      auto it = model.find(Key(i));
+      ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second, Get(Key(i)));
+    }
+  }
+}
+
+namespace {
+// Counts the values compacted, and sleeps on each of them while "slow"
+// is set.
+class SlowCompactionFilter : public CompactionFilter {
+ public:
+  SlowCompactionFilter() : slow(false), count(0) {}
+
+  const char* Name() const override { return "test.SlowCompactionFilter"; }
+
+  bool Filter(int level, const Slice& key, const Slice& value,
+              std::string* new_value, bool* value_changed) const override {
+    count.fetch_add(1, std::memory_order_relaxed);
+    if (slow.load(std::memory_order_acquire)) {
+      DelayMilliseconds(1);
+    }
+    return false;
+  }
+
+  std::atomic<bool> slow;
+  mutable std::atomic<int> count;
+};
+}  // namespace
+
+TEST_F(DBTest, IntraL0Compaction) {
+  SlowCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.compaction_filter = &filter;
+  Reopen(&options);
+
+  // Fill levels 1 and 2 so that memtables are written to level-0.
+  for (int i = 0; i < 2; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(0), "base"));
+    ASSERT_LEVELDB_OK(Put(Key(999), "base"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // Start a long level-0 compaction.
+  filter.slow.store(true, std::memory_order_release);
+  for (int i = 0; i < config::kL0_CompactionTrigger; i++) {
+    for (int j = i; j < 1000; j += config::kL0_CompactionTrigger) {
+      ASSERT_LEVELDB_OK(Put(Key(j), "old"));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  while (filter.count.load(std::memory_order_relaxed) == 0) {
+    DelayMilliseconds(1);
+  }
+
+  // Memtables flushed meanwhile pile up in level-0.
+  for (int i = 0; i < config::kL0_SlowdownWritesTrigger; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(0), "v"));
+    ASSERT_LEVELDB_OK(Put(Key(500), "v" + NumberToString(i)));
+    ASSERT_LEVELDB_OK(Put(Key(999), "v"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  filter.slow.store(false, std::memory_order_release);
+
+  // They are merged into one level-0 file rather than pushed down.
+  for (int i = 0; i < 1000 && NumTableFilesAtLevel(0) != 1; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  ASSERT_EQ("v7", Get(Key(500)));
+  ASSERT_EQ("old", Get(Key(501)));
+
+  Reopen(&options);
+  ASSERT_EQ(1, NumTableFilesAtLevel(0));
+  ASSERT_EQ("v7", Get(Key(500)));
+  ASSERT_EQ("v", Get(Key(999)));
+}
+
+TEST_F(DBTest, DeletionTriggeredCompaction) {
+  Options options = CurrentOptions();
+  options.deletion_compaction_window = 100;
+  options.deletion_compaction_trigger = 50;
+  Reopen(&options);
+
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+
+  // Scattered deletions leave the table where it is.
+  for (int i = 0; i < 1000; i++) {
+    if (i % 20 == 0) {
+      ASSERT_LEVELDB_OK(Delete(Key(i)));
+    } else {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v2"));
+    }
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  DelayMilliseconds(100);
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // A dense run of them gets it compacted down, which drops them.
+  for (int i = 100; i < 400; i++) {
+    ASSERT_LEVELDB_OK(Delete(Key(i)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < 1000 && FilesPerLevel() != "0,0,1"; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(200)));
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(500)));
+  ASSERT_EQ("[ v2 ]", AllEntriesFor(Key(501)));
+}
+
+TEST_F(DBTest, PeriodicCompaction) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.periodic_compaction_seconds = 3600;
+  Reopen(&options);
+
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "old"));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(Put(Key(0), "new"));
+  ASSERT_LEVELDB_OK(Put(Key(99), "new"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  Reopen(&options);
+  DelayMilliseconds(100);
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // Once the tables are old enough, they are compacted, which merges the
+  // newer values into the older table.
+  env_->clock_offset_micros_.store(2 * 3600 * 1000000ull,
+                                   std::memory_order_relaxed);
+  Reopen(&options);
+  for (int i = 0; i < 1000 && FilesPerLevel() != "0,0,1"; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ new ]", AllEntriesFor(Key(0)));
+  ASSERT_EQ("[ old ]", AllEntriesFor(Key(1)));
+
+  // Tables that grow old while the database is open are found by reads.
+  ASSERT_LEVELDB_OK(Put(Key(1), "newer"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+  env_->clock_offset_micros_.store(4 * 3600 * 1000000ull,
+                                   std::memory_order_relaxed);
+  ASSERT_EQ("newer", Get(Key(1)));
+  dbfull()->TEST_WaitForCompactions();
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ newer ]", AllEntriesFor(Key(1)));
+}
+
+TEST_F(DBTest, MergeWithoutOperator) {
+  Options options = CurrentOptions();
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "k", "1"));
+  options.merge_operator = nullptr;
+  Reopen(&options);
+  ASSERT_TRUE(db_->Merge(WriteOptions(), "k", "2").IsInvalidArgument());
+  std::string value;
+  ASSERT_TRUE(db_->Get(ReadOptions(), "k", &value).IsNotSupportedError());
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->SeekToFirst();
+  ASSERT_FALSE(iter->Valid());
+  ASSERT_TRUE(iter->status().IsNotSupportedError());
+  delete iter;
+}
+
+TEST_F(DBTest, OverlapInLevel0) {
+  do {
+    ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
+
+    // Fill levels 1 and 2 to disable the pushing of new memtables to levels >
+    // 0.
+    ASSERT_LEVELDB_OK(Put("100", "v100"));
+    ASSERT_LEVELDB_OK(Put("999", "v999"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(Delete("100"));
+    ASSERT_LEVELDB_OK(Delete("999"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,1,1", FilesPerLevel());
+
+    // Make files spanning the following ranges in level-0:
+    //  files[0]  200 .. 900
+    //  files[1]  300 .. 500
+    // Note that files are sorted by smallest key.
+    ASSERT_LEVELDB_OK(Put("300", "v300"));
+    ASSERT_LEVELDB_OK(Put("500", "v500"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_LEVELDB_OK(Put("200", "v200"));
+    ASSERT_LEVELDB_OK(Put("600", "v600"));
+    ASSERT_LEVELDB_OK(Put("900", "v900"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("2,1,1", FilesPerLevel());
+
+    // Compact away the placeholder files we created initially
+    dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("2", FilesPerLevel());
+
+    // Do a memtable compaction.  Before bug-fix, the compaction would
+    // not detect the overlap with level-0 files and would incorrectly place
+    // the deletion in a deeper level.
+    ASSERT_LEVELDB_OK(Delete("600"));
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("3", FilesPerLevel());
+    ASSERT_EQ("NOT_FOUND", Get("600"));
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, L0_CompactionBug_Issue44_a) {
+  Reopen();
+  ASSERT_LEVELDB_OK(Put("b", "v"));
+  Reopen();
+  ASSERT_LEVELDB_OK(Delete("b"));
+  ASSERT_LEVELDB_OK(Delete("a"));
+  Reopen();
+  ASSERT_LEVELDB_OK(Delete("a"));
+  Reopen();
+  ASSERT_LEVELDB_OK(Put("a", "v"));
+  Reopen();
+  Reopen();
+  ASSERT_EQ("(a->v)", Contents());
+  DelayMilliseconds(1000);  // Wait for compaction to finish
+  ASSERT_EQ("(a->v)", Contents());
+}
+
+TEST_F(DBTest, L0_CompactionBug_Issue44_b) {
+  Reopen();
+  Put("", "");
   Reopen();
   Delete("e");
   Put("", "");
@@ -1920,6 +3060,136 @@ TEST_F(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST_F(DBTest, RowCache) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.row_cache = NewLRUCache(1 << 20);
+  Reopen(&options);
+
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  ASSERT_LEVELDB_OK(Put("gone", "v"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("foo", "v2"));
+  ASSERT_LEVELDB_OK(Delete("gone"));
+  dbfull()->TEST_CompactMemTable();
+
+  // The first lookups read the table, and later ones hit the row cache.
+  for (int i = 0; i < 3; i++) {
+    env_->random_read_counter_.Reset();
+    ASSERT_EQ("v2", Get("foo"));
+    ASSERT_EQ("NOT_FOUND", Get("gone"));
+    ASSERT_EQ("NOT_FOUND", Get("missing"));
+    if (i > 0) {
+      ASSERT_EQ(0, env_->random_read_counter_.Read());
+    }
+  }
+
+  // Entries newer than a snapshot are not served to it.
+  ASSERT_EQ("v1", Get("foo", snapshot));
+  ASSERT_EQ("v1", Get("foo", snapshot));
+  ASSERT_EQ("v", Get("gone", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+
+  // Newer files are not masked by rows cached for older ones.
+  ASSERT_LEVELDB_OK(Put("foo", "v3"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("v3", Get("foo"));
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ("v3", Get("foo"));
+  ASSERT_EQ("NOT_FOUND", Get("gone"));
+
+  Close();
+  delete options.block_cache;
+  delete options.row_cache;
+}
+
+TEST_F(DBTest, SecondaryBlockCaches) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.block_cache = NewLRUCache(0);  // Prevent block cache hits
+  options.compressed_block_cache = NewLRUCache(1 << 20);
+  ASSERT_LEVELDB_OK(NewFilePersistentCache(
+      Env::Default(), dbname_ + "_pcache", 1 << 20, &options.persistent_cache));
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("b", "vb"));
+  dbfull()->TEST_CompactMemTable();
+
+  // Blocks read from the table are kept in both tiers.
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ(1, env_->random_read_counter_.Read());
+  ASSERT_EQ("vb", Get("b"));
+  ASSERT_EQ(1, env_->random_read_counter_.Read());
+  ASSERT_GT(options.compressed_block_cache->TotalCharge(), 0);
+
+  // Without the compressed tier, blocks come from the persistent one.
+  Cache* compressed_block_cache = options.compressed_block_cache;
+  options.compressed_block_cache = nullptr;
+  Reopen(&options);
+  ASSERT_EQ("va", Get("a"));
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("vb", Get("b"));
+  ASSERT_EQ(0, env_->random_read_counter_.Read());
+
+  Close();
+  delete options.block_cache;
+  delete compressed_block_cache;
+  delete options.persistent_cache;
+}
+
+TEST_F(DBTest, TableCacheWarmup) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  Reopen(&options);
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_LEVELDB_OK(Put("b", "vb"));
+  dbfull()->TEST_CompactMemTable();
+
+  // Once the tables are open, each lookup only has to read a data block.
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+  options.table_warmup_files = 10;
+  Reopen(&options);
+  env_->random_read_counter_.Reset();
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("vb", Get("b"));
+  ASSERT_EQ(2, env_->random_read_counter_.Read());
+
+  Close();
+  delete options.block_cache;
+}
+
+TEST_F(DBTest, UnlimitedOpenFiles) {
+  Options options = CurrentOptions();
+  options.max_open_files = -1;
+  Reopen(&options);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i)));
+    dbfull()->TEST_CompactMemTable();
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+
+  // Compacted tables are unpinned once no version refers to them.
+  Compact(Key(0), Key(9));
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+
+  Reopen(&options);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ(Key(i), Get(Key(i)));
+  }
+}
+
 // Multi-threaded test:
 namespace {
 
@@ -2036,6 +3306,14 @@ class ModelDB : public DB {
   Status Delete(const WriteOptions& o, const Slice& key) override {
     return DB::Delete(o, key);
   }
+  Status DeleteRange(const WriteOptions& o, const Slice& begin_key,
+                     const Slice& end_key) override {
+    return DB::DeleteRange(o, begin_key, end_key);
+  }
+  Status Merge(const WriteOptions& o, const Slice& key,
+               const Slice& value) override {
+    return DB::Merge(o, key, value);
+  }
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override {
     assert(false);  // Not implemented
@@ -2065,13 +3343,32 @@ class ModelDB : public DB {
     class Handler : public WriteBatch::Handler {
      public:
       KVMap* map_;
+      const MergeOperator* merge_operator_;
       void Put(const Slice& key, const Slice& value) override {
         (*map_)[key.ToString()] = value.ToString();
       }
       void Delete(const Slice& key) override { map_->erase(key.ToString()); }
+      void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+        if (begin_key.compare(end_key) < 0) {
+          map_->erase(map_->lower_bound(begin_key.ToString()),
+                      map_->lower_bound(end_key.ToString()));
+        }
+      }
+      void Merge(const Slice& key, const Slice& value) override {
+        KVMap::iterator iter = map_->find(key.ToString());
+        Slice existing;
+        if (iter != map_->end()) {
+          existing = iter->second;
+        }
+        std::string merged;
+        merge_operator_->FullMerge(
+            key, iter != map_->end() ? &existing : nullptr, {value}, &merged);
+        (*map_)[key.ToString()] = merged;
+      }
     };
     Handler handler;
     handler.map_ = &map_;
+    handler.merge_operator_ = options_.merge_operator;
     return batch->Iterate(&handler);
   }
 
@@ -2083,6 +3380,11 @@ class ModelDB : public DB {
       sizes[i] = 0;
     }
   }
+  Status NewRangeIterators(const ReadOptions& options, const Slice* start,
+                           const Slice* limit, int max_shards,
+                           std::vector<Iterator*>* iterators) override {
+    return Status::NotSupported("NewRangeIterators");
+  }
   void CompactRange(const Slice* start, const Slice* end) override {}
 
  private:
@@ -2178,18 +3480,33 @@ TEST_F(DBTest, Randomized) {
       }
       // TODO(sanjay): Test Get() works
       int p = rnd.Uniform(100);
-      if (p < 45) {  // Put
+      if (p < 40) {  // Put
         k = RandomKey(&rnd);
         v = RandomString(
             &rnd, rnd.OneIn(20) ? 100 + rnd.Uniform(100) : rnd.Uniform(8));
         ASSERT_LEVELDB_OK(model.Put(WriteOptions(), k, v));
         ASSERT_LEVELDB_OK(db_->Put(WriteOptions(), k, v));
 
-      } else if (p < 90) {  // Delete
+      } else if (p < 45) {  // Merge
+        k = RandomKey(&rnd);
+        v = RandomString(&rnd, rnd.Uniform(8));
+        ASSERT_LEVELDB_OK(model.Merge(WriteOptions(), k, v));
+        ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), k, v));
+
+      } else if (p < 88) {  // Delete
         k = RandomKey(&rnd);
         ASSERT_LEVELDB_OK(model.Delete(WriteOptions(), k));
         ASSERT_LEVELDB_OK(db_->Delete(WriteOptions(), k));
 
+      } else if (p < 90) {  // DeleteRange
+        k = RandomKey(&rnd);
+        v = RandomKey(&rnd);
+        if (v < k) {
+          std::swap(k, v);
+        }
+        ASSERT_LEVELDB_OK(model.DeleteRange(WriteOptions(), k, v));
+        ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), k, v));
+
       } else {  // Multi-element batch
         WriteBatch b;
         const int num = rnd.Uniform(8);
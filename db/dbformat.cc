@@ -114,6 +114,22 @@ bool InternalFilterPolicy::KeyMayMatch(const Slice& key, const Slice& f) const {
   return user_policy_->KeyMayMatch(ExtractUserKey(key), f);
 }
 
+InternalIterateBounds::InternalIterateBounds(const ReadOptions& options)
+    : options_(options) {
+  if (options.iterate_lower_bound != nullptr) {
+    lower_ = InternalKey(*options.iterate_lower_bound, kMaxSequenceNumber,
+                         kValueTypeForSeek);
+    lower_slice_ = lower_.Encode();
+    options_.iterate_lower_bound = &lower_slice_;
+  }
+  if (options.iterate_upper_bound != nullptr) {
+    upper_ = InternalKey(*options.iterate_upper_bound, kMaxSequenceNumber,
+                         kValueTypeForSeek);
+    upper_slice_ = upper_.Encode();
+    options_.iterate_upper_bound = &upper_slice_;
+  }
+}
+
 LookupKey::LookupKey(const Slice& user_key, SequenceNumber s) {
   size_t usize = user_key.size();
   size_t needed = usize + 13;  // A conservative estimate
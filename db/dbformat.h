@@ -51,14 +51,20 @@ class InternalKey;
 // Value types encoded as the last component of internal keys.
 // DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
 // data structures.
-enum ValueType { kTypeDeletion = 0x0, kTypeValue = 0x1 };
+enum ValueType {
+  kTypeDeletion = 0x0,
+  kTypeValue = 0x1,
+  kTypeRangeDeletion = 0x2,  // See db/range_del.h
+  kTypeMerge = 0x3,          // An operand for the MergeOperator
+  kTypeBlobIndex = 0x4       // A value kept in a blob file, see db/blob_file.h
+};
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
 // sequence number (since we sort sequence numbers in decreasing order
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeBlobIndex;
 
 typedef uint64_t SequenceNumber;
 
@@ -97,6 +103,14 @@ inline Slice ExtractUserKey(const Slice& internal_key) {
   return Slice(internal_key.data(), internal_key.size() - 8);
 }
 
+// Returns the type of an internal key.
+inline ValueType ExtractValueType(const Slice& internal_key) {
+  assert(internal_key.size() >= 8);
+  const uint64_t num =
+      DecodeFixed64(internal_key.data() + internal_key.size() - 8);
+  return static_cast<ValueType>(num & 0xff);
+}
+
 // A comparator for internal keys that uses a specified comparator for
 // the user key portion and breaks ties by decreasing sequence number.
 class InternalKeyComparator : public Comparator {
@@ -177,9 +191,31 @@ inline bool ParseInternalKey(const Slice& internal_key,
   result->sequence = num >> 8;
   result->type = static_cast<ValueType>(c);
   result->user_key = Slice(internal_key.data(), n - 8);
-  return (c <= static_cast<uint8_t>(kTypeValue));
+  return (c <= static_cast<uint8_t>(kTypeBlobIndex));
 }
 
+// The iterators below DBIter compare internal keys, so they get the
+// iterate bounds of a ReadOptions as internal keys: the smallest
+// internal keys of the bounding user keys.
+class InternalIterateBounds {
+ public:
+  explicit InternalIterateBounds(const ReadOptions& options);
+
+  InternalIterateBounds(const InternalIterateBounds&) = delete;
+  InternalIterateBounds& operator=(const InternalIterateBounds&) = delete;
+
+  // A copy of the options with the bounds replaced by internal keys owned
+  // by this object.
+  const ReadOptions& options() const { return options_; }
+
+ private:
+  InternalKey lower_;
+  InternalKey upper_;
+  Slice lower_slice_;
+  Slice upper_slice_;
+  ReadOptions options_;
+};
+
 // A helper class useful for DBImpl::Get()
 class LookupKey {
  public:
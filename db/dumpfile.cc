@@ -6,6 +6,7 @@
 
 #include <cstdio>
 
+#include "db/blob_file.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
 #include "db/log_reader.h"
@@ -88,6 +89,22 @@ class WriteBatchItemPrinter : public WriteBatch::Handler {
     r += "'\n";
     dst_->Append(r);
   }
+  void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+    std::string r = "  delrange '";
+    AppendEscapedStringTo(&r, begin_key);
+    r += "' '";
+    AppendEscapedStringTo(&r, end_key);
+    r += "'\n";
+    dst_->Append(r);
+  }
+  void Merge(const Slice& key, const Slice& value) override {
+    std::string r = "  merge '";
+    AppendEscapedStringTo(&r, key);
+    r += "' '";
+    AppendEscapedStringTo(&r, value);
+    r += "'\n";
+    dst_->Append(r);
+  }
 
   WritableFile* dst_;
 };
@@ -167,48 +184,73 @@ Status DumpTable(Env* env, const std::string& fname, WritableFile* dst) {
 
   ReadOptions ro;
   ro.fill_cache = false;
-  Iterator* iter = table->NewIterator(ro);
+  // Dump the entries of the table followed by its range deletions.
+  Iterator* iters[2] = {table->NewIterator(ro),
+                        table->NewRangeDeletionIterator()};
   std::string r;
-  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
-    r.clear();
-    ParsedInternalKey key;
-    if (!ParseInternalKey(iter->key(), &key)) {
-      r = "badkey '";
-      AppendEscapedStringTo(&r, iter->key());
-      r += "' => '";
-      AppendEscapedStringTo(&r, iter->value());
-      r += "'\n";
-      dst->Append(r);
-    } else {
-      r = "'";
-      AppendEscapedStringTo(&r, key.user_key);
-      r += "' @ ";
-      AppendNumberTo(&r, key.sequence);
-      r += " : ";
-      if (key.type == kTypeDeletion) {
-        r += "del";
-      } else if (key.type == kTypeValue) {
-        r += "val";
+  for (Iterator* iter : iters) {
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      r.clear();
+      ParsedInternalKey key;
+      if (!ParseInternalKey(iter->key(), &key)) {
+        r = "badkey '";
+        AppendEscapedStringTo(&r, iter->key());
+        r += "' => '";
+        AppendEscapedStringTo(&r, iter->value());
+        r += "'\n";
+        dst->Append(r);
       } else {
-        AppendNumberTo(&r, key.type);
+        r = "'";
+        AppendEscapedStringTo(&r, key.user_key);
+        r += "' @ ";
+        AppendNumberTo(&r, key.sequence);
+        r += " : ";
+        if (key.type == kTypeDeletion) {
+          r += "del";
+        } else if (key.type == kTypeValue) {
+          r += "val";
+        } else if (key.type == kTypeRangeDeletion) {
+          r += "delrange";
+        } else if (key.type == kTypeMerge) {
+          r += "merge";
+        } else if (key.type == kTypeBlobIndex) {
+          r += "blob";
+        } else {
+          AppendNumberTo(&r, key.type);
+        }
+        r += " => '";
+        AppendEscapedStringTo(&r, iter->value());
+        r += "'\n";
+        dst->Append(r);
       }
-      r += " => '";
-      AppendEscapedStringTo(&r, iter->value());
-      r += "'\n";
-      dst->Append(r);
     }
-  }
-  s = iter->status();
-  if (!s.ok()) {
-    dst->Append("iterator error: " + s.ToString() + "\n");
+    if (s.ok() && !iter->status().ok()) {
+      s = iter->status();
+      dst->Append("iterator error: " + s.ToString() + "\n");
+    }
+    delete iter;
   }
 
-  delete iter;
   delete table;
   delete file;
   return Status::OK();
 }
 
+// Called on every record of a blob file.
+void BlobRecordPrinter(void* arg, const Slice& key, const Slice& value) {
+  WritableFile* dst = reinterpret_cast<WritableFile*>(arg);
+  std::string r = "'";
+  AppendEscapedStringTo(&r, key);
+  r += "' => '";
+  AppendEscapedStringTo(&r, value);
+  r += "'\n";
+  dst->Append(r);
+}
+
+Status DumpBlobFile(Env* env, const std::string& fname, WritableFile* dst) {
+  return ReadBlobFile(env, fname, dst, BlobRecordPrinter);
+}
+
 }  // namespace
 
 Status DumpFile(Env* env, const std::string& fname, WritableFile* dst) {
@@ -223,6 +265,8 @@ Status DumpFile(Env* env, const std::string& fname, WritableFile* dst) {
       return DumpDescriptor(env, fname, dst);
     case kTableFile:
       return DumpTable(env, fname, dst);
+    case kBlobFile:
+      return DumpBlobFile(env, fname, dst);
     default:
       break;
   }
@@ -0,0 +1,91 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/file_indexer.h"
+
+#include <cassert>
+
+#include "db/version_edit.h"
+
+namespace leveldb {
+
+FileIndexer::FileIndexer() : icmp_(nullptr) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    levels_[level].key_offset.push_back(0);
+  }
+}
+
+void FileIndexer::Build(const InternalKeyComparator* icmp,
+                        const std::vector<FileMetaData*>* files) {
+  icmp_ = icmp;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    Level* l = &levels_[level];
+    l->largest_keys.clear();
+    l->key_offset.clear();
+    l->next_bound.clear();
+    l->key_offset.push_back(0);
+    if (level == 0) {
+      // Level-0 files overlap, so they are searched linearly instead.
+      continue;
+    }
+    for (const FileMetaData* f : files[level]) {
+      l->largest_keys.append(f->largest.Encode().data(),
+                             f->largest.Encode().size());
+      l->key_offset.push_back(static_cast<uint32_t>(l->largest_keys.size()));
+    }
+  }
+
+  // Both levels are sorted by largest key, so one merge-like pass per
+  // pair of levels finds all the bounds.
+  for (int level = 1; level + 1 < config::kNumLevels; level++) {
+    Level* l = &levels_[level];
+    const Level& next = levels_[level + 1];
+    l->next_bound.resize(l->num_files());
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < l->num_files(); i++) {
+      while (j < next.num_files() &&
+             icmp_->Compare(next.Largest(j), l->Largest(i)) < 0) {
+        j++;
+      }
+      l->next_bound[i] = j;
+    }
+  }
+}
+
+FileIndexer::Range FileIndexer::FullRange(int level) const {
+  return Range{0, levels_[level].num_files()};
+}
+
+uint32_t FileIndexer::FindFile(int level, const Slice& ikey,
+                               Range* range) const {
+  assert(level > 0);
+  const Level& l = levels_[level];
+  assert(range->left <= range->right);
+  assert(range->right <= l.num_files());
+
+  // Binary search for the first file whose largest key is >= ikey.
+  uint32_t left = range->left;
+  uint32_t right = range->right;
+  while (left < right) {
+    const uint32_t mid = (left + right) / 2;
+    if (icmp_->Compare(l.Largest(mid), ikey) < 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  const uint32_t index = right;
+
+  // The key is above the largest key of file index - 1 and at most the
+  // largest key of file index, so its file in the next level lies
+  // between the bounds recorded for those two files.
+  if (level + 1 < config::kNumLevels) {
+    range->left = (index > 0) ? l.next_bound[index - 1] : 0;
+    range->right = (index < l.num_files()) ? l.next_bound[index]
+                                           : levels_[level + 1].num_files();
+  }
+  return index;
+}
+
+}  // namespace leveldb
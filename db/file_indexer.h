@@ -0,0 +1,83 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_FILE_INDEXER_H_
+#define STORAGE_LEVELDB_DB_FILE_INDEXER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class InternalKeyComparator;
+struct FileMetaData;
+
+// Search hints that let a point lookup carry what it learned in one
+// level over to the next one (fractional cascading).
+//
+// For every file in levels 1 and up, the indexer records the position of
+// the file's largest key in the next level.  Once a lookup has found the
+// file for its key in level N, only the next-level files whose largest
+// keys lie between the largest keys of that file and its predecessor
+// remain candidates, which is usually a handful instead of the whole
+// level.  The largest keys of each level are copied into one contiguous
+// buffer so that the searches stay within a few cache lines.
+class FileIndexer {
+ public:
+  // Range [left, right] of file indexes known to contain the answer of a
+  // search.  right may equal the number of files, meaning "no file".
+  struct Range {
+    uint32_t left;
+    uint32_t right;
+  };
+
+  FileIndexer();
+
+  FileIndexer(const FileIndexer&) = delete;
+  FileIndexer& operator=(const FileIndexer&) = delete;
+
+  // Index the files of a version, one vector per level, ordered by
+  // "icmp".  REQUIRES: files in levels > 0 are sorted and do not overlap.
+  void Build(const InternalKeyComparator* icmp,
+             const std::vector<FileMetaData*>* files);
+
+  // Returns the range that holds the answer for "level" when nothing is
+  // known about the key.
+  Range FullRange(int level) const;
+
+  // Return the index of the first file in "level" whose largest key is
+  // >= "ikey", or the number of files in the level if there is none.
+  // "*range" must hold the answer; on return it holds the range for
+  // level + 1.
+  // REQUIRES: level > 0
+  uint32_t FindFile(int level, const Slice& ikey, Range* range) const;
+
+ private:
+  struct Level {
+    std::string largest_keys;          // Concatenated largest keys
+    std::vector<uint32_t> key_offset;  // Start of each key, plus the end
+    // next_bound[i] is the index of the first file in the next level
+    // whose largest key is >= the largest key of file i.
+    std::vector<uint32_t> next_bound;
+
+    uint32_t num_files() const {
+      return static_cast<uint32_t>(key_offset.size() - 1);
+    }
+    Slice Largest(uint32_t i) const {
+      return Slice(largest_keys.data() + key_offset[i],
+                   key_offset[i + 1] - key_offset[i]);
+    }
+  };
+
+  const InternalKeyComparator* icmp_;
+  Level levels_[config::kNumLevels];
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_FILE_INDEXER_H_
@@ -0,0 +1,123 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/file_indexer.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "db/version_edit.h"
+#include "db/version_set.h"
+#include "gtest/gtest.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+class FileIndexerTest : public testing::Test {
+ public:
+  FileIndexerTest() : cmp_(BytewiseComparator()) {}
+
+  ~FileIndexerTest() {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      for (FileMetaData* f : files_[level]) {
+        delete f;
+      }
+    }
+  }
+
+  void Add(int level, const std::string& smallest, const std::string& largest,
+           SequenceNumber seq = 100) {
+    FileMetaData* f = new FileMetaData;
+    f->smallest = InternalKey(smallest, seq, kTypeValue);
+    f->largest = InternalKey(largest, seq, kTypeValue);
+    files_[level].push_back(f);
+  }
+
+  // Check that cascading through all levels finds the same files as an
+  // independent binary search in every level.
+  void CheckKey(const std::string& key) {
+    InternalKey target(key, kMaxSequenceNumber, kValueTypeForSeek);
+    FileIndexer::Range range = indexer_.FullRange(1);
+    for (int level = 1; level < config::kNumLevels; level++) {
+      const uint32_t index =
+          indexer_.FindFile(level, target.Encode(), &range);
+      ASSERT_EQ(FindFile(cmp_, files_[level], target.Encode()), index)
+          << "level " << level << " key " << key;
+    }
+  }
+
+  void Build() { indexer_.Build(&cmp_, files_); }
+
+  InternalKeyComparator cmp_;
+  std::vector<FileMetaData*> files_[config::kNumLevels];
+  FileIndexer indexer_;
+};
+
+TEST_F(FileIndexerTest, Empty) {
+  Build();
+  CheckKey("a");
+  CheckKey("z");
+}
+
+TEST_F(FileIndexerTest, Simple) {
+  Add(1, "c", "e");
+  Add(1, "g", "k");
+  Add(2, "a", "b");
+  Add(2, "c", "d");
+  Add(2, "f", "h");
+  Add(2, "i", "j");
+  Add(2, "l", "m");
+  Add(4, "e", "x");
+  Build();
+  for (char c = 'a'; c <= 'z'; c++) {
+    CheckKey(std::string(1, c));
+    CheckKey(std::string(1, c) + "0");
+  }
+}
+
+TEST_F(FileIndexerTest, SharedUserKeyAtBoundary) {
+  // Adjacent files may split the entries of a single user key.
+  Add(1, "a", "c", 200);
+  Add(1, "c", "e", 100);
+  Add(2, "b", "c", 300);
+  Add(2, "c", "c", 150);
+  Add(2, "c", "d", 50);
+  Build();
+  for (char c = 'a'; c <= 'f'; c++) {
+    CheckKey(std::string(1, c));
+  }
+}
+
+TEST_F(FileIndexerTest, Random) {
+  Random rnd(301);
+  for (int level = 1; level < config::kNumLevels; level++) {
+    // Lower levels hold more, smaller files.
+    int key = rnd.Uniform(100);
+    const int num_files = rnd.Uniform(10 << level);
+    const int max_gap = 5000 >> level;
+    for (int i = 0; i < num_files; i++) {
+      char smallest[20];
+      char largest[20];
+      key += 1 + rnd.Uniform(max_gap);
+      std::snprintf(smallest, sizeof(smallest), "%08d", key);
+      key += rnd.Uniform(max_gap);
+      std::snprintf(largest, sizeof(largest), "%08d", key);
+      Add(level, smallest, largest);
+    }
+  }
+  Build();
+  for (int i = 0; i < 10000; i++) {
+    char key[20];
+    std::snprintf(key, sizeof(key), "%08d", rnd.Uniform(200000));
+    CheckKey(key);
+  }
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -4,10 +4,13 @@
 
 #include "db/memtable.h"
 #include "db/dbformat.h"
+#include "db/range_del.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "util/coding.h"
+#include "util/dynamic_bloom.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -18,8 +21,19 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+MemTable::MemTable(const InternalKeyComparator& comparator,
+                   size_t bloom_bytes, ArenaBlockPool* arena_pool)
+    : comparator_(comparator),
+      refs_(0),
+      arena_(arena_pool),
+      table_(comparator_, &arena_),
+      range_del_table_(comparator_, &arena_),
+      bloom_(nullptr) {
+  if (bloom_bytes > 0) {
+    bloom_ = new (arena_.AllocateAligned(sizeof(DynamicBloom)))
+        DynamicBloom(&arena_, bloom_bytes * 8);
+  }
+}
 
 MemTable::~MemTable() { assert(refs_ == 0); }
 
@@ -73,6 +87,12 @@ class MemTableIterator : public Iterator {
 
 Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
 
+Iterator* MemTable::NewRangeDeletionIterator() {
+  Table::Iterator iter(&range_del_table_);
+  iter.SeekToFirst();
+  return iter.Valid() ? new MemTableIterator(&range_del_table_) : nullptr;
+}
+
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
   // Format of an entry is concatenation of:
@@ -80,13 +100,16 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   //  key bytes    : char[internal_key.size()]
   //  value_size   : varint32 of value.size()
   //  value bytes  : char[value.size()]
+  // The entry is stored inline in the skiplist node that indexes it.
   size_t key_size = key.size();
   size_t val_size = value.size();
   size_t internal_key_size = key_size + 8;
   const size_t encoded_len = VarintLength(internal_key_size) +
                              internal_key_size + VarintLength(val_size) +
                              val_size;
-  char* buf = arena_.Allocate(encoded_len);
+  Table* const table =
+      (type == kTypeRangeDeletion) ? &range_del_table_ : &table_;
+  char* buf = table->AllocateKey(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   std::memcpy(p, key.data(), key_size);
   p += key_size;
@@ -95,14 +118,63 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  if (bloom_ != nullptr && type != kTypeRangeDeletion) {
+    bloom_->Add(key);
+  }
+  table->Insert(buf);
+  if (type == kTypeRangeDeletion) {
+    // Fragments built before the insert may lack the new range deletion.
+    MutexLock l(&range_del_mutex_);
+    range_del_fragments_.reset();
+  }
+}
+
+std::shared_ptr<const FragmentedRangeTombstones>
+MemTable::RangeDeletionFragments() {
+  MutexLock l(&range_del_mutex_);
+  if (range_del_fragments_ == nullptr) {
+    // Built under the lock, so that Add() discards the result if it adds
+    // a range deletion the build might have missed.
+    std::vector<RangeTombstone> tombstones;
+    MemTableIterator iter(&range_del_table_);
+    ReadRangeTombstones(&iter, &tombstones);
+    range_del_fragments_ = std::make_shared<FragmentedRangeTombstones>(
+        comparator_.comparator.user_comparator(), tombstones);
+  }
+  return range_del_fragments_;
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   std::vector<std::string>* operands) {
+  // Sequence number of the newest visible range deletion covering the key.
+  SequenceNumber tombstone = 0;
+  Table::Iterator range_del_iter(&range_del_table_);
+  range_del_iter.SeekToFirst();
+  if (range_del_iter.Valid()) {
+    ParsedInternalKey lookup;
+    ParseInternalKey(key.internal_key(), &lookup);
+    tombstone = RangeDeletionFragments()->MaxCoveringSequence(
+        lookup.user_key, lookup.sequence);
+  }
+  if (bloom_ != nullptr && !bloom_->MayContain(key.user_key())) {
+    // Not found
+  } else if (GetEntry(key, tombstone, value, s, operands)) {
+    return true;
+  }
+  if (tombstone != 0) {
+    *s = Status::NotFound(Slice());
+    return true;
+  }
+  return false;
+}
+
+bool MemTable::GetEntry(const LookupKey& key, SequenceNumber tombstone,
+                        std::string* value, Status* s,
+                        std::vector<std::string>* operands) {
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
-  iter.Seek(memkey.data());
-  if (iter.Valid()) {
+  // Step past merge operands to the older entries for the key.
+  for (iter.Seek(memkey.data()); iter.Valid(); iter.Next()) {
     // entry format is:
     //    klength  varint32
     //    userkey  char[klength]
@@ -116,19 +188,33 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     uint32_t key_length;
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
     if (comparator_.comparator.user_comparator()->Compare(
-            Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
-      // Correct user key
-      const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-      switch (static_cast<ValueType>(tag & 0xff)) {
-        case kTypeValue: {
-          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
-          value->assign(v.data(), v.size());
-          return true;
-        }
-        case kTypeDeletion:
-          *s = Status::NotFound(Slice());
-          return true;
+            Slice(key_ptr, key_length - 8), key.user_key()) != 0) {
+      break;
+    }
+    // Correct user key
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    if ((tag >> 8) < tombstone) {
+      return false;  // Deleted by the range deletion
+    }
+    switch (static_cast<ValueType>(tag & 0xff)) {
+      case kTypeValue: {
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        value->assign(v.data(), v.size());
+        return true;
+      }
+      case kTypeDeletion:
+      case kTypeRangeDeletion:
+        *s = Status::NotFound(Slice());
+        return true;
+      case kTypeMerge: {
+        Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+        operands->push_back(v.ToString());
+        break;
       }
+      case kTypeBlobIndex:
+        // Values are moved to blob files only when tables are written.
+        assert(false);
+        break;
     }
   }
   return false;
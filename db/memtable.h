@@ -5,15 +5,22 @@
 #ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
 #include "db/skiplist.h"
 #include "leveldb/db.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include "util/arena.h"
 
 namespace leveldb {
 
+class ArenaBlockPool;
+class DynamicBloom;
+class FragmentedRangeTombstones;
 class InternalKeyComparator;
 class MemTableIterator;
 
@@ -21,7 +28,16 @@ class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
-  explicit MemTable(const InternalKeyComparator& comparator);
+  //
+  // If "bloom_bytes" is non-zero, a bloom filter of that size over the
+  // user keys is kept alongside the table so that Get() can skip the
+  // skiplist search for keys that were never added.
+  //
+  // If "arena_pool" is non-null, the memtable's memory is taken from and
+  // returned to *arena_pool, which must outlive the memtable.
+  explicit MemTable(const InternalKeyComparator& comparator,
+                    size_t bloom_bytes = 0,
+                    ArenaBlockPool* arena_pool = nullptr);
 
   MemTable(const MemTable&) = delete;
   MemTable& operator=(const MemTable&) = delete;
@@ -50,17 +66,28 @@ class MemTable {
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range deletions of the memtable (see
+  // db/range_del.h), or nullptr if it holds none.  Range deletions are
+  // not returned by NewIterator().
+  Iterator* NewRangeDeletionIterator();
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  For
+  // type==kTypeRangeDeletion, key and value are the start and end of the
+  // deleted range.
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
   // If memtable contains a value for key, store it in *value and return true.
-  // If memtable contains a deletion for key, store a NotFound() error
-  // in *status and return true.
+  // If memtable contains a deletion for key, or a range deletion that
+  // covers it, store a NotFound() error in *status and return true.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  //
+  // Merge operands found on the way to the value or deletion are appended
+  // to *operands, newest first, and left for the caller to apply.
+  bool Get(const LookupKey& key, std::string* value, Status* s,
+           std::vector<std::string>* operands);
 
  private:
   friend class MemTableIterator;
@@ -76,10 +103,25 @@ class MemTable {
 
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Like Get(), but only looks at entries newer than "tombstone", the
+  // sequence number of a range deletion covering the key.
+  bool GetEntry(const LookupKey& key, SequenceNumber tombstone,
+                std::string* value, Status* s,
+                std::vector<std::string>* operands);
+
+  // Return the range deletions of range_del_table_, fragmented when first
+  // asked for since the last range deletion was added.
+  std::shared_ptr<const FragmentedRangeTombstones> RangeDeletionFragments();
+
   KeyComparator comparator_;
   int refs_;
   Arena arena_;
   Table table_;
+  Table range_del_table_;  // Range deletions, kept out of table_
+  port::Mutex range_del_mutex_;
+  std::shared_ptr<const FragmentedRangeTombstones> range_del_fragments_
+      GUARDED_BY(range_del_mutex_);  // nullptr until built
+  DynamicBloom* bloom_;  // Allocated in arena_; nullptr if disabled
 };
 
 }  // namespace leveldb
@@ -0,0 +1,49 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/merge_helper.h"
+
+#include "leveldb/merge_operator.h"
+
+namespace leveldb {
+
+Status ApplyMergeOperands(const MergeOperator* merge_operator,
+                          const Slice& user_key, const Slice* existing_value,
+                          const std::vector<std::string>& operands,
+                          std::string* result) {
+  if (merge_operator == nullptr) {
+    return Status::NotSupported("merge operand found without a merge operator",
+                                user_key);
+  }
+  std::vector<Slice> in_order(operands.rbegin(), operands.rend());
+  std::string merged;
+  if (!merge_operator->FullMerge(user_key, existing_value, in_order,
+                                 &merged)) {
+    return Status::Corruption("merge failed for ", user_key);
+  }
+  result->swap(merged);
+  return Status::OK();
+}
+
+bool CombineMergeOperands(const MergeOperator* merge_operator,
+                          const Slice& user_key,
+                          const std::vector<std::string>& operands,
+                          std::string* result) {
+  if (merge_operator == nullptr || operands.empty()) {
+    return false;
+  }
+  std::string combined = operands.back();
+  std::string tmp;
+  for (size_t i = operands.size() - 1; i > 0; i--) {
+    if (!merge_operator->PartialMerge(user_key, combined, operands[i - 1],
+                                      &tmp)) {
+      return false;
+    }
+    combined.swap(tmp);
+  }
+  result->swap(combined);
+  return true;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,40 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Reads and compactions gather the merge operands written by DB::Merge()
+// for a key from newest to oldest, stopping at the value or deletion
+// beneath them, and then combine them with the functions below.
+
+#ifndef STORAGE_LEVELDB_DB_MERGE_HELPER_H_
+#define STORAGE_LEVELDB_DB_MERGE_HELPER_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class MergeOperator;
+
+// Apply "operands", the merge operands of "user_key" ordered from newest
+// to oldest, to "*existing_value" and store the result in *result.
+// "existing_value" is nullptr if there is no value beneath the operands.
+// "existing_value" may point into *result.
+Status ApplyMergeOperands(const MergeOperator* merge_operator,
+                          const Slice& user_key, const Slice* existing_value,
+                          const std::vector<std::string>& operands,
+                          std::string* result);
+
+// Combine "operands", ordered as above, into a single operand stored in
+// *result.  Returns false if the merge operator could not combine them.
+bool CombineMergeOperands(const MergeOperator* merge_operator,
+                          const Slice& user_key,
+                          const std::vector<std::string>& operands,
+                          std::string* result);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MERGE_HELPER_H_
@@ -0,0 +1,206 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_del.h"
+
+#include <algorithm>
+#include <functional>
+#include <set>
+
+#include "leveldb/comparator.h"
+
+namespace leveldb {
+
+void ExtendKeyRange(const InternalKeyComparator& icmp,
+                    const RangeTombstone& tombstone, bool empty,
+                    InternalKey* smallest, InternalKey* largest) {
+  InternalKey start = tombstone.StartKey();
+  InternalKey end = tombstone.EndKey();
+  if (empty || icmp.Compare(start, *smallest) < 0) {
+    *smallest = start;
+  }
+  if (empty || icmp.Compare(end, *largest) > 0) {
+    *largest = end;
+  }
+}
+
+namespace {
+
+// Sweep over the start and end keys of "tombstones" in order, calling
+// emit(start, end, active) for each piece [start, end) of the key space
+// that some of them cover, where "active" holds the sequence numbers of
+// the range deletions covering the piece.  Range deletions must not be
+// empty.
+template <typename Emit>
+void SweepTombstones(const Comparator* ucmp,
+                     const std::vector<RangeTombstone>& tombstones,
+                     Emit emit) {
+  const size_t n = tombstones.size();
+  std::vector<const RangeTombstone*> by_start(n), by_end(n);
+  for (size_t i = 0; i < n; i++) {
+    by_start[i] = by_end[i] = &tombstones[i];
+  }
+  std::sort(by_start.begin(), by_start.end(),
+            [ucmp](const RangeTombstone* a, const RangeTombstone* b) {
+              return ucmp->Compare(a->start, b->start) < 0;
+            });
+  std::sort(by_end.begin(), by_end.end(),
+            [ucmp](const RangeTombstone* a, const RangeTombstone* b) {
+              return ucmp->Compare(a->end, b->end) < 0;
+            });
+
+  std::multiset<SequenceNumber> active;
+  std::string prev;
+  size_t s = 0, e = 0;
+  while (e < n) {
+    // Every range deletion ends after it starts, so an end key remains
+    // for as long as start keys do.
+    const std::string& key = (s < n && ucmp->Compare(by_start[s]->start,
+                                                     by_end[e]->end) <= 0)
+                                 ? by_start[s]->start
+                                 : by_end[e]->end;
+    if (!active.empty() && ucmp->Compare(prev, key) < 0) {
+      emit(prev, key, active);
+    }
+    while (e < n && ucmp->Compare(by_end[e]->end, key) == 0) {
+      active.erase(active.find(by_end[e]->sequence));
+      e++;
+    }
+    while (s < n && ucmp->Compare(by_start[s]->start, key) == 0) {
+      active.insert(by_start[s]->sequence);
+      s++;
+    }
+    prev = key;
+  }
+}
+
+}  // namespace
+
+Status ReadRangeTombstones(Iterator* iter,
+                           std::vector<RangeTombstone>* tombstones) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey start;
+    if (!ParseInternalKey(iter->key(), &start)) {
+      return Status::Corruption("corrupted range deletion key");
+    }
+    tombstones->push_back(
+        RangeTombstone(start.user_key, iter->value(), start.sequence));
+  }
+  return iter->status();
+}
+
+FragmentedRangeTombstones::FragmentedRangeTombstones(
+    const Comparator* ucmp, const std::vector<RangeTombstone>& tombstones)
+    : ucmp_(ucmp) {
+  std::vector<RangeTombstone> nonempty;
+  for (const RangeTombstone& tombstone : tombstones) {
+    if (ucmp->Compare(tombstone.start, tombstone.end) < 0) {
+      nonempty.push_back(tombstone);
+    }
+  }
+  SweepTombstones(
+      ucmp, nonempty,
+      [this, ucmp](const std::string& start, const std::string& end,
+                   const std::multiset<SequenceNumber>& active) {
+        if (!fragments_.empty()) {
+          // Extend the previous fragment if it ends here and is covered
+          // by the same range deletions.
+          Fragment& last = fragments_.back();
+          if (ucmp->Compare(last.end, start) == 0 &&
+              last.seq_end - last.seq_begin == active.size() &&
+              std::equal(active.rbegin(), active.rend(),
+                         sequences_.begin() + last.seq_begin)) {
+            last.end = end;
+            return;
+          }
+        }
+        const size_t seq_begin = sequences_.size();
+        sequences_.insert(sequences_.end(), active.rbegin(), active.rend());
+        fragments_.push_back(Fragment{start, end, seq_begin,
+                                      sequences_.size()});
+      });
+}
+
+SequenceNumber FragmentedRangeTombstones::MaxCoveringSequence(
+    const Slice& user_key, SequenceNumber snapshot) const {
+  // Find the last fragment that starts at or before user_key.
+  const Comparator* ucmp = ucmp_;
+  auto it = std::upper_bound(fragments_.begin(), fragments_.end(), user_key,
+                             [ucmp](const Slice& key, const Fragment& f) {
+                               return ucmp->Compare(key, f.start) < 0;
+                             });
+  if (it == fragments_.begin()) {
+    return 0;
+  }
+  --it;
+  if (ucmp->Compare(user_key, it->end) >= 0) {
+    return 0;
+  }
+  // The first, and so largest, sequence number visible at the snapshot.
+  auto begin = sequences_.begin() + it->seq_begin;
+  auto end = sequences_.begin() + it->seq_end;
+  auto seq = std::lower_bound(begin, end, snapshot,
+                              std::greater<SequenceNumber>());
+  return seq != end ? *seq : 0;
+}
+
+RangeDelAggregator::RangeDelAggregator(const Comparator* ucmp,
+                                       SequenceNumber snapshot)
+    : ucmp_(ucmp), snapshot_(snapshot), fragments_valid_(true) {}
+
+Status RangeDelAggregator::AddTombstones(Iterator* iter) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey start;
+    if (!ParseInternalKey(iter->key(), &start)) {
+      return Status::Corruption("corrupted range deletion key");
+    }
+    Add(RangeTombstone(start.user_key, iter->value(), start.sequence));
+  }
+  return iter->status();
+}
+
+void RangeDelAggregator::Add(const RangeTombstone& tombstone) {
+  if (tombstone.sequence <= snapshot_ &&
+      ucmp_->Compare(tombstone.start, tombstone.end) < 0) {
+    tombstones_.push_back(tombstone);
+    fragments_valid_ = false;
+  }
+}
+
+void RangeDelAggregator::BuildFragments() {
+  fragments_.clear();
+  const Comparator* ucmp = ucmp_;
+  SweepTombstones(
+      ucmp, tombstones_,
+      [this, ucmp](const std::string& start, const std::string& end,
+                   const std::multiset<SequenceNumber>& active) {
+        const SequenceNumber seq = *active.rbegin();
+        if (!fragments_.empty() && fragments_.back().sequence == seq &&
+            ucmp->Compare(fragments_.back().end, start) == 0) {
+          fragments_.back().end = end;
+        } else {
+          fragments_.push_back(Fragment{start, end, seq});
+        }
+      });
+  fragments_valid_ = true;
+}
+
+SequenceNumber RangeDelAggregator::MaxCoveringSequence(const Slice& user_key) {
+  if (!fragments_valid_) {
+    BuildFragments();
+  }
+  // Find the last fragment that starts at or before user_key.
+  const Comparator* ucmp = ucmp_;
+  auto it = std::upper_bound(fragments_.begin(), fragments_.end(), user_key,
+                             [ucmp](const Slice& key, const Fragment& f) {
+                               return ucmp->Compare(key, f.start) < 0;
+                             });
+  if (it == fragments_.begin()) {
+    return 0;
+  }
+  --it;
+  return ucmp->Compare(user_key, it->end) < 0 ? it->sequence : 0;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,138 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A range deletion ("range tombstone") written by DB::DeleteRange(start,
+// end) deletes every user key in [start, end) that was written before it.
+// Memtables and tables keep range deletions apart from their other
+// entries, each stored under the internal key (start, sequence,
+// kTypeRangeDeletion) with the end user key as its value.
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_DEL_H_
+#define STORAGE_LEVELDB_DB_RANGE_DEL_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/iterator.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+struct RangeTombstone {
+  RangeTombstone(const Slice& s, const Slice& e, SequenceNumber seq)
+      : start(s.ToString()), end(e.ToString()), sequence(seq) {}
+
+  // The internal key the range deletion is stored under.
+  InternalKey StartKey() const {
+    return InternalKey(start, sequence, kTypeRangeDeletion);
+  }
+
+  // An internal key that sorts before every entry for "end", the first
+  // user key after the range.  Used as the largest key of tables whose
+  // range deletions extend past their other entries.
+  InternalKey EndKey() const {
+    return InternalKey(end, kMaxSequenceNumber, kTypeRangeDeletion);
+  }
+
+  std::string start;
+  std::string end;
+  SequenceNumber sequence;
+};
+
+// Widen [*smallest, *largest], the key range of a table, so that it covers
+// "tombstone".  If "empty", the range has not been set yet.
+void ExtendKeyRange(const InternalKeyComparator& icmp,
+                    const RangeTombstone& tombstone, bool empty,
+                    InternalKey* smallest, InternalKey* largest);
+
+// Append the range deletions yielded by "iter" to *tombstones.  Returns
+// the status of "iter".
+Status ReadRangeTombstones(Iterator* iter,
+                           std::vector<RangeTombstone>* tombstones);
+
+// The range deletions of a memtable or table, split into fragments so that
+// point lookups binary search them.  Unlike RangeDelAggregator, it answers
+// for any snapshot, so it can be built once per set of range deletions and
+// shared.  Safe for concurrent use once built.
+class FragmentedRangeTombstones {
+ public:
+  FragmentedRangeTombstones(const Comparator* ucmp,
+                            const std::vector<RangeTombstone>& tombstones);
+
+  FragmentedRangeTombstones(const FragmentedRangeTombstones&) = delete;
+  FragmentedRangeTombstones& operator=(const FragmentedRangeTombstones&) =
+      delete;
+
+  // Return the largest sequence number <= "snapshot" of the range
+  // deletions that cover "user_key", or 0 if there is none.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key,
+                                     SequenceNumber snapshot) const;
+
+ private:
+  // A piece of the key space over which the covering range deletions do
+  // not change.  Fragments are disjoint and sorted by start key.
+  struct Fragment {
+    std::string start;
+    std::string end;
+    // The sequence numbers of the covering range deletions are
+    // sequences_[seq_begin, seq_end), largest first.
+    size_t seq_begin;
+    size_t seq_end;
+  };
+
+  const Comparator* const ucmp_;
+  std::vector<Fragment> fragments_;
+  std::vector<SequenceNumber> sequences_;
+};
+
+// Collects the range deletions visible at a sequence number and tells
+// which entries they delete.  Not safe for concurrent use.
+class RangeDelAggregator {
+ public:
+  RangeDelAggregator(const Comparator* ucmp, SequenceNumber snapshot);
+
+  RangeDelAggregator(const RangeDelAggregator&) = delete;
+  RangeDelAggregator& operator=(const RangeDelAggregator&) = delete;
+
+  // Add the range deletions yielded by "iter" that are visible at the
+  // snapshot.  Returns the status of "iter".
+  Status AddTombstones(Iterator* iter);
+  void Add(const RangeTombstone& tombstone);
+
+  bool empty() const { return tombstones_.empty(); }
+
+  // Return true iff an added range deletion covers "key" and is newer.
+  bool ShouldDelete(const ParsedInternalKey& key) {
+    return !tombstones_.empty() && MaxCoveringSequence(key.user_key) >
+                                       key.sequence;
+  }
+
+  // Return the largest sequence number of the added range deletions that
+  // cover "user_key", or 0 if there is none.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key);
+
+  const std::vector<RangeTombstone>& tombstones() const { return tombstones_; }
+
+ private:
+  // A piece of the key space over which the covering range deletions do
+  // not change.  Fragments are disjoint and sorted by start key.
+  struct Fragment {
+    std::string start;
+    std::string end;
+    SequenceNumber sequence;  // Largest sequence number covering it
+  };
+
+  void BuildFragments();
+
+  const Comparator* const ucmp_;
+  const SequenceNumber snapshot_;
+  std::vector<RangeTombstone> tombstones_;
+  std::vector<Fragment> fragments_;
+  bool fragments_valid_;  // fragments_ reflects all of tombstones_
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_DEL_H_
@@ -7,6 +7,7 @@
 // (2) We scan every table to compute
 //     (a) smallest/largest for the table
 //     (b) largest sequence number in the table
+//     (c) the blob file values the table refers to
 // (3) We generate descriptor contents:
 //      - log number is set to zero
 //      - next-file-number is set to 1 + largest file number we found
@@ -14,6 +15,8 @@
 //        all tables (see 2c)
 //      - compaction pointers are cleared
 //      - every table file is added at level 0
+//      - every blob file that some table refers to is added, holding
+//        just the values referred to
 //
 // Possible optimization 1:
 //   (a) Compute total size and use to pick appropriate max-level M
@@ -24,6 +27,9 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <map>
+
+#include "db/blob_file.h"
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -31,6 +37,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -119,6 +126,8 @@ class Repairer {
             logs_.push_back(number);
           } else if (type == kTableFile) {
             table_numbers_.push_back(number);
+          } else if (type == kBlobFile) {
+            blob_numbers_.push_back(number);
           } else {
             // Ignore other files
           }
@@ -203,8 +212,11 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    Iterator* range_del_iter = mem->NewRangeDeletionIterator();
+    status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                        range_del_iter, &meta, nullptr);
     delete iter;
+    delete range_del_iter;
     mem->Unref();
     mem = nullptr;
     if (status.ok()) {
@@ -259,6 +271,8 @@ class Repairer {
     bool empty = true;
     ParsedInternalKey parsed;
     t.max_sequence = 0;
+    t.meta.num_entries = 0;
+    t.meta.num_deletions = 0;
     for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
       Slice key = iter->key();
       if (!ParseInternalKey(key, &parsed)) {
@@ -268,6 +282,10 @@ class Repairer {
       }
 
       counter++;
+      t.meta.num_entries++;
+      if (parsed.type == kTypeDeletion) {
+        t.meta.num_deletions++;
+      }
       if (empty) {
         empty = false;
         t.meta.smallest.DecodeFrom(key);
@@ -276,11 +294,39 @@ class Repairer {
       if (parsed.sequence > t.max_sequence) {
         t.max_sequence = parsed.sequence;
       }
+      BlobIndex index;
+      if (parsed.type == kTypeBlobIndex && index.DecodeFrom(iter->value())) {
+        blob_refs_[index.file_number] += index.size;
+      }
     }
     if (!iter->status().ok()) {
       status = iter->status();
     }
     delete iter;
+
+    // Widen the key range to the range deletions of the table.
+    t.meta.has_range_deletions = false;
+    iter = table_cache_->NewRangeDeletionIterator(&t.meta, false);
+    for (iter->SeekToFirst(); status.ok() && iter->Valid(); iter->Next()) {
+      if (!ParseInternalKey(iter->key(), &parsed)) {
+        status = Status::Corruption("unparsable range deletion key");
+        break;
+      }
+      ExtendKeyRange(icmp_, RangeTombstone(parsed.user_key, iter->value(),
+                                           parsed.sequence),
+                     empty, &t.meta.smallest, &t.meta.largest);
+      t.meta.has_range_deletions = true;
+      t.meta.num_entries++;
+      t.meta.num_deletions++;
+      empty = false;
+      if (parsed.sequence > t.max_sequence) {
+        t.max_sequence = parsed.sequence;
+      }
+    }
+    if (status.ok() && !iter->status().ok()) {
+      status = iter->status();
+    }
+    delete iter;
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -312,6 +358,12 @@ class Repairer {
       counter++;
     }
     delete iter;
+    iter = table_cache_->NewRangeDeletionIterator(&t.meta, false);
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+      builder->AddRangeDeletion(iter->key(), iter->value());
+      counter++;
+    }
+    delete iter;
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -369,7 +421,19 @@ class Repairer {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
       edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+                    t.meta.largest, t.meta.has_range_deletions,
+                    t.meta.num_entries, t.meta.num_deletions);
+    }
+
+    // Values that no table refers to are not counted, so that a blob file
+    // is dropped once the tables stop referring to it.
+    for (uint64_t number : blob_numbers_) {
+      auto it = blob_refs_.find(number);
+      uint64_t file_size;
+      if (it != blob_refs_.end() &&
+          env_->GetFileSize(BlobFileName(dbname_, number), &file_size).ok()) {
+        edit_.AddBlobFile(number, file_size, it->second);
+      }
     }
 
     // std::fprintf(stderr,
@@ -437,6 +501,8 @@ class Repairer {
 
   std::vector<std::string> manifests_;
   std::vector<uint64_t> table_numbers_;
+  std::vector<uint64_t> blob_numbers_;
+  std::map<uint64_t, uint64_t> blob_refs_;  // Bytes referred to, by file
   std::vector<uint64_t> logs_;
   std::vector<TableInfo> tables_;
   uint64_t next_file_number_;
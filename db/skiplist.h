@@ -54,8 +54,23 @@ class SkipList {
 
   // Insert key into the list.
   // REQUIRES: nothing that compares equal to key is currently in the list.
+  //
+  // Inserting keys in ascending order is cheap: if key sorts immediately
+  // after the previously inserted key, the position found by the previous
+  // insertion is reused instead of searching from the head of the list.
   void Insert(const Key& key);
 
+  // Allocate "key_size" bytes of key storage in the same arena allocation
+  // as the node that will hold the key, directly after the node's array of
+  // next pointers.  Searching the list then touches a single allocation
+  // per node instead of chasing a pointer to a separately allocated key.
+  //
+  // The caller must fill in the returned buffer and pass it to Insert()
+  // before calling AllocateKey() again.
+  //
+  // REQUIRES: Key is a pointer type that the returned buffer converts to.
+  char* AllocateKey(size_t key_size);
+
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
@@ -119,6 +134,10 @@ class SkipList {
   // node at "level" for every level in [0..max_height_-1].
   Node* FindGreaterOrEqual(const Key& key, Node** prev) const;
 
+  // Return true if prev_ is a valid insertion point for key, i.e. key
+  // falls between prev_[0] and its successor.
+  bool SpliceIsValid(const Key& key) const;
+
   // Return the latest node with a key < key.
   // Return head_ if there is no such node.
   Node* FindLessThan(const Key& key) const;
@@ -139,6 +158,18 @@ class SkipList {
 
   // Read/written only by Insert().
   Random rnd_;
+
+  // Read/written only by Insert().  prev_[level] is the node before the
+  // most recently inserted node at "level" (or that node itself if it is
+  // at least level+1 high), so it is always a valid insertion point for
+  // a key that sorts just after the last insertion.
+  Node* prev_[kMaxHeight];
+
+  // Node allocated by the last AllocateKey() call that has not yet been
+  // inserted, and its height.  Read/written only by AllocateKey() and
+  // Insert().
+  Node* pending_node_;
+  int pending_height_;
 };
 
 // Implementation details follow
@@ -186,6 +217,19 @@ typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
   return new (node_memory) Node(key);
 }
 
+template <typename Key, class Comparator>
+char* SkipList<Key, Comparator>::AllocateKey(size_t key_size) {
+  assert(pending_node_ == nullptr);
+  const int height = RandomHeight();
+  const size_t node_size =
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+  char* const node_memory = arena_->AllocateAligned(node_size + key_size);
+  char* const key_memory = node_memory + node_size;
+  pending_node_ = new (node_memory) Node(key_memory);
+  pending_height_ = height;
+  return key_memory;
+}
+
 template <typename Key, class Comparator>
 inline SkipList<Key, Comparator>::Iterator::Iterator(const SkipList* list) {
   list_ = list;
@@ -280,6 +324,17 @@ SkipList<Key, Comparator>::FindGreaterOrEqual(const Key& key,
   }
 }
 
+template <typename Key, class Comparator>
+bool SkipList<Key, Comparator>::SpliceIsValid(const Key& key) const {
+  // Every prev_[level] is at or before prev_[0], and every successor
+  // prev_[level]->Next(level) is at or after prev_[0]->Next(0), so it is
+  // enough to check the bottom level.
+  if (prev_[0] != head_ && compare_(prev_[0]->key, key) >= 0) {
+    return false;
+  }
+  return !KeyIsAfterNode(key, prev_[0]->NoBarrier_Next(0));
+}
+
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node*
 SkipList<Key, Comparator>::FindLessThan(const Key& key) const {
@@ -327,9 +382,12 @@ SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
       arena_(arena),
       head_(NewNode(0 /* any key will do */, kMaxHeight)),
       max_height_(1),
-      rnd_(0xdeadbeef) {
+      rnd_(0xdeadbeef),
+      pending_node_(nullptr),
+      pending_height_(0) {
   for (int i = 0; i < kMaxHeight; i++) {
     head_->SetNext(i, nullptr);
+    prev_[i] = head_;
   }
 }
 
@@ -337,13 +395,30 @@ template <typename Key, class Comparator>
 void SkipList<Key, Comparator>::Insert(const Key& key) {
   // TODO(opt): We can use a barrier-free variant of FindGreaterOrEqual()
   // here since Insert() is externally synchronized.
-  Node* prev[kMaxHeight];
-  Node* x = FindGreaterOrEqual(key, prev);
+  Node** const prev = prev_;
+  Node* x;
+  if (SpliceIsValid(key)) {
+    // Fast path for sequential inserts: the splice left behind by the
+    // previous insertion is still correct for this key.
+    x = prev[0]->NoBarrier_Next(0);
+  } else {
+    x = FindGreaterOrEqual(key, prev);
+  }
 
   // Our data structure does not allow duplicate insertion
   assert(x == nullptr || !Equal(key, x->key));
 
-  int height = RandomHeight();
+  int height;
+  Node* node;
+  if (pending_node_ != nullptr && pending_node_->key == key) {
+    // The key lives inside a node set up by AllocateKey().
+    node = pending_node_;
+    height = pending_height_;
+    pending_node_ = nullptr;
+  } else {
+    height = RandomHeight();
+    node = NewNode(key, height);
+  }
   if (height > GetMaxHeight()) {
     for (int i = GetMaxHeight(); i < height; i++) {
       prev[i] = head_;
@@ -358,12 +433,14 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
     max_height_.store(height, std::memory_order_relaxed);
   }
 
-  x = NewNode(key, height);
+  x = node;
   for (int i = 0; i < height; i++) {
     // NoBarrier_SetNext() suffices since we will add a barrier when
     // we publish a pointer to "x" in prev[i].
     x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
     prev[i]->SetNext(i, x);
+    // Remember the splice just after x for the next insertion.
+    prev[i] = x;
   }
 }
 
@@ -5,7 +5,9 @@
 #include "db/skiplist.h"
 
 #include <atomic>
+#include <cstring>
 #include <set>
+#include <string>
 
 #include "gtest/gtest.h"
 #include "leveldb/env.h"
@@ -125,6 +127,94 @@ TEST(SkipTest, InsertAndLookup) {
   }
 }
 
+TEST(SkipTest, NearlySequentialInsert) {
+  // Mostly ascending keys with occasional jumps backwards, so that both
+  // the sequential-insert fast path and the full search are exercised.
+  const int N = 5000;
+  Random rnd(301);
+  std::set<Key> keys;
+  Arena arena;
+  Comparator cmp;
+  SkipList<Key, Comparator> list(cmp, &arena);
+  Key next = 1000000;
+  for (int i = 0; i < N; i++) {
+    Key key;
+    if (rnd.OneIn(10)) {
+      key = rnd.Next() % next;
+    } else {
+      key = next;
+      next += 1 + rnd.Uniform(3);
+    }
+    if (keys.insert(key).second) {
+      list.Insert(key);
+    }
+  }
+
+  for (std::set<Key>::iterator it = keys.begin(); it != keys.end(); ++it) {
+    ASSERT_TRUE(list.Contains(*it));
+  }
+
+  SkipList<Key, Comparator>::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (std::set<Key>::iterator it = keys.begin(); it != keys.end(); ++it) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*it, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+
+  // Walk backwards as well so that every level's links are checked.
+  iter.SeekToLast();
+  for (std::set<Key>::reverse_iterator it = keys.rbegin(); it != keys.rend();
+       ++it) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*it, iter.key());
+    iter.Prev();
+  }
+  ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(SkipTest, InlineKeys) {
+  struct StringComparator {
+    int operator()(const char* a, const char* b) const {
+      return std::strcmp(a, b);
+    }
+  };
+
+  const int N = 2000;
+  Random rnd(1000);
+  std::set<std::string> keys;
+  Arena arena;
+  StringComparator cmp;
+  SkipList<const char*, StringComparator> list(cmp, &arena);
+  for (int i = 0; i < N; i++) {
+    std::string key = std::to_string(rnd.Next() % 5000);
+    if (i % 2 == 0) {
+      // Interleave with keys that are stored outside the node.
+      key.append("-external");
+      if (keys.insert(key).second) {
+        char* buf = arena.Allocate(key.size() + 1);
+        std::memcpy(buf, key.c_str(), key.size() + 1);
+        list.Insert(buf);
+      }
+    } else if (keys.insert(key).second) {
+      char* buf = list.AllocateKey(key.size() + 1);
+      std::memcpy(buf, key.c_str(), key.size() + 1);
+      list.Insert(buf);
+    }
+  }
+
+  SkipList<const char*, StringComparator>::Iterator iter(&list);
+  iter.SeekToFirst();
+  for (const std::string& key : keys) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(key, iter.key());
+    ASSERT_TRUE(list.Contains(key.c_str()));
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+}
+
 // We want to make sure that with a single writer and multiple
 // concurrent readers (with no synchronization other than when a
 // reader's iterator is created), the reader always observes all the
@@ -4,8 +4,13 @@
 
 #include "db/table_cache.h"
 
+#include <atomic>
+#include <vector>
+
 #include "db/filename.h"
+#include "db/range_del.h"
 #include "leveldb/env.h"
+#include "leveldb/persistent_cache.h"
 #include "leveldb/table.h"
 #include "util/coding.h"
 
@@ -14,15 +19,48 @@ namespace leveldb {
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  // The range deletions of "table", fragmented by the first point lookup
+  // that needs them.
+  std::atomic<const FragmentedRangeTombstones*> range_del_fragments;
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  delete tf->range_del_fragments.load(std::memory_order_relaxed);
   delete tf->table;
   delete tf->file;
   delete tf;
 }
 
+// A row cache entry holds the newest entry for a user key in a table,
+// encoded as the length-prefixed internal key followed by the value, or
+// is empty if the table does not contain the user key.
+static void DeleteRow(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+namespace {
+struct RowSaver {
+  const Comparator* ucmp;
+  Slice user_key;
+  std::string* row;
+};
+}  // namespace
+
+static void SaveRow(void* arg, const Slice& ikey, const Slice& v) {
+  RowSaver* saver = reinterpret_cast<RowSaver*>(arg);
+  if (ikey.size() >= 8 &&
+      saver->ucmp->Compare(ExtractUserKey(ikey), saver->user_key) == 0) {
+    PutLengthPrefixedSlice(saver->row, ikey);
+    saver->row->append(v.data(), v.size());
+  }
+}
+
+// Returns the sequence number of the internal key "ikey".
+static SequenceNumber SequenceOf(const Slice& ikey) {
+  return DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+}
+
 static void UnrefEntry(void* arg1, void* arg2) {
   Cache* cache = reinterpret_cast<Cache*>(arg1);
   Cache::Handle* h = reinterpret_cast<Cache::Handle*>(arg2);
@@ -34,7 +72,12 @@ TableCache::TableCache(const std::string& dbname, const Options& options,
     : env_(options.env),
       dbname_(dbname),
       options_(options),
-      cache_(NewLRUCache(entries)) {}
+      cache_(NewLRUCache(entries)),
+      row_cache_(options.row_cache),
+      row_cache_id_(row_cache_ != nullptr ? row_cache_->NewId() : 0),
+      persistent_cache_id_(options.persistent_cache != nullptr
+                               ? options.persistent_cache->NewId()
+                               : 0) {}
 
 TableCache::~TableCache() { delete cache_; }
 
@@ -59,6 +102,10 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
     if (s.ok()) {
       s = Table::Open(options_, file, file_size, &table);
     }
+    if (s.ok() && options_.persistent_cache != nullptr) {
+      // Blocks cached before the table was evicted from cache_ stay usable.
+      table->SetPersistentCacheKey(persistent_cache_id_, file_number);
+    }
 
     if (!s.ok()) {
       assert(table == nullptr);
@@ -69,12 +116,35 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      tf->range_del_fragments.store(nullptr, std::memory_order_relaxed);
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
   return s;
 }
 
+Status TableCache::FindTable(FileMetaData* file, bool pin,
+                             Cache::Handle** handle, bool* release) {
+  *handle = file->table.load(std::memory_order_acquire);
+  if (*handle != nullptr) {
+    *release = false;
+    return Status::OK();
+  }
+
+  Status s = FindTable(file->number, file->file_size, handle);
+  *release = true;
+  if (s.ok() && pin) {
+    // Hand our reference over to "file" unless another thread pinned the
+    // table first.
+    Cache::Handle* expected = nullptr;
+    if (file->table.compare_exchange_strong(expected, *handle,
+                                            std::memory_order_acq_rel)) {
+      *release = false;
+    }
+  }
+  return s;
+}
+
 Iterator* TableCache::NewIterator(const ReadOptions& options,
                                   uint64_t file_number, uint64_t file_size,
                                   Table** tableptr) {
@@ -97,15 +167,212 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
   return result;
 }
 
+bool TableCache::LookupRow(uint64_t file_number, const Slice& k,
+                           std::string* row_key, void* arg,
+                           void (*handle_result)(void*, const Slice&,
+                                                 const Slice&)) {
+  if (row_cache_ == nullptr) {
+    return false;
+  }
+  Slice user_key = ExtractUserKey(k);
+  char buf[16];
+  EncodeFixed64(buf, row_cache_id_);
+  EncodeFixed64(buf + 8, file_number);
+  row_key->assign(buf, sizeof(buf));
+  row_key->append(user_key.data(), user_key.size());
+
+  Cache::Handle* handle = row_cache_->Lookup(*row_key);
+  if (handle == nullptr) {
+    return false;
+  }
+  Slice row(*reinterpret_cast<std::string*>(row_cache_->Value(handle)));
+  bool answered = true;
+  Slice found_key;
+  if (GetLengthPrefixedSlice(&row, &found_key)) {
+    if (SequenceOf(found_key) <= SequenceOf(k)) {
+      (*handle_result)(arg, found_key, row);
+    } else {
+      // The newest entry is not visible to the snapshot being read, and
+      // an older one has to come from the table.
+      answered = false;
+    }
+  }
+  row_cache_->Release(handle);
+  return answered;
+}
+
+Status TableCache::TableGet(const ReadOptions& options, Table* t,
+                            const Slice& k, const Slice& row_key, void* arg,
+                            void (*handle_result)(void*, const Slice&,
+                                                  const Slice&)) {
+  if (row_cache_ == nullptr || !options.fill_cache) {
+    return t->InternalGet(options, k, arg, handle_result);
+  }
+
+  // Read the newest entry for the user key, whichever snapshot is being
+  // read, so that the cached row serves every later reader.
+  Slice user_key = ExtractUserKey(k);
+  InternalKey newest(user_key, kMaxSequenceNumber, kValueTypeForSeek);
+  std::string* row = new std::string;
+  RowSaver saver;
+  saver.ucmp =
+      static_cast<const InternalKeyComparator*>(options_.comparator)
+          ->user_comparator();
+  saver.user_key = user_key;
+  saver.row = row;
+  Status s = t->InternalGet(options, newest.Encode(), &saver, &SaveRow);
+  if (!s.ok()) {
+    delete row;
+    return s;
+  }
+
+  Slice found(*row);
+  Slice found_key;
+  bool answered = true;
+  if (GetLengthPrefixedSlice(&found, &found_key)) {
+    if (SequenceOf(found_key) <= SequenceOf(k)) {
+      (*handle_result)(arg, found_key, found);
+    } else {
+      answered = false;
+    }
+  }
+  row_cache_->Release(row_cache_->Insert(
+      row_key, row, row_key.size() + sizeof(std::string) + row->size(),
+      &DeleteRow));
+  if (!answered) {
+    s = t->InternalGet(options, k, arg, handle_result);
+  }
+  return s;
+}
+
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
                                              const Slice&)) {
+  std::string row_key;
+  if (LookupRow(file_number, k, &row_key, arg, handle_result)) {
+    return Status::OK();
+  }
+
   Cache::Handle* handle = nullptr;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result);
+    s = TableGet(options, t, k, row_key, arg, handle_result);
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Iterator* TableCache::NewIterator(const ReadOptions& options,
+                                  FileMetaData* file, bool pin) {
+  Cache::Handle* handle = nullptr;
+  bool release;
+  Status s = FindTable(file, pin, &handle, &release);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewIterator(options);
+  if (release) {
+    result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  }
+  return result;
+}
+
+Iterator* TableCache::NewRangeDeletionIterator(FileMetaData* file, bool pin) {
+  Cache::Handle* handle = nullptr;
+  bool release;
+  Status s = FindTable(file, pin, &handle, &release);
+  if (!s.ok()) {
+    return NewErrorIterator(s);
+  }
+
+  Table* table = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+  Iterator* result = table->NewRangeDeletionIterator();
+  if (release) {
+    result->RegisterCleanup(&UnrefEntry, cache_, handle);
+  }
+  return result;
+}
+
+Status TableCache::MaxCoveringTombstone(FileMetaData* file, bool pin,
+                                        const Slice& user_key,
+                                        SequenceNumber snapshot,
+                                        SequenceNumber* sequence) {
+  Cache::Handle* handle = nullptr;
+  bool release;
+  Status s = FindTable(file, pin, &handle, &release);
+  if (!s.ok()) {
+    return s;
+  }
+
+  TableAndFile* tf = reinterpret_cast<TableAndFile*>(cache_->Value(handle));
+  const FragmentedRangeTombstones* fragments =
+      tf->range_del_fragments.load(std::memory_order_acquire);
+  if (fragments == nullptr) {
+    std::vector<RangeTombstone> tombstones;
+    Iterator* iter = tf->table->NewRangeDeletionIterator();
+    s = ReadRangeTombstones(iter, &tombstones);
+    delete iter;
+    if (s.ok()) {
+      const Comparator* ucmp =
+          static_cast<const InternalKeyComparator*>(options_.comparator)
+              ->user_comparator();
+      FragmentedRangeTombstones* built =
+          new FragmentedRangeTombstones(ucmp, tombstones);
+      // Another lookup may have built them first.
+      if (tf->range_del_fragments.compare_exchange_strong(
+              fragments, built, std::memory_order_acq_rel)) {
+        fragments = built;
+      } else {
+        delete built;
+      }
+    }
+  }
+  if (s.ok()) {
+    *sequence = fragments->MaxCoveringSequence(user_key, snapshot);
+  }
+  if (release) {
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::Get(const ReadOptions& options, FileMetaData* file,
+                       bool pin, const Slice& k, void* arg,
+                       void (*handle_result)(void*, const Slice&,
+                                             const Slice&)) {
+  std::string row_key;
+  if (LookupRow(file->number, k, &row_key, arg, handle_result)) {
+    return Status::OK();
+  }
+
+  Cache::Handle* handle = nullptr;
+  bool release;
+  Status s = FindTable(file, pin, &handle, &release);
+  if (s.ok()) {
+    Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+    s = TableGet(options, t, k, row_key, arg, handle_result);
+    if (release) {
+      cache_->Release(handle);
+    }
+  }
+  return s;
+}
+
+void TableCache::Unpin(FileMetaData* file) {
+  Cache::Handle* handle = file->table.exchange(nullptr);
+  if (handle != nullptr) {
+    cache_->Release(handle);
+  }
+}
+
+Status TableCache::Load(uint64_t file_number, uint64_t file_size) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
     cache_->Release(handle);
   }
   return s;
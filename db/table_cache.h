@@ -11,6 +11,7 @@
 #include <string>
 
 #include "db/dbformat.h"
+#include "db/version_edit.h"
 #include "leveldb/cache.h"
 #include "leveldb/table.h"
 #include "port/port.h"
@@ -40,16 +41,66 @@ class TableCache {
              uint64_t file_size, const Slice& k, void* arg,
              void (*handle_result)(void*, const Slice&, const Slice&));
 
+  // Same as above, for the table described by "file".  If "pin" is true,
+  // the table is kept open for as long as "file" is alive, and later
+  // calls for "file" skip the cache lookup.  REQUIRES: "file" outlives
+  // the returned iterator, and Unpin(file) is called before "file" is
+  // deleted.
+  Iterator* NewIterator(const ReadOptions& options, FileMetaData* file,
+                        bool pin);
+  Status Get(const ReadOptions& options, FileMetaData* file, bool pin,
+             const Slice& k, void* arg,
+             void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Return an iterator over the range deletions of the table described by
+  // "file" (see Table::NewRangeDeletionIterator()).  "pin" is as above.
+  Iterator* NewRangeDeletionIterator(FileMetaData* file, bool pin);
+
+  // Store in *sequence the largest sequence number <= "snapshot" of the
+  // range deletions of the table described by "file" that cover
+  // "user_key", or 0 if there is none.  The range deletions are fragmented
+  // once per open table.  "pin" is as above.
+  Status MaxCoveringTombstone(FileMetaData* file, bool pin,
+                              const Slice& user_key, SequenceNumber snapshot,
+                              SequenceNumber* sequence);
+
+  // Release the table pinned for "file", if any.
+  void Unpin(FileMetaData* file);
+
+  // Open the specified file and keep it in the cache, unless it is
+  // there already.
+  Status Load(uint64_t file_number, uint64_t file_size);
+
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
 
  private:
   Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
 
+  // Answer the lookup of internal key "k" in "file_number" from the row
+  // cache if possible.  Sets *row_key to the row cache key.
+  bool LookupRow(uint64_t file_number, const Slice& k, std::string* row_key,
+                 void* arg,
+                 void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Look "k" up in table "t", filling the row cache entry "row_key" on the
+  // way if the row cache is enabled.
+  Status TableGet(const ReadOptions& options, Table* t, const Slice& k,
+                  const Slice& row_key, void* arg,
+                  void (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Find the table for "file", pinning it if "pin" is true.  Sets
+  // *release to whether the caller must release the returned handle.
+  Status FindTable(FileMetaData* file, bool pin, Cache::Handle** handle,
+                   bool* release);
+
   Env* const env_;
   const std::string dbname_;
   const Options& options_;
   Cache* cache_;
+  Cache* const row_cache_;
+  const uint64_t row_cache_id_;
+  const uint64_t persistent_cache_id_;
 };
 
 }  // namespace leveldb
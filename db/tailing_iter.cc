@@ -0,0 +1,161 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/tailing_iter.h"
+
+#include <cassert>
+#include <vector>
+
+#include "db/db_impl.h"
+#include "db/db_iter.h"
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "db/range_del.h"
+#include "db/version_set.h"
+#include "table/merger.h"
+
+namespace leveldb {
+
+namespace {
+
+// Forwards to an iterator owned by someone else, so that the merging
+// iterator built on each seek can be deleted without deleting the
+// iterators it merges.
+class BorrowedIterator : public Iterator {
+ public:
+  explicit BorrowedIterator(Iterator* iter) : iter_(iter) {}
+
+  bool Valid() const override { return iter_->Valid(); }
+  void Seek(const Slice& target) override { iter_->Seek(target); }
+  void SeekToFirst() override { iter_->SeekToFirst(); }
+  void SeekToLast() override { iter_->SeekToLast(); }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+  Slice key() const override { return iter_->key(); }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  Iterator* const iter_;
+};
+
+}  // namespace
+
+class TailingIterator : public Iterator {
+ public:
+  TailingIterator(DBImpl* db, const ReadOptions& options)
+      : db_(db),
+        options_(options),
+        bounds_(options),
+        sv_(nullptr),
+        mem_iter_(nullptr),
+        imm_iter_(nullptr),
+        db_iter_(nullptr) {}
+
+  TailingIterator(const TailingIterator&) = delete;
+  TailingIterator& operator=(const TailingIterator&) = delete;
+
+  ~TailingIterator() override {
+    delete db_iter_;
+    delete mem_iter_;
+    delete imm_iter_;
+    if (sv_ != nullptr) {
+      db_->ReleaseSuperVersion(sv_);
+    }
+  }
+
+  bool Valid() const override {
+    return db_iter_ != nullptr && db_iter_->Valid();
+  }
+  void Seek(const Slice& target) override {
+    Refresh();
+    db_iter_->Seek(target);
+  }
+  void SeekToFirst() override {
+    Refresh();
+    db_iter_->SeekToFirst();
+  }
+  void SeekToLast() override {
+    Refresh();
+    db_iter_->SeekToLast();
+  }
+  void Next() override {
+    assert(Valid());
+    db_iter_->Next();
+  }
+  void Prev() override {
+    assert(Valid());
+    db_iter_->Prev();
+  }
+  Slice key() const override {
+    assert(Valid());
+    return db_iter_->key();
+  }
+  Slice value() const override {
+    assert(Valid());
+    return db_iter_->value();
+  }
+  Status status() const override {
+    return db_iter_ != nullptr ? db_iter_->status() : Status::OK();
+  }
+
+ private:
+  // Catch up with the current state of the database, rebuilding only the
+  // child iterators whose sources have changed.
+  void Refresh() {
+    // Read the sequence number before pinning the state to read from, so
+    // that every write up to it is visible in that state.
+    const SequenceNumber sequence = db_->LastSequence();
+    DBImpl::SuperVersion* sv = db_->AcquireSuperVersion();
+
+    delete db_iter_;
+    if (sv_ == nullptr || sv->mem != sv_->mem) {
+      delete mem_iter_;
+      mem_iter_ = sv->mem->NewIterator();
+    }
+    if (sv_ == nullptr || sv->imm != sv_->imm || sv->current != sv_->current) {
+      delete imm_iter_;
+      std::vector<Iterator*> list;
+      if (sv->imm != nullptr) {
+        list.push_back(sv->imm->NewIterator());
+      }
+      sv->current->AddIterators(bounds_.options(), &list);
+      imm_iter_ = NewMergingIterator(&db_->internal_comparator_, list.data(),
+                                     list.size());
+    }
+    if (sv_ != nullptr) {
+      db_->ReleaseSuperVersion(sv_);
+    }
+    sv_ = sv;
+
+    RangeDelAggregator* range_del;
+    Status s = db_->CollectRangeDeletions(options_, sv_, sequence, &range_del);
+    if (!s.ok()) {
+      db_iter_ = NewErrorIterator(s);
+      return;
+    }
+    Iterator* children[2] = {new BorrowedIterator(mem_iter_),
+                             new BorrowedIterator(imm_iter_)};
+    const uint32_t seed =
+        db_->seed_.fetch_add(1, std::memory_order_relaxed) + 1;
+    db_iter_ = NewDBIterator(
+        db_, db_->user_comparator(),
+        NewMergingIterator(&db_->internal_comparator_, children, 2),
+        range_del, db_->options_.merge_operator, sequence, seed, options_);
+  }
+
+  DBImpl* const db_;
+  const ReadOptions options_;
+  const InternalIterateBounds bounds_;
+  DBImpl::SuperVersion* sv_;  // State the child iterators were built from
+  Iterator* mem_iter_;
+  Iterator* imm_iter_;  // Immutable memtable and tables
+  Iterator* db_iter_;
+};
+
+Iterator* NewTailingIterator(DBImpl* db, const ReadOptions& options) {
+  return new TailingIterator(db, options);
+}
+
+}  // namespace leveldb
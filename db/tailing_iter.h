@@ -0,0 +1,24 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_TAILING_ITER_H_
+#define STORAGE_LEVELDB_DB_TAILING_ITER_H_
+
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+class DBImpl;
+
+// Return a new iterator over "db" that sees the writes made before each
+// of its seeks.  The iterators over the memtable, the immutable memtable
+// and the tables are kept between seeks: the memtable iterator is reused
+// until the memtable is switched, and the rest until the set of tables
+// changes.
+Iterator* NewTailingIterator(DBImpl* db, const ReadOptions& options);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_TAILING_ITER_H_
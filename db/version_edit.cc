@@ -20,7 +20,16 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  // Same as kNewFile, for tables that hold range deletions
+  kNewFileWithRangeDeletions = 10,
+  kNewBlobFile = 11,
+  kBlobGarbage = 12,
+  // Entry counts of the file added by the preceding new-file entry
+  kFileStats = 13,
+  // Creation time and compaction mark of the file added by the preceding
+  // new-file entry
+  kFileCompactionHints = 14
 };
 
 void VersionEdit::Clear() {
@@ -36,6 +45,8 @@ void VersionEdit::Clear() {
   has_last_sequence_ = false;
   deleted_files_.clear();
   new_files_.clear();
+  new_blob_files_.clear();
+  blob_garbage_.clear();
 }
 
 void VersionEdit::EncodeTo(std::string* dst) const {
@@ -74,12 +85,40 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    // Files without range deletions keep the old tag, so that databases
+    // that never use them stay readable by older releases.
+    PutVarint32(dst,
+                f.has_range_deletions ? kNewFileWithRangeDeletions : kNewFile);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (f.num_entries > 0) {
+      PutVarint32(dst, kFileStats);
+      PutVarint64(dst, f.number);
+      PutVarint64(dst, f.num_entries);
+      PutVarint64(dst, f.num_deletions);
+    }
+    if (f.creation_time > 0 || f.marked_for_compaction) {
+      PutVarint32(dst, kFileCompactionHints);
+      PutVarint64(dst, f.number);
+      PutVarint64(dst, f.creation_time);
+      PutVarint32(dst, f.marked_for_compaction ? 1 : 0);
+    }
+  }
+
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    PutVarint32(dst, kNewBlobFile);
+    PutVarint64(dst, f.number);
+    PutVarint64(dst, f.file_size);
+    PutVarint64(dst, f.total_bytes);
+  }
+
+  for (const auto& garbage : blob_garbage_) {
+    PutVarint32(dst, kBlobGarbage);
+    PutVarint64(dst, garbage.first);   // file number
+    PutVarint64(dst, garbage.second);  // bytes
   }
 }
 
@@ -112,6 +151,12 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
   int level;
   uint64_t number;
   FileMetaData f;
+  BlobFileMetaData blob;
+  uint64_t bytes;
+  uint64_t entries;
+  uint64_t deletions;
+  uint64_t creation_time;
+  uint32_t marked;
   Slice str;
   InternalKey key;
 
@@ -175,6 +220,10 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         break;
 
       case kNewFile:
+      case kNewFileWithRangeDeletions:
+        f.has_range_deletions = (tag == kNewFileWithRangeDeletions);
+        f.num_entries = 0;
+        f.num_deletions = 0;
         if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
             GetVarint64(&input, &f.file_size) &&
             GetInternalKey(&input, &f.smallest) &&
@@ -185,6 +234,47 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kFileStats:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &entries) &&
+            GetVarint64(&input, &deletions) && !new_files_.empty() &&
+            new_files_.back().second.number == number) {
+          new_files_.back().second.num_entries = entries;
+          new_files_.back().second.num_deletions = deletions;
+        } else {
+          msg = "file stats";
+        }
+        break;
+
+      case kFileCompactionHints:
+        if (GetVarint64(&input, &number) &&
+            GetVarint64(&input, &creation_time) &&
+            GetVarint32(&input, &marked) && marked <= 1 &&
+            !new_files_.empty() && new_files_.back().second.number == number) {
+          new_files_.back().second.creation_time = creation_time;
+          new_files_.back().second.marked_for_compaction = (marked == 1);
+        } else {
+          msg = "file compaction hints";
+        }
+        break;
+
+      case kNewBlobFile:
+        if (GetVarint64(&input, &blob.number) &&
+            GetVarint64(&input, &blob.file_size) &&
+            GetVarint64(&input, &blob.total_bytes)) {
+          new_blob_files_.push_back(blob);
+        } else {
+          msg = "new-blob-file entry";
+        }
+        break;
+
+      case kBlobGarbage:
+        if (GetVarint64(&input, &number) && GetVarint64(&input, &bytes)) {
+          blob_garbage_.push_back(std::make_pair(number, bytes));
+        } else {
+          msg = "blob garbage";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -249,6 +339,36 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.has_range_deletions) {
+      r.append(" with range deletions");
+    }
+    if (f.num_entries > 0) {
+      r.append(" entries ");
+      AppendNumberTo(&r, f.num_entries);
+      r.append(" deletions ");
+      AppendNumberTo(&r, f.num_deletions);
+    }
+    if (f.creation_time > 0) {
+      r.append(" created ");
+      AppendNumberTo(&r, f.creation_time);
+    }
+    if (f.marked_for_compaction) {
+      r.append(" marked for compaction");
+    }
+  }
+  for (const BlobFileMetaData& f : new_blob_files_) {
+    r.append("\n  AddBlobFile: ");
+    AppendNumberTo(&r, f.number);
+    r.append(" ");
+    AppendNumberTo(&r, f.file_size);
+    r.append(" ");
+    AppendNumberTo(&r, f.total_bytes);
+  }
+  for (const auto& garbage : blob_garbage_) {
+    r.append("\n  BlobGarbage: ");
+    AppendNumberTo(&r, garbage.first);
+    r.append(" ");
+    AppendNumberTo(&r, garbage.second);
   }
   r.append("\n}\n");
   return r;
@@ -5,18 +5,58 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 #define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 
+#include <atomic>
 #include <set>
 #include <utility>
 #include <vector>
 
 #include "db/dbformat.h"
+#include "leveldb/cache.h"
 
 namespace leveldb {
 
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        has_range_deletions(false),
+        num_entries(0),
+        num_deletions(0),
+        creation_time(0),
+        marked_for_compaction(false),
+        table(nullptr) {}
+
+  // Copies describe the same file but do not share its pinned table.
+  FileMetaData(const FileMetaData& f)
+      : refs(f.refs),
+        allowed_seeks(f.allowed_seeks),
+        number(f.number),
+        file_size(f.file_size),
+        smallest(f.smallest),
+        largest(f.largest),
+        has_range_deletions(f.has_range_deletions),
+        num_entries(f.num_entries),
+        num_deletions(f.num_deletions),
+        creation_time(f.creation_time),
+        marked_for_compaction(f.marked_for_compaction),
+        table(nullptr) {}
+  FileMetaData& operator=(const FileMetaData& f) {
+    refs = f.refs;
+    allowed_seeks = f.allowed_seeks;
+    number = f.number;
+    file_size = f.file_size;
+    smallest = f.smallest;
+    largest = f.largest;
+    has_range_deletions = f.has_range_deletions;
+    num_entries = f.num_entries;
+    num_deletions = f.num_deletions;
+    creation_time = f.creation_time;
+    marked_for_compaction = f.marked_for_compaction;
+    return *this;
+  }
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +64,33 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  bool has_range_deletions;  // The table holds range deletions
+
+  // Entries of the table, counting range deletions, and how many of them
+  // are deletions.  Zero for tables recorded without these counts.
+  uint64_t num_entries;
+  uint64_t num_deletions;
+
+  // Seconds since the epoch at which the table was written, or zero if
+  // unknown, see Options::periodic_compaction_seconds.
+  uint64_t creation_time;
+
+  // Deletions crowd the table, see Options::deletion_compaction_window.
+  bool marked_for_compaction;
+
+  // Table cache handle pinned by TableCache for as long as the file is
+  // part of a live version, or null.  Set at most once.
+  std::atomic<Cache::Handle*> table;
+};
+
+struct BlobFileMetaData {
+  BlobFileMetaData()
+      : number(0), file_size(0), total_bytes(0), garbage_bytes(0) {}
+
+  uint64_t number;
+  uint64_t file_size;      // File size in bytes
+  uint64_t total_bytes;    // Combined size of the values in the file
+  uint64_t garbage_bytes;  // Combined size of the values no longer referenced
 };
 
 class VersionEdit {
@@ -59,14 +126,26 @@ class VersionEdit {
 
   // Add the specified file at the specified number.
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
-  // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
+  // REQUIRES: "smallest" and "largest" are smallest and largest keys in file,
+  // including the bounds of its range deletions
+  // REQUIRES: "num_entries" and "num_deletions" count the entries of the file
+  // as described for FileMetaData, or are zero if unknown
+  // REQUIRES: "creation_time" is as described for FileMetaData
   void AddFile(int level, uint64_t file, uint64_t file_size,
-               const InternalKey& smallest, const InternalKey& largest) {
+               const InternalKey& smallest, const InternalKey& largest,
+               bool has_range_deletions = false, uint64_t num_entries = 0,
+               uint64_t num_deletions = 0, uint64_t creation_time = 0,
+               bool marked_for_compaction = false) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.has_range_deletions = has_range_deletions;
+    f.num_entries = num_entries;
+    f.num_deletions = num_deletions;
+    f.creation_time = creation_time;
+    f.marked_for_compaction = marked_for_compaction;
     new_files_.push_back(std::make_pair(level, f));
   }
 
@@ -75,6 +154,23 @@ class VersionEdit {
     deleted_files_.insert(std::make_pair(level, file));
   }
 
+  // Add the blob file with the specified number, which holds values of
+  // "total_bytes" bytes in all.
+  void AddBlobFile(uint64_t file, uint64_t file_size, uint64_t total_bytes) {
+    BlobFileMetaData f;
+    f.number = file;
+    f.file_size = file_size;
+    f.total_bytes = total_bytes;
+    new_blob_files_.push_back(f);
+  }
+
+  // Record that values of "bytes" bytes in all in the specified blob file
+  // are no longer referenced.  The file is dropped once none of its values
+  // are referenced.
+  void AddBlobGarbage(uint64_t file, uint64_t bytes) {
+    blob_garbage_.push_back(std::make_pair(file, bytes));
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(const Slice& src);
 
@@ -99,6 +195,8 @@ class VersionEdit {
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
   std::vector<std::pair<int, FileMetaData>> new_files_;
+  std::vector<BlobFileMetaData> new_blob_files_;
+  std::vector<std::pair<uint64_t, uint64_t>> blob_garbage_;
 };
 
 }  // namespace leveldb
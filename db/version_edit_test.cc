@@ -5,6 +5,7 @@
 #include "db/version_edit.h"
 
 #include "gtest/gtest.h"
+#include "util/coding.h"
 
 namespace leveldb {
 
@@ -26,9 +27,13 @@ TEST(VersionEditTest, EncodeDecode) {
     TestEncodeDecode(edit);
     edit.AddFile(3, kBig + 300 + i, kBig + 400 + i,
                  InternalKey("foo", kBig + 500 + i, kTypeValue),
-                 InternalKey("zoo", kBig + 600 + i, kTypeDeletion));
+                 InternalKey("zoo", kBig + 600 + i, kTypeDeletion),
+                 i % 2 == 1, i < 2 ? 0 : kBig + 800 + i, i,
+                 i < 3 ? 0 : kBig + 1600 + i, i == 1);
     edit.RemoveFile(4, kBig + 700 + i);
     edit.SetCompactPointer(i, InternalKey("x", kBig + 900 + i, kTypeValue));
+    edit.AddBlobFile(kBig + 1100 + i, kBig + 1200 + i, kBig + 1300 + i);
+    edit.AddBlobGarbage(kBig + 1400 + i, kBig + 1500 + i);
   }
 
   edit.SetComparatorName("foo");
@@ -38,6 +43,28 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, FileStatsMustFollowTheirFile) {
+  std::string encoded;
+  VersionEdit edit;
+  edit.AddFile(1, 5, 100, InternalKey("a", 1, kTypeValue),
+               InternalKey("b", 2, kTypeValue), false, 10, 3);
+  edit.EncodeTo(&encoded);
+
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+  ASSERT_NE(std::string::npos,
+            parsed.DebugString().find(" entries 10 deletions 3"));
+
+  // Stats that do not follow the entry of their file are corrupt.
+  std::string stats;
+  PutVarint32(&stats, 13);  // kFileStats
+  PutVarint64(&stats, 6);
+  PutVarint64(&stats, 10);
+  PutVarint64(&stats, 3);
+  ASSERT_TRUE(parsed.DecodeFrom(stats).IsCorruption());
+  ASSERT_TRUE(parsed.DecodeFrom(encoded + stats).IsCorruption());
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
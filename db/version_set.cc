@@ -6,11 +6,13 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <limits>
 
 #include "db/filename.h"
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_del.h"
 #include "db/table_cache.h"
 #include "leveldb/env.h"
 #include "leveldb/table_builder.h"
@@ -43,7 +45,7 @@ static double MaxBytesForLevel(const Options* options, int level) {
   // the level-0 compaction threshold based on number of files.
 
   // Result for both level-0 and level-1
-  double result = 10. * 1048576.0;
+  double result = options->max_bytes_for_level_base;
   while (level > 1) {
     result *= 10;
     level--;
@@ -56,6 +58,13 @@ static uint64_t MaxFileSizeForLevel(const Options* options, int level) {
   return TargetFileSize(options);
 }
 
+// Tables in pinned levels stay open for as long as they are part of a
+// live version, so reads skip the table cache lookup.  Level-0 is
+// consulted by nearly every read and only ever holds a few files.
+static bool PinTables(const Options* options, int level) {
+  return level == 0 || options->max_open_files == -1;
+}
+
 static int64_t TotalFileSize(const std::vector<FileMetaData*>& files) {
   int64_t sum = 0;
   for (size_t i = 0; i < files.size(); i++) {
@@ -78,6 +87,7 @@ Version::~Version() {
       assert(f->refs > 0);
       f->refs--;
       if (f->refs <= 0) {
+        vset_->table_cache_->Unpin(f);
         delete f;
       }
     }
@@ -164,24 +174,33 @@ class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
                        const std::vector<FileMetaData*>* flist)
-      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
-  }
-  bool Valid() const override { return index_ < flist_->size(); }
+      : LevelFileNumIterator(icmp, flist, 0, flist->size()) {}
+
+  // Only yields the files with indexes in [begin, end).
+  LevelFileNumIterator(const InternalKeyComparator& icmp,
+                       const std::vector<FileMetaData*>* flist,
+                       uint32_t begin, uint32_t end)
+      : icmp_(icmp),
+        flist_(flist),
+        begin_(begin),
+        end_(end),
+        index_(end) {  // Marks as invalid
+  }
+  bool Valid() const override { return index_ < end_; }
   void Seek(const Slice& target) override {
-    index_ = FindFile(icmp_, *flist_, target);
-  }
-  void SeekToFirst() override { index_ = 0; }
-  void SeekToLast() override {
-    index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    const uint32_t index = FindFile(icmp_, *flist_, target);
+    index_ = std::min(std::max(index, begin_), end_);
   }
+  void SeekToFirst() override { index_ = begin_; }
+  void SeekToLast() override { index_ = (begin_ == end_) ? end_ : end_ - 1; }
   void Next() override {
     assert(Valid());
     index_++;
   }
   void Prev() override {
     assert(Valid());
-    if (index_ == 0) {
-      index_ = flist_->size();  // Marks as invalid
+    if (index_ == begin_) {
+      index_ = end_;  // Marks as invalid
     } else {
       index_--;
     }
@@ -201,6 +220,8 @@ class Version::LevelFileNumIterator : public Iterator {
  private:
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
+  const uint32_t begin_;
+  const uint32_t end_;
   uint32_t index_;
 
   // Backing store for value().  Holds the file number and size.
@@ -220,30 +241,79 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
 }
 
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
-                                            int level) const {
+                                            int level, uint32_t begin,
+                                            uint32_t end) const {
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files_[level], begin, end),
+      &GetFileIterator, vset_->table_cache_, options, &vset_->icmp_);
 }
 
 void Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
+  const InternalKeyComparator& icmp = vset_->icmp_;
+  const Slice* lower = options.iterate_lower_bound;
+  const Slice* upper = options.iterate_upper_bound;
+
   // Merge all level zero files together since they may overlap
+  const bool pin = PinTables(vset_->options_, 0);
   for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
+    FileMetaData* f = files_[0][i];
+    if ((lower != nullptr && icmp.Compare(f->largest.Encode(), *lower) < 0) ||
+        (upper != nullptr && icmp.Compare(f->smallest.Encode(), *upper) >= 0)) {
+      continue;  // Outside the iterate bounds
+    }
+    iters->push_back(vset_->table_cache_->NewIterator(options, f, pin));
   }
 
   // For levels > 0, we can use a concatenating iterator that sequentially
   // walks through the non-overlapping files in the level, opening them
   // lazily.
   for (int level = 1; level < config::kNumLevels; level++) {
-    if (!files_[level].empty()) {
-      iters->push_back(NewConcatenatingIterator(options, level));
+    const std::vector<FileMetaData*>& files = files_[level];
+    if (files.empty()) {
+      continue;
+    }
+    // Only visit the files inside the iterate bounds.
+    const uint32_t begin =
+        (lower != nullptr) ? FindFile(icmp, files, *lower) : 0;
+    uint32_t end = static_cast<uint32_t>(files.size());
+    if (upper != nullptr) {
+      end = FindFile(icmp, files, *upper);
+      if (end < files.size() &&
+          icmp.Compare(files[end]->smallest.Encode(), *upper) < 0) {
+        end++;  // The file straddles the bound
+      }
+    }
+    if (begin < end) {
+      iters->push_back(NewConcatenatingIterator(options, level, begin, end));
     }
   }
 }
 
+Status Version::AddRangeDeletions(const ReadOptions& options,
+                                  RangeDelAggregator* range_del) {
+  const InternalKeyComparator& icmp = vset_->icmp_;
+  const Slice* lower = options.iterate_lower_bound;
+  const Slice* upper = options.iterate_upper_bound;
+  Status s;
+  for (int level = 0; level < config::kNumLevels && s.ok(); level++) {
+    const bool pin = PinTables(vset_->options_, level);
+    for (size_t i = 0; i < files_[level].size() && s.ok(); i++) {
+      FileMetaData* f = files_[level][i];
+      if (!f->has_range_deletions ||
+          (lower != nullptr && icmp.Compare(f->largest.Encode(), *lower) < 0) ||
+          (upper != nullptr &&
+           icmp.Compare(f->smallest.Encode(), *upper) >= 0)) {
+        continue;
+      }
+      Iterator* iter = vset_->table_cache_->NewRangeDeletionIterator(f, pin);
+      s = range_del->AddTombstones(iter);
+      delete iter;
+    }
+  }
+  return s;
+}
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -251,12 +321,17 @@ enum SaverState {
   kFound,
   kDeleted,
   kCorrupt,
+  kMerge,
 };
 struct Saver {
   SaverState state;
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  std::vector<std::string>* operands;
+  bool* is_blob_index;
+  SequenceNumber tombstone;  // Of a range deletion covering the key
+  SequenceNumber sequence;   // Of the entry found, if any
 };
 }  // namespace
 static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
@@ -266,9 +341,19 @@ static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
     s->state = kCorrupt;
   } else {
     if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
-      if (s->state == kFound) {
+      s->sequence = parsed_key.sequence;
+      if (parsed_key.sequence < s->tombstone) {
+        s->state = kDeleted;
+      } else if (parsed_key.type == kTypeValue ||
+                 parsed_key.type == kTypeBlobIndex) {
+        s->state = kFound;
         s->value->assign(v.data(), v.size());
+        *s->is_blob_index = (parsed_key.type == kTypeBlobIndex);
+      } else if (parsed_key.type == kTypeMerge) {
+        s->state = kMerge;
+        s->operands->push_back(v.ToString());
+      } else {
+        s->state = kDeleted;
       }
     }
   }
@@ -301,13 +386,14 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
     }
   }
 
-  // Search other levels.
+  // Search other levels.  Each search narrows the range of candidate
+  // files for the next level.
+  FileIndexer::Range range = file_indexer_.FullRange(1);
   for (int level = 1; level < config::kNumLevels; level++) {
     size_t num_files = files_[level].size();
-    if (num_files == 0) continue;
 
     // Binary search to find earliest index whose largest key >= internal_key.
-    uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
+    uint32_t index = file_indexer_.FindFile(level, internal_key, &range);
     if (index < num_files) {
       FileMetaData* f = files_[level][index];
       if (ucmp->Compare(user_key, f->smallest.user_key()) < 0) {
@@ -322,8 +408,11 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
 }
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    std::string* value, GetStats* stats,
+                    std::vector<std::string>* operands,
+                    bool* is_blob_index) {
   stats->seek_file = nullptr;
+  *is_blob_index = false;
   stats->seek_file_level = -1;
 
   struct State {
@@ -331,9 +420,12 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
     GetStats* stats;
     const ReadOptions* options;
     Slice ikey;
+    InternalKey next_ikey;  // Backs ikey once merge operands have been found
+    SequenceNumber snapshot;
     FileMetaData* last_file_read;
     int last_file_read_level;
 
+    Version* version;
     VersionSet* vset;
     Status s;
     bool found;
@@ -351,31 +443,78 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
-      state->s = state->vset->table_cache_->Get(*state->options, f->number,
-                                                f->file_size, state->ikey,
-                                                &state->saver, SaveValue);
-      if (!state->s.ok()) {
-        state->found = true;
+      if (!state->Search(level, f)) {
         return false;
       }
-      switch (state->saver.state) {
-        case kNotFound:
-          return true;  // Keep searching in other files
-        case kFound:
-          state->found = true;
-          return false;
-        case kDeleted:
+      if (level > 0 && !state->saver.operands->empty()) {
+        // Compactions may split the entries for a key between adjacent
+        // files, so older entries beneath the merge operands can continue
+        // in the next file of the level.
+        const std::vector<FileMetaData*>& files = state->version->files_[level];
+        size_t i = 0;
+        while (files[i] != f) {
+          i++;
+        }
+        for (i++; i < files.size() &&
+                  state->saver.ucmp->Compare(files[i]->smallest.user_key(),
+                                             state->saver.user_key) == 0;
+             i++) {
+          if (!state->Search(level, files[i])) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    // Look for the key in "f".  Returns false if the search is over.
+    bool Search(int level, FileMetaData* f) {
+      const bool pin = PinTables(vset->options_, level);
+      saver.tombstone = 0;
+      if (f->has_range_deletions) {
+        // Files are visited newest first, so a range deletion here hides
+        // the key in this file unless the entry found is newer, as well as
+        // in every file not visited yet.
+        s = vset->table_cache_->MaxCoveringTombstone(
+            f, pin, saver.user_key, snapshot, &saver.tombstone);
+        if (!s.ok()) {
+          found = true;
           return false;
-        case kCorrupt:
-          state->s =
-              Status::Corruption("corrupted key for ", state->saver.user_key);
-          state->found = true;
+        }
+      }
+      for (;;) {
+        saver.state = kNotFound;
+        s = vset->table_cache_->Get(*options, f, pin, ikey, &saver,
+                                    SaveValue);
+        if (!s.ok()) {
+          found = true;
           return false;
+        }
+        switch (saver.state) {
+          case kNotFound:
+            // Keep searching in other files unless a range deletion here
+            // hides them.
+            return saver.tombstone == 0;
+          case kFound:
+            found = true;
+            return false;
+          case kDeleted:
+            return false;
+          case kCorrupt:
+            s = Status::Corruption("corrupted key for ", saver.user_key);
+            found = true;
+            return false;
+          case kMerge:
+            if (saver.sequence == 0) {
+              return false;  // Nothing can be older
+            }
+            // Look for the entries older than the merge operand.
+            next_ikey = InternalKey(saver.user_key, saver.sequence - 1,
+                                    kValueTypeForSeek);
+            ikey = next_ikey.Encode();
+            break;
+        }
       }
-
-      // Not reached. Added to avoid false compilation warnings of
-      // "control reaches end of non-void function".
-      return false;
     }
   };
 
@@ -387,12 +526,17 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
   state.options = &options;
   state.ikey = k.internal_key();
+  state.snapshot =
+      DecodeFixed64(state.ikey.data() + state.ikey.size() - 8) >> 8;
+  state.version = this;
   state.vset = vset_;
 
   state.saver.state = kNotFound;
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.operands = operands;
+  state.saver.is_blob_index = is_blob_index;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
@@ -401,7 +545,10 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
-  if (f != nullptr) {
+  // Seek compactions would merge a file into part of the next sorted run
+  // of a tiered database; the runs are only ever merged whole.
+  if (f != nullptr &&
+      vset_->options_->compaction_style != kTieredCompaction) {
     f->allowed_seeks--;
     if (f->allowed_seeks <= 0 && file_to_compact_ == nullptr) {
       file_to_compact_ = f;
@@ -470,6 +617,10 @@ bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                         const Slice& largest_user_key) {
   int level = 0;
+  if (vset_->options_->compaction_style == kTieredCompaction) {
+    // Every flush starts a new sorted run.
+    return level;
+  }
   if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
     // Push to next level if there is no overlap in next level,
     // and the #bytes overlapping in the level after that are limited.
@@ -477,6 +628,10 @@ int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
     InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
     std::vector<FileMetaData*> overlaps;
     while (level < config::kMaxMemCompactLevel) {
+      if (level + 1 < base_level_) {
+        // Levels before the base level are not in use.
+        break;
+      }
       if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
         break;
       }
@@ -560,6 +715,24 @@ std::string Version::DebugString() const {
       r.append("]\n");
     }
   }
+  if (!blob_files_.empty()) {
+    // E.g.,
+    //   --- blob files ---
+    //   18:70123 live 40000 of 70000 bytes
+    r.append("--- blob files ---\n");
+    for (const auto& kvp : blob_files_) {
+      const BlobFileMetaData& f = kvp.second;
+      r.push_back(' ');
+      AppendNumberTo(&r, f.number);
+      r.push_back(':');
+      AppendNumberTo(&r, f.file_size);
+      r.append(" live ");
+      AppendNumberTo(&r, f.total_bytes - f.garbage_bytes);
+      r.append(" of ");
+      AppendNumberTo(&r, f.total_bytes);
+      r.append(" bytes\n");
+    }
+  }
   return r;
 }
 
@@ -592,10 +765,12 @@ class VersionSet::Builder {
   VersionSet* vset_;
   Version* base_;
   LevelState levels_[config::kNumLevels];
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
-  Builder(VersionSet* vset, Version* base) : vset_(vset), base_(base) {
+  Builder(VersionSet* vset, Version* base)
+      : vset_(vset), base_(base), blob_files_(base->blob_files_) {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
@@ -666,6 +841,17 @@ class VersionSet::Builder {
       levels_[level].deleted_files.erase(f->number);
       levels_[level].added_files->insert(f);
     }
+
+    // Add new blob files, then account for the values that were dropped
+    for (const BlobFileMetaData& f : edit->new_blob_files_) {
+      blob_files_[f.number] = f;
+    }
+    for (const auto& garbage : edit->blob_garbage_) {
+      auto it = blob_files_.find(garbage.first);
+      if (it != blob_files_.end()) {
+        it->second.garbage_bytes += garbage.second;
+      }
+    }
   }
 
   // Save the current state in *v.
@@ -712,6 +898,14 @@ class VersionSet::Builder {
       }
 #endif
     }
+    v->file_indexer_.Build(&vset_->icmp_, v->files_);
+
+    // Blob files that no table refers to any more are left out
+    for (const auto& kvp : blob_files_) {
+      if (kvp.second.garbage_bytes < kvp.second.total_bytes) {
+        v->blob_files_.insert(kvp);
+      }
+    }
   }
 
   void MaybeAddFile(Version* v, int level, FileMetaData* f) {
@@ -745,6 +939,8 @@ VersionSet::VersionSet(const std::string& dbname, const Options* options,
       prev_log_number_(0),
       descriptor_file_(nullptr),
       descriptor_log_(nullptr),
+      descriptor_size_(0),
+      snapshot_size_(0),
       dummy_versions_(this),
       current_(nullptr) {
   AppendVersion(new Version(this));
@@ -787,7 +983,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
   }
 
   edit->SetNextFile(next_file_number_);
-  edit->SetLastSequence(last_sequence_);
+  edit->SetLastSequence(LastSequence());
 
   Version* v = new Version(this);
   {
@@ -799,18 +995,39 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
 
   // Initialize new descriptor log file if necessary by creating
   // a temporary file that contains a snapshot of the current version.
+  // This also happens once the edits appended to the current descriptor
+  // outweigh its snapshot, so that Recover() only ever has to replay a
+  // bounded number of edits however long the database has been open.
   std::string new_manifest_file;
+  uint64_t new_manifest_number = manifest_file_number_;
+  WritableFile* old_descriptor_file = nullptr;
+  log::Writer* old_descriptor_log = nullptr;
   Status s;
+  if (descriptor_log_ != nullptr &&
+      descriptor_size_ >= TargetFileSize(options_) &&
+      descriptor_size_ >= 2 * snapshot_size_) {
+    new_manifest_number = NewFileNumber();
+    Log(options_->info_log, "Rolling over MANIFEST #%llu (%llu bytes) to #%llu",
+        static_cast<unsigned long long>(manifest_file_number_),
+        static_cast<unsigned long long>(descriptor_size_),
+        static_cast<unsigned long long>(new_manifest_number));
+    old_descriptor_file = descriptor_file_;
+    old_descriptor_log = descriptor_log_;
+    descriptor_file_ = nullptr;
+    descriptor_log_ = nullptr;
+  }
   if (descriptor_log_ == nullptr) {
-    // No reason to unlock *mu here since we only hit this path in the
-    // first call to LogAndApply (when opening the database).
+    // No reason to unlock *mu here since we only hit this path when the
+    // database is opened or when the descriptor rolls over, and the
+    // snapshot is small compared to the edits it replaces.
     assert(descriptor_file_ == nullptr);
-    new_manifest_file = DescriptorFileName(dbname_, manifest_file_number_);
+    new_manifest_file = DescriptorFileName(dbname_, new_manifest_number);
     edit->SetNextFile(next_file_number_);
     s = env_->NewWritableFile(new_manifest_file, &descriptor_file_);
     if (s.ok()) {
       descriptor_log_ = new log::Writer(descriptor_file_);
-      s = WriteSnapshot(descriptor_log_);
+      s = WriteSnapshot(descriptor_log_, &snapshot_size_);
+      descriptor_size_ = snapshot_size_;
     }
   }
 
@@ -829,12 +1046,13 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
       if (!s.ok()) {
         Log(options_->info_log, "MANIFEST write: %s\n", s.ToString().c_str());
       }
+      descriptor_size_ += record.size();
     }
 
     // If we just created a new descriptor file, install it by writing a
     // new CURRENT file that points to it.
     if (s.ok() && !new_manifest_file.empty()) {
-      s = SetCurrentFile(env_, dbname_, manifest_file_number_);
+      s = SetCurrentFile(env_, dbname_, new_manifest_number);
     }
 
     mu->Lock();
@@ -845,6 +1063,9 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
     AppendVersion(v);
     log_number_ = edit->log_number_;
     prev_log_number_ = edit->prev_log_number_;
+    manifest_file_number_ = new_manifest_number;
+    delete old_descriptor_log;
+    delete old_descriptor_file;
   } else {
     delete v;
     if (!new_manifest_file.empty()) {
@@ -853,6 +1074,11 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
       descriptor_log_ = nullptr;
       descriptor_file_ = nullptr;
       env_->RemoveFile(new_manifest_file);
+      if (old_descriptor_log != nullptr) {
+        // CURRENT still names the old descriptor; keep appending to it.
+        descriptor_file_ = old_descriptor_file;
+        descriptor_log_ = old_descriptor_log;
+      }
     }
   }
 
@@ -971,7 +1197,7 @@ Status VersionSet::Recover(bool* save_manifest) {
     AppendVersion(v);
     manifest_file_number_ = next_file;
     next_file_number_ = next_file + 1;
-    last_sequence_ = last_sequence;
+    last_sequence_.store(last_sequence, std::memory_order_release);
     log_number_ = log_number;
     prev_log_number_ = prev_log_number;
 
@@ -1013,6 +1239,8 @@ bool VersionSet::ReuseManifest(const std::string& dscname,
 
   Log(options_->info_log, "Reusing MANIFEST %s\n", dscname.c_str());
   descriptor_log_ = new log::Writer(descriptor_file_, manifest_size);
+  descriptor_size_ = manifest_size;
+  snapshot_size_ = 0;
   manifest_file_number_ = manifest_number;
   return true;
 }
@@ -1024,6 +1252,55 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
 }
 
 void VersionSet::Finalize(Version* v) {
+  if (options_->compaction_style == kTieredCompaction) {
+    // Bound the number of sorted runs, which reads merge together: every
+    // level-0 file and every other non-empty level.
+    int runs = v->files_[0].size();
+    for (int level = 1; level < config::kNumLevels; level++) {
+      if (!v->files_[level].empty()) {
+        runs++;
+      }
+    }
+    v->compaction_level_ = 0;
+    v->compaction_score_ =
+        runs / static_cast<double>(config::kL0_CompactionTrigger);
+    return;
+  }
+
+  // Byte limits of the levels after level-0
+  double max_bytes[config::kNumLevels];
+  for (int level = 1; level < config::kNumLevels; level++) {
+    max_bytes[level] = MaxBytesForLevel(options_, level);
+  }
+  v->base_level_ = 1;
+  if (options_->dynamic_level_bytes) {
+    // Derive the limits backward from the largest level, which is the
+    // last one once data has reached it.  Levels with limits under the
+    // base size are skipped until the database grows into them.
+    const double base_bytes = options_->max_bytes_for_level_base;
+    double limit = base_bytes;
+    int first_level_in_use = config::kNumLevels - 1;
+    for (int level = config::kNumLevels - 1; level >= 1; level--) {
+      if (!v->files_[level].empty()) {
+        first_level_in_use = level;
+        limit = std::max(limit,
+                         static_cast<double>(TotalFileSize(v->files_[level])));
+      }
+    }
+    int base_level = config::kNumLevels - 1;
+    max_bytes[base_level] = limit;
+    for (int level = base_level - 1; level >= 1; level--) {
+      limit /= 10;
+      max_bytes[level] = limit;
+      if (limit >= base_bytes) {
+        base_level = level;
+      }
+    }
+    // Data left in levels before the base level, as after a switch from
+    // static limits, drains into it through their tiny limits.
+    v->base_level_ = std::min(base_level, first_level_in_use);
+  }
+
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
@@ -1047,8 +1324,7 @@ void VersionSet::Finalize(Version* v) {
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      score = static_cast<double>(level_bytes) / max_bytes[level];
     }
 
     if (score > best_score) {
@@ -1059,9 +1335,35 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+  PickColdFile(v);
+}
+
+void VersionSet::PickColdFile(Version* v) {
+  // Look for a file that compactions driven by size and seeks may never
+  // reach, as its key range is cold.
+  const uint64_t now = options_->env->NowMicros() / 1000000;
+  const uint64_t max_age = options_->periodic_compaction_seconds;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : v->files_[level]) {
+      if (f->marked_for_compaction ||
+          (max_age > 0 && f->creation_time > 0 && f->creation_time <= now &&
+           now - f->creation_time >= max_age)) {
+        v->cold_file_to_compact_ = f;
+        v->cold_file_to_compact_level_ = level;
+        return;
+      }
+    }
+  }
+}
+
+void VersionSet::CheckFileAges() {
+  if (options_->compaction_style != kTieredCompaction &&
+      current_->cold_file_to_compact_ == nullptr) {
+    PickColdFile(current_);
+  }
 }
 
-Status VersionSet::WriteSnapshot(log::Writer* log) {
+Status VersionSet::WriteSnapshot(log::Writer* log, uint64_t* size) {
   // TODO: Break up into multiple records to reduce memory usage on recovery?
 
   // Save metadata
@@ -1082,12 +1384,24 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+                   f->has_range_deletions, f->num_entries, f->num_deletions,
+                   f->creation_time, f->marked_for_compaction);
+    }
+  }
+
+  // Save blob files
+  for (const auto& kvp : current_->blob_files_) {
+    const BlobFileMetaData& f = kvp.second;
+    edit.AddBlobFile(f.number, f.file_size, f.total_bytes);
+    if (f.garbage_bytes > 0) {
+      edit.AddBlobGarbage(f.number, f.garbage_bytes);
     }
   }
 
   std::string record;
   edit.EncodeTo(&record);
+  *size = record.size();
   return log->AddRecord(record);
 }
 
@@ -1109,6 +1423,55 @@ const char* VersionSet::LevelSummary(LevelSummaryStorage* scratch) const {
   return scratch->buffer;
 }
 
+void VersionSet::GetSplitPoints(Version* v, const Slice* start,
+                                const Slice* limit, int max_shards,
+                                std::vector<std::string>* split_points) {
+  split_points->clear();
+  const Comparator* ucmp = icmp_.user_comparator();
+
+  // Sizes of the files overlapping the range, by their largest keys
+  std::vector<std::pair<Slice, uint64_t>> files;
+  uint64_t total = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : v->files_[level]) {
+      if ((start != nullptr &&
+           ucmp->Compare(f->largest.user_key(), *start) < 0) ||
+          (limit != nullptr &&
+           ucmp->Compare(f->smallest.user_key(), *limit) >= 0)) {
+        continue;
+      }
+      files.emplace_back(f->largest.user_key(), f->file_size);
+      total += f->file_size;
+    }
+  }
+  std::sort(files.begin(), files.end(),
+            [ucmp](const std::pair<Slice, uint64_t>& a,
+                   const std::pair<Slice, uint64_t>& b) {
+              return ucmp->Compare(a.first, b.first) < 0;
+            });
+
+  // Split after the file that brings the data seen so far to the next
+  // multiple of total / max_shards.
+  uint64_t cumulative = 0;
+  int shard = 1;
+  for (size_t i = 0; i < files.size() && shard < max_shards; i++) {
+    cumulative += files[i].second;
+    if (cumulative < total * shard / max_shards) {
+      continue;
+    }
+    while (shard < max_shards && cumulative >= total * shard / max_shards) {
+      shard++;
+    }
+    const Slice& key = files[i].first;
+    if ((start == nullptr || ucmp->Compare(key, *start) > 0) &&
+        (limit == nullptr || ucmp->Compare(key, *limit) < 0) &&
+        (split_points->empty() ||
+         ucmp->Compare(key, split_points->back()) > 0)) {
+      split_points->push_back(key.ToString());
+    }
+  }
+}
+
 uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
   uint64_t result = 0;
   for (int level = 0; level < config::kNumLevels; level++) {
@@ -1150,6 +1513,33 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
         live->insert(files[i]->number);
       }
     }
+    for (const auto& kvp : v->blob_files_) {
+      live->insert(kvp.first);
+    }
+  }
+}
+
+void VersionSet::GetBlobFilesToCollect(double live_ratio,
+                                       std::set<uint64_t>* files) const {
+  for (const auto& kvp : current_->blob_files_) {
+    const BlobFileMetaData& f = kvp.second;
+    if (f.total_bytes - f.garbage_bytes < live_ratio * f.total_bytes) {
+      files->insert(f.number);
+    }
+  }
+}
+
+void VersionSet::GetCurrentFiles(std::vector<FileMetaData>* files) const {
+  files->clear();
+  for (int level = 0; level < config::kNumLevels; level++) {
+    const size_t level_start = files->size();
+    for (const FileMetaData* f : current_->files_[level]) {
+      files->push_back(*f);
+    }
+    std::sort(files->begin() + level_start, files->end(),
+              [](const FileMetaData& a, const FileMetaData& b) {
+                return a.number > b.number;
+              });
   }
 }
 
@@ -1219,10 +1609,11 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   // Level-0 files have to be merged together.  For other levels,
   // we will make a concatenating iterator per level.
   // TODO(opt): use concatenating iterator for level-0 if there is no overlap
-  const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+  const int space = (c->level() == 0 ? c->inputs_[0].size() : 0) +
+                    c->num_input_levels();
   Iterator** list = new Iterator*[space];
   int num = 0;
-  for (int which = 0; which < 2; which++) {
+  for (int which = 0; which < c->num_input_levels(); which++) {
     if (!c->inputs_[which].empty()) {
       if (c->level() + which == 0) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
@@ -1234,7 +1625,7 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
         // Create concatenating iterator for the files from this level
         list[num++] = NewTwoLevelIterator(
             new Version::LevelFileNumIterator(icmp_, &c->inputs_[which]),
-            &GetFileIterator, table_cache_, options);
+            &GetFileIterator, table_cache_, options, &icmp_);
       }
     }
   }
@@ -1245,6 +1636,10 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 }
 
 Compaction* VersionSet::PickCompaction() {
+  if (options_->compaction_style == kTieredCompaction) {
+    return PickTieredCompaction();
+  }
+
   Compaction* c;
   int level;
 
@@ -1252,14 +1647,32 @@ Compaction* VersionSet::PickCompaction() {
   // the compactions triggered by seeks.
   const bool size_compaction = (current_->compaction_score_ >= 1);
   const bool seek_compaction = (current_->file_to_compact_ != nullptr);
+  const bool cold_compaction = (current_->cold_file_to_compact_ != nullptr);
   if (size_compaction) {
     level = current_->compaction_level_;
+    if (level == 0) {
+      c = PickIntraL0Compaction();
+      if (c != nullptr) {
+        return c;
+      }
+    }
     assert(level >= 0);
     assert(level + 1 < config::kNumLevels);
-    c = new Compaction(options_, level);
+    c = new Compaction(options_, level,
+                       level == 0 ? current_->base_level_ : level + 1);
+
+    if (level > 0) {
+      FileMetaData* f = PickFileToCompact(
+          icmp_, options_->compaction_pick_policy, current_->files_[level],
+          current_->files_[level + 1]);
+      if (f != nullptr) {
+        c->inputs_[0].push_back(f);
+      }
+    }
 
     // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
+    for (size_t i = 0;
+         c->inputs_[0].empty() && i < current_->files_[level].size(); i++) {
       FileMetaData* f = current_->files_[level][i];
       if (compact_pointer_[level].empty() ||
           icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
@@ -1273,8 +1686,19 @@ Compaction* VersionSet::PickCompaction() {
     }
   } else if (seek_compaction) {
     level = current_->file_to_compact_level_;
-    c = new Compaction(options_, level);
+    c = new Compaction(options_, level,
+                       level == 0 ? current_->base_level_ : level + 1);
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (cold_compaction) {
+    level = current_->cold_file_to_compact_level_;
+    if (level == config::kNumLevels - 1) {
+      // There is no level to push the file into, so rewrite it in place.
+      c = new Compaction(options_, level, level);
+    } else {
+      c = new Compaction(options_, level,
+                         level == 0 ? current_->base_level_ : level + 1);
+    }
+    c->inputs_[0].push_back(current_->cold_file_to_compact_);
   } else {
     return nullptr;
   }
@@ -1293,8 +1717,209 @@ Compaction* VersionSet::PickCompaction() {
     assert(!c->inputs_[0].empty());
   }
 
-  SetupOtherInputs(c);
+  if (c->output_level() == level) {
+    AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
+  } else {
+    SetupOtherInputs(c);
+  }
+
+  return c;
+}
+
+FileMetaData* PickFileToCompact(const InternalKeyComparator& icmp,
+                                CompactionPickPolicy policy,
+                                const std::vector<FileMetaData*>& level_files,
+                                const std::vector<FileMetaData*>& next_files) {
+  const Comparator* ucmp = icmp.user_comparator();
+  FileMetaData* best = nullptr;
+  double best_score = 0;
+  switch (policy) {
+    case kPickRoundRobin:
+      break;
+
+    case kPickMinOverlap: {
+      // Both levels are sorted, so the files of the next level that
+      // overlap each file follow those that overlap the file before it.
+      size_t first = 0;
+      for (FileMetaData* f : level_files) {
+        while (first < next_files.size() &&
+               ucmp->Compare(next_files[first]->largest.user_key(),
+                             f->smallest.user_key()) < 0) {
+          first++;
+        }
+        uint64_t overlap = 0;
+        for (size_t i = first;
+             i < next_files.size() &&
+             ucmp->Compare(next_files[i]->smallest.user_key(),
+                           f->largest.user_key()) <= 0;
+             i++) {
+          overlap += next_files[i]->file_size;
+        }
+        const double score =
+            static_cast<double>(overlap) / std::max<uint64_t>(f->file_size, 1);
+        if (best == nullptr || score < best_score) {
+          best = f;
+          best_score = score;
+        }
+      }
+      break;
+    }
+
+    case kPickMostDeletions:
+      for (FileMetaData* f : level_files) {
+        if (f->num_deletions > 0) {
+          const double score =
+              static_cast<double>(f->num_deletions) / f->num_entries;
+          if (score > best_score) {
+            best = f;
+            best_score = score;
+          }
+        }
+      }
+      break;
+  }
+  return best;
+}
+
+Compaction* VersionSet::PickTieredCompaction() {
+  // A sorted run is a level-0 file or a whole non-empty level.
+  struct SortedRun {
+    int level;
+    FileMetaData* file;  // The file of a level-0 run, else nullptr
+    uint64_t size;
+  };
+
+  // List the runs from newest to oldest.
+  std::vector<SortedRun> runs;
+  std::vector<FileMetaData*> level0 = current_->files_[0];
+  std::sort(level0.begin(), level0.end(), NewestFirst);
+  for (FileMetaData* f : level0) {
+    runs.push_back(SortedRun{0, f, f->file_size});
+  }
+  const size_t num_level0 = runs.size();
+  for (int level = 1; level < config::kNumLevels; level++) {
+    const std::vector<FileMetaData*>& files = current_->files_[level];
+    if (!files.empty()) {
+      runs.push_back(SortedRun{level, nullptr,
+                               static_cast<uint64_t>(TotalFileSize(files))});
+    }
+  }
+  if (runs.size() < static_cast<size_t>(config::kL0_CompactionTrigger)) {
+    return nullptr;
+  }
+
+  // Merge the runs [start, end).
+  size_t start = 0;
+  size_t end = 0;
+  const char* reason;
+  uint64_t newer_bytes = 0;
+  for (size_t i = 0; i + 1 < runs.size(); i++) {
+    newer_bytes += runs[i].size;
+  }
+  if (newer_bytes * 100 >
+      static_cast<uint64_t>(options_->tiered_max_size_amplification_percent) *
+          runs.back().size) {
+    // The newer runs may shadow much of the oldest one; merge everything
+    // to reclaim the space.
+    end = runs.size();
+    reason = "size amplification";
+  } else {
+    // Merge the newest span of at least two runs in which each run is
+    // not much larger than the newer runs of the span together.
+    for (start = 0; start + 1 < runs.size(); start++) {
+      uint64_t span_bytes = runs[start].size;
+      end = start + 1;
+      while (end < runs.size() &&
+             runs[end].size * 100 <=
+                 span_bytes * (100 + options_->tiered_size_ratio)) {
+        span_bytes += runs[end].size;
+        end++;
+      }
+      if (end - start >= 2) {
+        break;
+      }
+    }
+    reason = "size ratio";
+    if (end - start < 2) {
+      // No runs are alike; merge enough of the newest runs to bring the
+      // number of runs back under the trigger.
+      start = 0;
+      end = runs.size() - config::kL0_CompactionTrigger + 2;
+      reason = "sorted run count";
+    }
+  }
+
+  // The output goes below level-0, so it must take the level-0 files
+  // older than the ones it takes too.
+  if (start < num_level0 && end < num_level0) {
+    end = num_level0;
+  }
+  int output_level;
+  if (end > num_level0) {
+    output_level = runs[end - 1].level;
+  } else if (end < runs.size()) {
+    // Write above the newest run not taken, unless that run is level-1.
+    output_level = runs[end].level - 1;
+    if (output_level == 0) {
+      output_level = 1;
+      end++;
+    }
+  } else {
+    output_level = config::kNumLevels - 1;
+  }
+  const int level = runs[start].level;
+
+  Compaction* c = new Compaction(options_, level, output_level);
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  for (size_t i = start; i < end; i++) {
+    const SortedRun& run = runs[i];
+    if (run.file != nullptr) {
+      c->inputs_[0].push_back(run.file);
+    } else {
+      c->inputs_[run.level - level] = current_->files_[run.level];
+    }
+  }
+  Log(options_->info_log,
+      "Tiered compaction of %d of %d sorted runs to level-%d (%s)\n",
+      static_cast<int>(end - start), static_cast<int>(runs.size()),
+      output_level, reason);
+  return c;
+}
+
+Compaction* VersionSet::PickIntraL0Compaction() {
+  // Level-0 only piles up this far when memtables were flushed while a
+  // long compaction ran.  Moving the files down would now mean merging
+  // all of them with the overlapping files of the base level while
+  // writes are slowed down, so first merge the newest ones, which are
+  // small, into a single level-0 file.
+  std::vector<FileMetaData*> level0 = current_->files_[0];
+  if (level0.size() < static_cast<size_t>(config::kL0_SlowdownWritesTrigger)) {
+    return nullptr;
+  }
+  std::sort(level0.begin(), level0.end(), NewestFirst);
+  size_t n = 0;
+  int64_t bytes = 0;
+  while (n < level0.size() &&
+         bytes + static_cast<int64_t>(level0[n]->file_size) <=
+             ExpandedCompactionByteSizeLimit(options_)) {
+    bytes += level0[n]->file_size;
+    n++;
+  }
+  if (n < static_cast<size_t>(config::kL0_CompactionTrigger)) {
+    return nullptr;
+  }
 
+  // The output must come out as a single file: the files are ordered by
+  // number, so the output takes the place of the files it replaces among
+  // the older and newer ones.
+  Compaction* c = new Compaction(options_, 0, 0);
+  c->max_output_file_size_ = std::numeric_limits<uint64_t>::max();
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  c->inputs_[0].assign(level0.begin(), level0.begin() + n);
+  Log(options_->info_log, "Intra-level-0 compaction of %d of %d files\n",
+      static_cast<int>(n), static_cast<int>(level0.size()));
   return c;
 }
 
@@ -1364,6 +1989,13 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
 
   bool continue_searching = true;
   while (continue_searching) {
+    // A largest key with kMaxSequenceNumber is the end of a range deletion
+    // (see RangeTombstone::EndKey), which covers no entry for its user key.
+    ParsedInternalKey parsed;
+    if (ParseInternalKey(largest_key.Encode(), &parsed) &&
+        parsed.sequence == kMaxSequenceNumber) {
+      break;
+    }
     FileMetaData* smallest_boundary_file =
         FindSmallestBoundaryFile(icmp, level_files, largest_key);
 
@@ -1379,26 +2011,27 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
 
 void VersionSet::SetupOtherInputs(Compaction* c) {
   const int level = c->level();
+  const int output_level = c->output_level();
+  std::vector<FileMetaData*>* outputs = &c->inputs_[output_level - level];
   InternalKey smallest, largest;
 
   AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
   GetRange(c->inputs_[0], &smallest, &largest);
 
-  current_->GetOverlappingInputs(level + 1, &smallest, &largest,
-                                 &c->inputs_[1]);
+  current_->GetOverlappingInputs(output_level, &smallest, &largest, outputs);
 
   // Get entire range covered by compaction
   InternalKey all_start, all_limit;
-  GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
+  GetRange2(c->inputs_[0], *outputs, &all_start, &all_limit);
 
   // See if we can grow the number of inputs in "level" without
-  // changing the number of "level+1" files we pick up.
-  if (!c->inputs_[1].empty()) {
+  // changing the number of "output_level" files we pick up.
+  if (!outputs->empty()) {
     std::vector<FileMetaData*> expanded0;
     current_->GetOverlappingInputs(level, &all_start, &all_limit, &expanded0);
     AddBoundaryInputs(icmp_, current_->files_[level], &expanded0);
     const int64_t inputs0_size = TotalFileSize(c->inputs_[0]);
-    const int64_t inputs1_size = TotalFileSize(c->inputs_[1]);
+    const int64_t inputs1_size = TotalFileSize(*outputs);
     const int64_t expanded0_size = TotalFileSize(expanded0);
     if (expanded0.size() > c->inputs_[0].size() &&
         inputs1_size + expanded0_size <
@@ -1406,27 +2039,27 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
       InternalKey new_start, new_limit;
       GetRange(expanded0, &new_start, &new_limit);
       std::vector<FileMetaData*> expanded1;
-      current_->GetOverlappingInputs(level + 1, &new_start, &new_limit,
+      current_->GetOverlappingInputs(output_level, &new_start, &new_limit,
                                      &expanded1);
-      if (expanded1.size() == c->inputs_[1].size()) {
+      if (expanded1.size() == outputs->size()) {
         Log(options_->info_log,
             "Expanding@%d %d+%d (%ld+%ld bytes) to %d+%d (%ld+%ld bytes)\n",
-            level, int(c->inputs_[0].size()), int(c->inputs_[1].size()),
+            level, int(c->inputs_[0].size()), int(outputs->size()),
             long(inputs0_size), long(inputs1_size), int(expanded0.size()),
             int(expanded1.size()), long(expanded0_size), long(inputs1_size));
         smallest = new_start;
         largest = new_limit;
         c->inputs_[0] = expanded0;
-        c->inputs_[1] = expanded1;
-        GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
+        *outputs = expanded1;
+        GetRange2(c->inputs_[0], *outputs, &all_start, &all_limit);
       }
     }
   }
 
   // Compute the set of grandparent files that overlap this compaction
-  // (parent == level+1; grandparent == level+2)
-  if (level + 2 < config::kNumLevels) {
-    current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
+  // (parent == output_level; grandparent == output_level+1)
+  if (output_level + 1 < config::kNumLevels) {
+    current_->GetOverlappingInputs(output_level + 1, &all_start, &all_limit,
                                    &c->grandparents_);
   }
 
@@ -1463,7 +2096,7 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
     }
   }
 
-  Compaction* c = new Compaction(options_, level);
+  Compaction* c = new Compaction(options_, level, level + 1);
   c->input_version_ = current_;
   c->input_version_->Ref();
   c->inputs_[0] = inputs;
@@ -1471,8 +2104,9 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   return c;
 }
 
-Compaction::Compaction(const Options* options, int level)
+Compaction::Compaction(const Options* options, int level, int output_level)
     : level_(level),
+      output_level_(output_level),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
       input_version_(nullptr),
       grandparent_index_(0),
@@ -1491,26 +2125,57 @@ Compaction::~Compaction() {
 
 bool Compaction::IsTrivialMove() const {
   const VersionSet* vset = input_version_->vset_;
+  if (num_input_files(0) != 1 || output_level_ == level_) {
+    return false;
+  }
+  for (int which = 1; which < num_input_levels(); which++) {
+    if (num_input_files(which) != 0) {
+      return false;
+    }
+  }
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
-  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
-          TotalFileSize(grandparents_) <=
-              MaxGrandParentOverlapBytes(vset->options_));
+  return TotalFileSize(grandparents_) <=
+         MaxGrandParentOverlapBytes(vset->options_);
 }
 
 void Compaction::AddInputDeletions(VersionEdit* edit) {
-  for (int which = 0; which < 2; which++) {
+  for (int which = 0; which < num_input_levels(); which++) {
     for (size_t i = 0; i < inputs_[which].size(); i++) {
       edit->RemoveFile(level_ + which, inputs_[which][i]->number);
     }
   }
+  for (size_t i = 0; i < skipped_inputs_.size(); i++) {
+    edit->RemoveFile(output_level_, skipped_inputs_[i]->number);
+  }
+}
+
+void Compaction::SkipInput(int i) {
+  std::vector<FileMetaData*>* files = &inputs_[output_level_ - level_];
+  skipped_inputs_.push_back((*files)[i]);
+  files->erase(files->begin() + i);
+}
+
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+  if (output_level_ == 0) {
+    return false;  // Older level-0 files are not among the inputs
+  }
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
+    if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+      return false;
+    }
+  }
+  return true;
 }
 
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+  if (output_level_ == 0) {
+    return false;  // Older level-0 files are not among the inputs
+  }
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  for (int lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
     while (level_ptrs_[lvl] < files.size()) {
       FileMetaData* f = files[level_ptrs_[lvl]];
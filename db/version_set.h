@@ -15,12 +15,15 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_SET_H_
 #define STORAGE_LEVELDB_DB_VERSION_SET_H_
 
+#include <atomic>
 #include <map>
 #include <set>
 #include <vector>
 
 #include "db/dbformat.h"
+#include "db/file_indexer.h"
 #include "db/version_edit.h"
+#include "leveldb/options.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 
@@ -33,6 +36,7 @@ class Writer;
 class Compaction;
 class Iterator;
 class MemTable;
+class RangeDelAggregator;
 class TableBuilder;
 class TableCache;
 class Version;
@@ -57,6 +61,22 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
                            const Slice* smallest_user_key,
                            const Slice* largest_user_key);
 
+// Return the file of "level_files" that "policy" picks to compact into the
+// next level, whose files are "next_files", or nullptr if the policy has no
+// preference.
+// REQUIRES: both contain sorted lists of non-overlapping files.
+FileMetaData* PickFileToCompact(const InternalKeyComparator& icmp,
+                                CompactionPickPolicy policy,
+                                const std::vector<FileMetaData*>& level_files,
+                                const std::vector<FileMetaData*>& next_files);
+
+// Extend "compaction_files" with the files of "level_files" that hold
+// older entries for the largest user key among them, so that compacting
+// them does not leave those entries behind.
+void AddBoundaryInputs(const InternalKeyComparator& icmp,
+                       const std::vector<FileMetaData*>& level_files,
+                       std::vector<FileMetaData*>* compaction_files);
+
 class Version {
  public:
   // Lookup the value for key.  If found, store it in *val and
@@ -68,12 +88,23 @@ class Version {
   };
 
   // Append to *iters a sequence of iterators that will
-  // yield the contents of this Version when merged together.
+  // yield the contents of this Version when merged together.  Files that
+  // lie outside the iterate bounds of the options, which are internal
+  // keys (see InternalIterateBounds), are left out.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
   void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
+  // Add to *range_del the range deletions of the files that lie inside the
+  // iterate bounds of the options, as for AddIterators.
+  Status AddRangeDeletions(const ReadOptions&, RangeDelAggregator* range_del);
+
+  // Merge operands found on the way to the value are appended to
+  // *operands, newest first, and left for the caller to apply.  If the
+  // value is kept in a blob file, *is_blob_index is set to true and *val
+  // holds its blob index, likewise left for the caller to resolve.
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+             GetStats* stats, std::vector<std::string>* operands,
+             bool* is_blob_index);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -111,6 +142,8 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  int NumBlobFiles() const { return blob_files_.size(); }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -127,15 +160,21 @@ class Version {
         refs_(0),
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
+        cold_file_to_compact_(nullptr),
+        cold_file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        base_level_(1) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
 
   ~Version();
 
-  Iterator* NewConcatenatingIterator(const ReadOptions&, int level) const;
+  // Return an iterator over the files of "level" with indexes in
+  // [begin, end).
+  Iterator* NewConcatenatingIterator(const ReadOptions&, int level,
+                                     uint32_t begin, uint32_t end) const;
 
   // Call func(arg, level, f) for every file that overlaps user_key in
   // order from newest to oldest.  If an invocation of func returns
@@ -153,15 +192,31 @@ class Version {
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
 
+  // Blob files holding values referenced by the tables, by file number
+  std::map<uint64_t, BlobFileMetaData> blob_files_;
+
+  // Search hints for ForEachOverlapping(), built from files_.
+  FileIndexer file_indexer_;
+
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
+  // Next file to compact because it was marked for compaction or written
+  // too long ago (see Options::periodic_compaction_seconds).  Initialized
+  // by Finalize().
+  FileMetaData* cold_file_to_compact_;
+  int cold_file_to_compact_level_;
+
   // Level that should be compacted next and its compaction score.
   // Score < 1 means compaction is not strictly needed.  These fields
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Level into which level-0 compacts; the levels between are not in use
+  // (see Options::dynamic_level_bytes).  Initialized by Finalize().
+  int base_level_;
 };
 
 class VersionSet {
@@ -209,12 +264,15 @@ class VersionSet {
   int64_t NumLevelBytes(int level) const;
 
   // Return the last sequence number.
-  uint64_t LastSequence() const { return last_sequence_; }
+  // May be called without holding the lock.
+  uint64_t LastSequence() const {
+    return last_sequence_.load(std::memory_order_acquire);
+  }
 
   // Set the last sequence number to s.
   void SetLastSequence(uint64_t s) {
-    assert(s >= last_sequence_);
-    last_sequence_ = s;
+    assert(s >= LastSequence());
+    last_sequence_.store(s, std::memory_order_release);
   }
 
   // Mark the specified file number as used.
@@ -251,13 +309,36 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr) ||
+           (v->cold_file_to_compact_ != nullptr);
   }
 
+  // Look again for a table of the current version that was written more
+  // than Options::periodic_compaction_seconds ago.
+  // REQUIRES: mutex is held.
+  void CheckFileAges();
+
   // Add all files listed in any live version to *live.
   // May also mutate some internal state.
   void AddLiveFiles(std::set<uint64_t>* live);
 
+  // Store in *files the blob files of the current version of which less
+  // than "live_ratio" of the value bytes are still referenced.
+  void GetBlobFilesToCollect(double live_ratio,
+                             std::set<uint64_t>* files) const;
+
+  // Store the files of the current version in *files, ordered by level
+  // and, within a level, newest first.
+  void GetCurrentFiles(std::vector<FileMetaData>* files) const;
+
+  // Store in *split_points up to max_shards - 1 user keys, in increasing
+  // order, that split the user key range [*start, *limit) of "v" into
+  // pieces holding similar amounts of table data.  The split points are
+  // chosen among the largest keys of the files.  A null start or limit
+  // leaves that end of the range open.
+  void GetSplitPoints(Version* v, const Slice* start, const Slice* limit,
+                      int max_shards, std::vector<std::string>* split_points);
+
   // Return the approximate offset in the database of the data for
   // "key" as of version "v".
   uint64_t ApproximateOffsetOf(Version* v, const InternalKey& key);
@@ -279,6 +360,10 @@ class VersionSet {
 
   void Finalize(Version* v);
 
+  // Set v->cold_file_to_compact_ to a table to compact regardless of the
+  // size of its level, if there is one.
+  void PickColdFile(Version* v);
+
   void GetRange(const std::vector<FileMetaData*>& inputs, InternalKey* smallest,
                 InternalKey* largest);
 
@@ -288,8 +373,18 @@ class VersionSet {
 
   void SetupOtherInputs(Compaction* c);
 
-  // Save current contents to *log
-  Status WriteSnapshot(log::Writer* log);
+  // Pick the sorted runs to merge next in a tiered database.  Returns
+  // nullptr if there are too few runs to need a compaction.
+  Compaction* PickTieredCompaction();
+
+  // Pick the newest level-0 files to merge into one level-0 file when
+  // level-0 holds so many files that writes are slowed down.  Returns
+  // nullptr if no such compaction is needed.
+  Compaction* PickIntraL0Compaction();
+
+  // Save current contents to *log and store the encoded size of the
+  // snapshot in *size.
+  Status WriteSnapshot(log::Writer* log, uint64_t* size);
 
   void AppendVersion(Version* v);
 
@@ -300,13 +395,15 @@ class VersionSet {
   const InternalKeyComparator icmp_;
   uint64_t next_file_number_;
   uint64_t manifest_file_number_;
-  uint64_t last_sequence_;
+  std::atomic<uint64_t> last_sequence_;
   uint64_t log_number_;
   uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
 
   // Opened lazily
   WritableFile* descriptor_file_;
   log::Writer* descriptor_log_;
+  uint64_t descriptor_size_;  // Approximate size of descriptor_file_
+  uint64_t snapshot_size_;    // Size of the snapshot at its start
   Version dummy_versions_;  // Head of circular doubly-linked list of versions.
   Version* current_;        // == dummy_versions_.prev_
 
@@ -321,17 +418,27 @@ class Compaction {
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
-  // and "level+1" will be merged to produce a set of "level+1" files.
+  // through "output_level" will be merged to produce a set of
+  // "output_level" files.
   int level() const { return level_; }
 
+  // Return the level the compaction writes to.  This is "level+1" except
+  // for tiered compactions (see Options::compaction_style), which also
+  // take whole levels between "level" and the level they write to.
+  int output_level() const { return output_level_; }
+
+  // Return the number of levels the inputs are taken from.
+  int num_input_levels() const { return output_level_ - level_ + 1; }
+
   // Return the object that holds the edits to the descriptor done
   // by this compaction.
   VersionEdit* edit() { return &edit_; }
 
-  // "which" must be either 0 or 1
+  // "which" must be less than num_input_levels()
   int num_input_files(int which) const { return inputs_[which].size(); }
 
-  // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+  // Return the ith input file at "level()+which" ("which" must be less
+  // than num_input_levels()).
   FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
 
   // Maximum size of files to build during this compaction.
@@ -345,10 +452,20 @@ class Compaction {
   void AddInputDeletions(VersionEdit* edit);
 
   // Returns true if the information we have available guarantees that
-  // the compaction is producing data in "level+1" for which no data exists
-  // in levels greater than "level+1".
+  // the compaction is producing data in "output_level" for which no data
+  // exists in levels greater than "output_level".
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Returns true if no data exists in levels greater than "output_level"
+  // for the user keys in [begin,end].  Unlike IsBaseLevelForKey(), may be
+  // called with ranges in any order.
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
+  // Leave the ith input file at "output_level" out of the inputs read by
+  // the compaction, which still deletes the file.  Used for files whose
+  // entries are all hidden by a range deletion among the newer inputs.
+  void SkipInput(int i);
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
@@ -361,18 +478,21 @@ class Compaction {
   friend class Version;
   friend class VersionSet;
 
-  Compaction(const Options* options, int level);
+  Compaction(const Options* options, int level, int output_level);
 
   int level_;
+  int output_level_;
   uint64_t max_output_file_size_;
   Version* input_version_;
   VersionEdit edit_;
 
-  // Each compaction reads inputs from "level_" and "level_+1"
-  std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
+  // Each compaction reads inputs from "level_" through "output_level_";
+  // inputs_[which] holds those of level "level_+which"
+  std::vector<FileMetaData*> inputs_[config::kNumLevels];
+  std::vector<FileMetaData*> skipped_inputs_;  // See SkipInput()
 
   // State used to check for number of overlapping grandparent files
-  // (parent == level_ + 1, grandparent == level_ + 2)
+  // (parent == output_level_, grandparent == output_level_ + 1)
   std::vector<FileMetaData*> grandparents_;
   size_t grandparent_index_;  // Index in grandparent_starts_
   bool seen_key_;             // Some output key has been seen
@@ -384,7 +504,7 @@ class Compaction {
   // level_ptrs_ holds indices into input_version_->levels_: our state
   // is that we are positioned at one of the file ranges for each
   // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
+  // all L > output_level_).
   size_t level_ptrs_[config::kNumLevels];
 };
 
@@ -328,6 +328,73 @@ TEST_F(AddBoundaryInputsTest, TestDisjoinFilePointers) {
   ASSERT_EQ(f3, compaction_files_[2]);
 }
 
+class PickFileToCompactTest : public testing::Test {
+ public:
+  std::vector<FileMetaData*> level_files_;
+  std::vector<FileMetaData*> next_files_;
+  InternalKeyComparator icmp_;
+
+  PickFileToCompactTest() : icmp_(BytewiseComparator()) {}
+
+  ~PickFileToCompactTest() {
+    for (FileMetaData* f : level_files_) {
+      delete f;
+    }
+    for (FileMetaData* f : next_files_) {
+      delete f;
+    }
+  }
+
+  FileMetaData* Add(std::vector<FileMetaData*>* files, const char* smallest,
+                    const char* largest, uint64_t file_size,
+                    uint64_t num_entries = 0, uint64_t num_deletions = 0) {
+    FileMetaData* f = new FileMetaData();
+    f->number = level_files_.size() + next_files_.size() + 1;
+    f->file_size = file_size;
+    f->smallest = InternalKey(smallest, 100, kTypeValue);
+    f->largest = InternalKey(largest, 100, kTypeValue);
+    f->num_entries = num_entries;
+    f->num_deletions = num_deletions;
+    files->push_back(f);
+    return f;
+  }
+
+  FileMetaData* Pick(CompactionPickPolicy policy) {
+    return PickFileToCompact(icmp_, policy, level_files_, next_files_);
+  }
+};
+
+TEST_F(PickFileToCompactTest, RoundRobin) {
+  Add(&level_files_, "a", "b", 100);
+  ASSERT_EQ(nullptr, Pick(kPickRoundRobin));
+}
+
+TEST_F(PickFileToCompactTest, MinOverlap) {
+  FileMetaData* f1 = Add(&level_files_, "a", "c", 100);
+  FileMetaData* f2 = Add(&level_files_, "d", "f", 100);
+  FileMetaData* f3 = Add(&level_files_, "g", "i", 10);
+  Add(&next_files_, "a", "a", 100);
+  Add(&next_files_, "b", "d", 100);  // Overlaps both f1 and f2
+  Add(&next_files_, "h", "z", 100);
+  ASSERT_EQ(f2, Pick(kPickMinOverlap));
+
+  // Overlap is weighed against the size of the file.
+  f3->file_size = 1000;
+  ASSERT_EQ(f3, Pick(kPickMinOverlap));
+  f1->file_size = 10000;
+  ASSERT_EQ(f1, Pick(kPickMinOverlap));
+}
+
+TEST_F(PickFileToCompactTest, MostDeletions) {
+  Add(&level_files_, "a", "b", 100, 10, 0);
+  ASSERT_EQ(nullptr, Pick(kPickMostDeletions));
+
+  Add(&level_files_, "c", "d", 100, 10, 2);
+  FileMetaData* f3 = Add(&level_files_, "e", "f", 100, 4, 3);
+  Add(&level_files_, "g", "h", 100);  // Without counts
+  ASSERT_EQ(f3, Pick(kPickMostDeletions));
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
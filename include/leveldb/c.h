@@ -60,6 +60,7 @@ typedef struct leveldb_filelock_t leveldb_filelock_t;
 typedef struct leveldb_filterpolicy_t leveldb_filterpolicy_t;
 typedef struct leveldb_iterator_t leveldb_iterator_t;
 typedef struct leveldb_logger_t leveldb_logger_t;
+typedef struct leveldb_mergeoperator_t leveldb_mergeoperator_t;
 typedef struct leveldb_options_t leveldb_options_t;
 typedef struct leveldb_randomfile_t leveldb_randomfile_t;
 typedef struct leveldb_readoptions_t leveldb_readoptions_t;
@@ -86,6 +87,18 @@ LEVELDB_EXPORT void leveldb_delete(leveldb_t* db,
                                    const char* key, size_t keylen,
                                    char** errptr);
 
+LEVELDB_EXPORT void leveldb_delete_range(leveldb_t* db,
+                                         const leveldb_writeoptions_t* options,
+                                         const char* begin_key, size_t blen,
+                                         const char* end_key, size_t elen,
+                                         char** errptr);
+
+LEVELDB_EXPORT void leveldb_merge(leveldb_t* db,
+                                  const leveldb_writeoptions_t* options,
+                                  const char* key, size_t keylen,
+                                  const char* val, size_t vallen,
+                                  char** errptr);
+
 LEVELDB_EXPORT void leveldb_write(leveldb_t* db,
                                   const leveldb_writeoptions_t* options,
                                   leveldb_writebatch_t* batch, char** errptr);
@@ -155,6 +168,14 @@ LEVELDB_EXPORT void leveldb_writebatch_put(leveldb_writebatch_t*,
                                            const char* val, size_t vlen);
 LEVELDB_EXPORT void leveldb_writebatch_delete(leveldb_writebatch_t*,
                                               const char* key, size_t klen);
+LEVELDB_EXPORT void leveldb_writebatch_delete_range(leveldb_writebatch_t*,
+                                                    const char* begin_key,
+                                                    size_t blen,
+                                                    const char* end_key,
+                                                    size_t elen);
+LEVELDB_EXPORT void leveldb_writebatch_merge(leveldb_writebatch_t*,
+                                             const char* key, size_t klen,
+                                             const char* val, size_t vlen);
 LEVELDB_EXPORT void leveldb_writebatch_iterate(
     const leveldb_writebatch_t*, void* state,
     void (*put)(void*, const char* k, size_t klen, const char* v, size_t vlen),
@@ -170,6 +191,8 @@ LEVELDB_EXPORT void leveldb_options_set_comparator(leveldb_options_t*,
                                                    leveldb_comparator_t*);
 LEVELDB_EXPORT void leveldb_options_set_filter_policy(leveldb_options_t*,
                                                       leveldb_filterpolicy_t*);
+LEVELDB_EXPORT void leveldb_options_set_merge_operator(
+    leveldb_options_t*, leveldb_mergeoperator_t*);
 LEVELDB_EXPORT void leveldb_options_set_create_if_missing(leveldb_options_t*,
                                                           uint8_t);
 LEVELDB_EXPORT void leveldb_options_set_error_if_exists(leveldb_options_t*,
@@ -202,6 +225,27 @@ LEVELDB_EXPORT leveldb_comparator_t* leveldb_comparator_create(
     const char* (*name)(void*));
 LEVELDB_EXPORT void leveldb_comparator_destroy(leveldb_comparator_t*);
 
+/* Merge operator */
+
+/* full_merge and partial_merge return a malloc()ed result and store its
+   length in *new_value_length, or set *success to 0 if they fail.
+   existing_value is NULL if the key has no value.  partial_merge may be
+   NULL if operands cannot be combined. */
+LEVELDB_EXPORT leveldb_mergeoperator_t* leveldb_mergeoperator_create(
+    void* state, void (*destructor)(void*),
+    char* (*full_merge)(void*, const char* key, size_t key_length,
+                        const char* existing_value,
+                        size_t existing_value_length,
+                        const char* const* operands_list,
+                        const size_t* operands_list_length, int num_operands,
+                        uint8_t* success, size_t* new_value_length),
+    char* (*partial_merge)(void*, const char* key, size_t key_length,
+                           const char* left, size_t left_length,
+                           const char* right, size_t right_length,
+                           uint8_t* success, size_t* new_value_length),
+    const char* (*name)(void*));
+LEVELDB_EXPORT void leveldb_mergeoperator_destroy(leveldb_mergeoperator_t*);
+
 /* Filter policy */
 
 LEVELDB_EXPORT leveldb_filterpolicy_t* leveldb_filterpolicy_create(
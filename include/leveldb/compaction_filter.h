@@ -0,0 +1,64 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a CompactionFilter that sees the
+// values rewritten by compactions and may drop or change them.  Dropping
+// expired or unwanted data this way costs nothing beyond the compactions
+// that run anyway, unlike scanning for it and deleting it.
+//
+// Filters only see values that no snapshot could read an older version
+// of, and are not applied when memtables are written to level-0.  A value
+// dropped by a filter can still be read until a compaction reaches it.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Env;
+class Slice;
+
+// A CompactionFilter must be thread-safe since leveldb may invoke its
+// methods concurrently from multiple threads.
+class LEVELDB_EXPORT CompactionFilter {
+ public:
+  virtual ~CompactionFilter();
+
+  // The name of the filter.  Used for logging.
+  virtual const char* Name() const = 0;
+
+  // Called for the value of "key" being compacted out of "level".  Return
+  // true to delete the key.  Otherwise, to replace the value, store the
+  // new value in *new_value and set *value_changed to true.
+  virtual bool Filter(int level, const Slice& key, const Slice& value,
+                      std::string* new_value, bool* value_changed) const = 0;
+};
+
+// Values managed by the TTL compaction filter end with the time they were
+// written, in seconds since the epoch, encoded as a fixed-length 64-bit
+// little-endian suffix of kTTLTimestampSize bytes.
+static const int kTTLTimestampSize = 8;
+
+// Append the suffix recording "unix_seconds" as the time of writing to
+// *value.
+LEVELDB_EXPORT void AppendTTLTimestamp(std::string* value,
+                                       uint64_t unix_seconds);
+
+// Return a new filter that deletes the values whose timestamp suffix
+// (see AppendTTLTimestamp) is more than "ttl_seconds" before the current
+// time of "env".  Values too short to have the suffix are kept.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const CompactionFilter* NewTTLCompactionFilter(
+    uint64_t ttl_seconds, Env* env);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
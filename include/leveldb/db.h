@@ -7,6 +7,7 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
@@ -72,6 +73,22 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove every database entry whose key is in ["begin_key", "end_key").
+  // Takes a single write however many keys the range holds; the deleted
+  // entries are dropped by later compactions.  Returns OK on success, and
+  // a non-OK status on error.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options,
+                             const Slice& begin_key, const Slice& end_key) = 0;
+
+  // Merge "value" into the database entry for "key" with the
+  // MergeOperator set in Options::merge_operator, without reading the
+  // current value.  Returns OK on success, and a non-OK status on error,
+  // including when the database has no merge operator.
+  // Note: consider setting options.sync = true.
+  virtual Status Merge(const WriteOptions& options, const Slice& key,
+                       const Slice& value) = 0;
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
@@ -119,6 +136,8 @@ class LEVELDB_EXPORT DB {
   //     about the internal operation of the DB.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
+  //  "leveldb.num-blob-files" - return the number of blob files that hold
+  //     values of the db (see Options::min_blob_size).
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
@@ -134,6 +153,23 @@ class LEVELDB_EXPORT DB {
   virtual void GetApproximateSizes(const Range* range, int n,
                                    uint64_t* sizes) = 0;
 
+  // Split the key range [*start, *limit) into at most "max_shards"
+  // consecutive sub-ranges that hold similar amounts of table data, and
+  // store an iterator over each of them, in key order, in *iterators.
+  // A null start means a range that starts before all keys, and a null
+  // limit means a range that ends after all keys.
+  //
+  // The iterators read from a single snapshot (options.snapshot if set),
+  // so together they return exactly the entries one iterator over the
+  // whole range would.  They may be used concurrently from different
+  // threads.  Fewer iterators are returned if the range holds too little
+  // data to split.  The caller should delete the iterators when they are
+  // no longer needed, and before this db is deleted.
+  virtual Status NewRangeIterators(const ReadOptions& options,
+                                   const Slice* start, const Slice* limit,
+                                   int max_shards,
+                                   std::vector<Iterator*>* iterators) = 0;
+
   // Compact the underlying storage for the key range [*begin,*end].
   // In particular, deleted and overwritten versions are discarded,
   // and the data is rearranged to reduce the cost of operations
@@ -0,0 +1,55 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MergeOperator lets a database apply read-modify-write updates, such
+// as incrementing a counter or appending to a list, without reading the
+// current value first.  DB::Merge() records an operand for a key; reads
+// combine the operands with the value beneath them when they need the
+// result, and compactions fold them together in the background.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Slice;
+
+// A MergeOperator must be thread-safe since leveldb may invoke its
+// methods concurrently from multiple threads.
+class LEVELDB_EXPORT MergeOperator {
+ public:
+  virtual ~MergeOperator();
+
+  // The name of the merge operator.  Used for logging.
+  virtual const char* Name() const = 0;
+
+  // Apply "operands", in the order they were written, to
+  // "*existing_value", the value of "key" they were merged onto, and
+  // store the result in *new_value.  "existing_value" is nullptr if "key"
+  // had no value (it was never written, or was deleted).
+  //
+  // Return false if the operands cannot be applied; the read or
+  // compaction that needed the result then fails with a corruption error.
+  virtual bool FullMerge(const Slice& key, const Slice* existing_value,
+                         const std::vector<Slice>& operands,
+                         std::string* new_value) const = 0;
+
+  // Combine two successive operands of "key", "left" written before
+  // "right", into a single operand with the same effect and store it in
+  // *new_value.  Return false if they cannot be combined without knowing
+  // the value beneath them, in which case both are kept.
+  //
+  // The default implementation never combines operands.
+  virtual bool PartialMerge(const Slice& key, const Slice& left,
+                            const Slice& right, std::string* new_value) const;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
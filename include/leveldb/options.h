@@ -6,16 +6,21 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
 
 #include "leveldb/export.h"
 
 namespace leveldb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MergeOperator;
+class PersistentCache;
+class Slice;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -30,6 +35,33 @@ enum CompressionType {
   kSnappyCompression = 0x1
 };
 
+// The shape in which compactions keep the tables of a database.
+enum CompactionStyle {
+  // Each level holds about ten times as much data as the one before it,
+  // and compactions move data down one level at a time.  Reads consult
+  // few tables, but data is rewritten about ten times on every level.
+  kLeveledCompaction = 0x0,
+  // The database is a list of sorted runs: every level-0 file, and every
+  // other level as a whole.  Compactions merge runs of similar size into
+  // one, so data is rewritten fewer times, at the cost of reads that
+  // consult more runs and of space taken by overwritten data.
+  kTieredCompaction = 0x1
+};
+
+// How a leveled compaction picks the file of a level to merge into the
+// next level.
+enum CompactionPickPolicy {
+  // Each file in turn, in key order.
+  kPickRoundRobin = 0x0,
+  // The file that overlaps the fewest bytes of the next level for its
+  // size, so that moving data down rewrites the least of the next level.
+  kPickMinOverlap = 0x1,
+  // The file in which deletions make up the largest share of the entries,
+  // so that the space they hide is reclaimed and reads stop skipping
+  // them soonest.  Files without deletions are taken in turn.
+  kPickMostDeletions = 0x2
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct LEVELDB_EXPORT Options {
   // Create an Options object with default values for all fields.
@@ -82,9 +114,68 @@ struct LEVELDB_EXPORT Options {
   // the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // If non-zero, every memtable keeps a bloom filter over the user keys
+  // it holds, sized at this fraction of write_buffer_size.  Point lookups
+  // for keys that are not in a memtable can then skip the memtable search
+  // entirely.  The filter memory counts towards write_buffer_size.
+  // Values are clipped to [0, 0.25].
+  //
+  // Default: 0 (no memtable bloom filter)
+  double memtable_bloom_size_ratio = 0;
+
+  // If non-zero, memtables allocate their memory in blocks of this many
+  // bytes taken directly from the operating system instead of in small
+  // heap allocations, and the blocks of flushed memtables are recycled
+  // for new ones.  Large blocks reduce TLB pressure and allocator
+  // overhead for big write buffers.  Since memtable memory usage grows a
+  // block at a time, this should be a small fraction of
+  // write_buffer_size.  Values are clipped to [64KB, 256MB].
+  //
+  // Default: 0 (allocate memtable memory from the heap)
+  size_t memtable_arena_block_size = 0;
+
+  // If true and memtable_arena_block_size is non-zero, back memtable
+  // blocks with huge pages where the platform supports it, falling back
+  // to transparent huge pages and then to normal pages.  Block sizes are
+  // rounded up to a multiple of the huge page size.
+  bool memtable_huge_pages = false;
+
+  // If non-negative and memtable_arena_block_size is non-zero, bind
+  // memtable memory to this NUMA node where the platform supports it.
+  int memtable_numa_node = -1;
+
+  // Number of threads used to replay write-ahead logs when the database
+  // is opened.  With more than one thread, log records are decoded into
+  // several memtables concurrently and each memtable is written to a
+  // level-0 table as soon as it is full.  This shortens recovery after a
+  // crash with a large log, at the cost of up to this many write buffers
+  // being held in memory at once.  Values are clipped to [1, 64].
+  //
+  // Default: 1 (replay logs on the thread that opens the database)
+  int max_recovery_threads = 1;
+
+  // If non-zero, DB::Open opens up to this many live tables and loads
+  // their index and filter blocks into the table cache before returning,
+  // so that the first reads after opening the database do not pay for
+  // it.  Tables are opened level by level, newest first within a level,
+  // and never more than fit in the table cache (see max_open_files).
+  // With paranoid_checks, the blocks read are also verified.  Failures
+  // are logged but do not fail DB::Open.
+  //
+  // Default: 0 (tables are opened lazily by the first read that needs them)
+  int table_warmup_files = 0;
+
+  // Number of threads used to open tables for table_warmup_files.
+  // Values are clipped to [1, 64].
+  int table_warmup_threads = 4;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
+  //
+  // -1 keeps every table open once it has been read, and reads then skip
+  // the table cache lookup.  The process must allow one open file per
+  // table, and the index and filter blocks of all tables stay in memory.
   int max_open_files = 1000;
 
   // Control over blocks (user data is stored in a set of blocks, and
@@ -94,6 +185,27 @@ struct LEVELDB_EXPORT Options {
   // If null, leveldb will automatically create and use an 8MB internal cache.
   Cache* block_cache = nullptr;
 
+  // If non-null, use the specified cache as a second tier behind
+  // block_cache.  It holds blocks as stored in the table files, i.e.
+  // compressed if compression is enabled, so that it fits more blocks into
+  // the same memory.  Blocks missing from block_cache are looked up here
+  // before they are read from the table; blocks read from the table are
+  // added to both caches.
+  Cache* compressed_block_cache = nullptr;
+
+  // If non-null, keep blocks in the specified cache on a faster device,
+  // e.g. a local SSD in front of network-attached storage.  It is
+  // consulted after compressed_block_cache and filled with every block
+  // read from a table.  See NewFilePersistentCache().
+  PersistentCache* persistent_cache = nullptr;
+
+  // If non-null, use the specified cache for the results of point lookups
+  // in table files: the newest entry for a key in a table, or the absence
+  // of the key.  Repeated reads of hot keys are then answered without
+  // touching the table.  Unlike the block cache, leveldb never creates a
+  // row cache on its own.
+  Cache* row_cache = nullptr;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -115,6 +227,77 @@ struct LEVELDB_EXPORT Options {
   // initially populating a large database.
   size_t max_file_size = 2 * 1024 * 1024;
 
+  // Compactions keep level-1 under this many bytes, and each later level
+  // under ten times the limit of the level before it.
+  size_t max_bytes_for_level_base = 10 * 1024 * 1024;
+
+  // If true, the level limits are instead derived backward from the size
+  // of the largest level, each a tenth of the next, so that the levels
+  // line up with the data however large the database grows.  Levels
+  // whose limit would be under max_bytes_for_level_base are not used,
+  // and level-0 compacts directly into the first level in use.  This
+  // keeps the space taken by overwritten data close to the minimum.
+  //
+  // Default: false
+  bool dynamic_level_bytes = false;
+
+  // How compactions pick the file of a level to merge into the next one.
+  // Level-0 compactions take all overlapping level-0 files regardless.
+  //
+  // Default: kPickRoundRobin
+  CompactionPickPolicy compaction_pick_policy = kPickRoundRobin;
+
+  // If non-zero, a table written with at least deletion_compaction_trigger
+  // deletions among some run of this many consecutive entries is marked
+  // for compaction, which pushes it down even if its level is within its
+  // size limit.  The deletions are dropped once nothing older lies below
+  // them, so that scans need not step over them.
+  //
+  // Default: 0 (tables are never marked)
+  int deletion_compaction_window = 0;
+
+  // See deletion_compaction_window.  Clipped to [1, window].
+  int deletion_compaction_trigger = 0;
+
+  // If non-zero, a table written more than this many seconds ago is
+  // compacted even if its level is within its size limit.  This bounds
+  // how long overwritten and deleted data may linger in cold key ranges.
+  //
+  // Default: 0 (tables are never compacted for their age)
+  uint64_t periodic_compaction_seconds = 0;
+
+  // If non-zero, values of at least this many bytes are written to blob
+  // files, apart from their keys, when memtables are flushed and when
+  // compactions rewrite them.  The tables then hold a small reference in
+  // place of each such value, so compactions move the references instead
+  // of the values.  Reading such a value costs one more disk read.
+  //
+  // Default: 0 (values are always kept in the tables)
+  size_t min_blob_size = 0;
+
+  // Compactions copy the values they keep out of blob files of which
+  // less than this fraction of the value bytes is still referenced, so
+  // that the space of the unreferenced values can be reclaimed once no
+  // table refers to the file any more.  Values are clipped to [0, 1];
+  // 0 never copies values.
+  double blob_gc_live_ratio = 0.5;
+
+  // The shape in which compactions keep the tables.  Tiered compaction
+  // suits workloads that write far more than they read.  A database may
+  // be reopened with a different style.
+  //
+  // Default: kLeveledCompaction
+  CompactionStyle compaction_style = kLeveledCompaction;
+
+  // Tiered compaction merges a sorted run into the newer runs before it
+  // if it is at most this many percent larger than those runs together.
+  int tiered_size_ratio = 1;
+
+  // Tiered compaction merges every sorted run into one if the runs other
+  // than the oldest hold more than this many percent of the bytes of the
+  // oldest.  This bounds the space taken by overwritten and deleted data.
+  int tiered_max_size_amplification_percent = 200;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -141,6 +324,17 @@ struct LEVELDB_EXPORT Options {
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
+
+  // If non-null, use the specified merge operator to combine the operands
+  // written by DB::Merge() with the values beneath them.  Required for
+  // DB::Merge(); reading a key with merge operands fails without it.
+  const MergeOperator* merge_operator = nullptr;
+
+  // If non-null, compactions pass the values they rewrite through this
+  // filter, which may delete them or change them.  See
+  // leveldb/compaction_filter.h, which also provides a filter that
+  // expires values after a time to live.
+  const CompactionFilter* compaction_filter = nullptr;
 };
 
 // Options that control read operations
@@ -160,6 +354,25 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If true, DB::NewIterator() returns an iterator that follows new
+  // writes: every Seek(), SeekToFirst() and SeekToLast() sees the data
+  // written before it, and repositioning is much cheaper than creating a
+  // new iterator.  "snapshot" is ignored.
+  bool tailing = false;
+
+  // If non-null, iterators only return keys >= *iterate_lower_bound.
+  // Seeks to smaller keys land on the bound instead.
+  const Slice* iterate_lower_bound = nullptr;
+
+  // If non-null, iterators only return keys < *iterate_upper_bound, and
+  // do not read data beyond it: they become invalid at the first key past
+  // the bound.
+  //
+  // The slices the bounds point to must outlive the iterator.  For
+  // Table::NewIterator() the bounds are keys of the table, and they only
+  // keep the iterator from reading blocks that lie entirely outside them.
+  const Slice* iterate_upper_bound = nullptr;
 };
 
 // Options that control write operations
@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PersistentCache keeps table blocks on a storage device that is faster
+// than the one holding the tables themselves, typically a local SSD in
+// front of network-attached storage.  It sits behind the in-memory block
+// caches: blocks read from a table are added to it, and blocks missing
+// from memory are looked up in it before the table is read.
+//
+// A PersistentCache has internal synchronization and may be safely
+// accessed concurrently from multiple threads.  It may drop entries at
+// any time.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+#define STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+class PersistentCache;
+
+// Create a cache that keeps up to "capacity" bytes of blocks in files
+// under the directory "dir" of "env".  The files are written by a thread
+// of the cache's own.  Cache files left in "dir" by an earlier instance
+// are removed, so the cache starts out empty: it spares reads of the
+// tables while the process runs, but does not survive a restart.  On
+// success, stores a pointer to the new cache in *result and returns OK.
+// The caller should delete the cache when it is no longer needed, after
+// every database using it has been closed.
+LEVELDB_EXPORT Status NewFilePersistentCache(Env* env, const std::string& dir,
+                                             uint64_t capacity,
+                                             PersistentCache** result);
+
+class LEVELDB_EXPORT PersistentCache {
+ public:
+  PersistentCache() = default;
+
+  PersistentCache(const PersistentCache&) = delete;
+  PersistentCache& operator=(const PersistentCache&) = delete;
+
+  virtual ~PersistentCache();
+
+  // Store "data" under "key".  Blocks never change once written, so an
+  // existing entry for "key" may be kept instead.
+  virtual Status Insert(const Slice& key, const Slice& data) = 0;
+
+  // If the cache holds an entry for "key", store its contents in *data and
+  // return OK.  Returns a NotFound status if there is no entry, and a
+  // non-OK status if the entry could not be read back intact.
+  virtual Status Lookup(const Slice& key, std::string* data) = 0;
+
+  // Return a new numeric id.  May be used by multiple clients who are
+  // sharing the same cache to partition the key space.  Typically the
+  // client will allocate a new id at startup and prepend the id to
+  // its cache keys.
+  virtual uint64_t NewId() = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
@@ -14,6 +14,7 @@ namespace leveldb {
 
 class Block;
 class BlockHandle;
+struct BlockContents;
 class Footer;
 struct Options;
 class RandomAccessFile;
@@ -50,6 +51,11 @@ class LEVELDB_EXPORT Table {
   // call one of the Seek methods on the iterator before using it).
   Iterator* NewIterator(const ReadOptions&) const;
 
+  // Returns a new iterator over the entries added to the table with
+  // TableBuilder::AddRangeDeletion(), which NewIterator() does not return.
+  // The range deletions are held in memory while the table is open.
+  Iterator* NewRangeDeletionIterator() const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file).  The returned value is in terms of file
@@ -64,8 +70,17 @@ class LEVELDB_EXPORT Table {
 
   static Iterator* BlockReader(void*, const ReadOptions&, const Slice&);
 
+  // Read a data block through the compressed and persistent cache tiers.
+  Status ReadDataBlock(const ReadOptions& options, const BlockHandle& handle,
+                       BlockContents* contents) const;
+
   explicit Table(Rep* rep) : rep_(rep) {}
 
+  // Key the blocks of this table in Options::persistent_cache by "id" and
+  // "file_number", which stay the same when the table is opened again,
+  // instead of by an id of its own.
+  void SetPersistentCacheKey(uint64_t id, uint64_t file_number);
+
   // Calls (*handle_result)(arg, ...) with the entry found after a call
   // to Seek(key).  May not make such a call if filter policy says
   // that key is not present.
@@ -73,8 +88,9 @@ class LEVELDB_EXPORT Table {
                      void (*handle_result)(void* arg, const Slice& k,
                                            const Slice& v));
 
-  void ReadMeta(const Footer& footer);
+  Status ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  Status ReadRangeDeletions(const Slice& handle_value);
 
   Rep* const rep_;
 };
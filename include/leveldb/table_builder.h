@@ -51,6 +51,14 @@ class LEVELDB_EXPORT TableBuilder {
   // REQUIRES: Finish(), Abandon() have not been called
   void Add(const Slice& key, const Slice& value);
 
+  // Add key,value to the range deletion block of the table, which is kept
+  // apart from the entries added by Add() and read back with
+  // Table::NewRangeDeletionIterator().
+  // REQUIRES: key is after any previously added range deletion key
+  // according to comparator.
+  // REQUIRES: Finish(), Abandon() have not been called
+  void AddRangeDeletion(const Slice& key, const Slice& value);
+
   // Advanced operation: flush any buffered key/value pairs to file.
   // Can be used to ensure that two adjacent entries never live in
   // the same data block.  Most clients should not need to use this method.
@@ -75,6 +83,9 @@ class LEVELDB_EXPORT TableBuilder {
   // Number of calls to Add() so far.
   uint64_t NumEntries() const;
 
+  // Number of calls to AddRangeDeletion() so far.
+  uint64_t NumRangeDeletions() const;
+
   // Size of the file generated so far.  If invoked after a successful
   // Finish() call, returns the size of the final generated file.
   uint64_t FileSize() const;
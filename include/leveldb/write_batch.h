@@ -37,6 +37,8 @@ class LEVELDB_EXPORT WriteBatch {
     virtual ~Handler();
     virtual void Put(const Slice& key, const Slice& value) = 0;
     virtual void Delete(const Slice& key) = 0;
+    virtual void DeleteRange(const Slice& begin_key, const Slice& end_key) = 0;
+    virtual void Merge(const Slice& key, const Slice& value) = 0;
   };
 
   WriteBatch();
@@ -53,6 +55,15 @@ class LEVELDB_EXPORT WriteBatch {
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   void Delete(const Slice& key);
 
+  // Erase every mapping whose key is in ["begin_key", "end_key") from the
+  // database.  The batch holds one record no matter how many keys the
+  // range contains.
+  void DeleteRange(const Slice& begin_key, const Slice& end_key);
+
+  // Merge "value" into the value of "key" with the database's
+  // MergeOperator (see Options::merge_operator).
+  void Merge(const Slice& key, const Slice& value);
+
   // Clear all updates buffered in this batch.
   void Clear();
 
@@ -88,6 +88,19 @@ bool Snappy_Uncompress(const char* input_data, size_t input_length,
 // The concatenation of all "data[0,n-1]" fragments is the heap profile.
 bool GetHeapProfile(void (*func)(void*, const char*, int), void* arg);
 
+// Allocate "size" bytes of page-aligned, zero-filled memory directly from
+// the operating system.  If "huge_pages" is true, try to back the memory
+// with huge pages.  If "numa_node" is non-negative, try to bind the memory
+// to that NUMA node.  Both hints are best effort.
+//
+// Returns nullptr if such allocations are not supported, in which case the
+// caller should fall back to the heap.
+char* AllocateLargePages(size_t size, bool huge_pages, int numa_node);
+
+// Release memory returned by AllocateLargePages().  "size" must be the
+// size that was passed to AllocateLargePages().
+void FreeLargePages(char* ptr, size_t size);
+
 // Extend the CRC to include the first n bytes of buf.
 //
 // Returns zero if the CRC cannot be extended using acceleration, else returns
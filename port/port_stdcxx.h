@@ -28,6 +28,13 @@
 #if HAVE_SNAPPY
 #include <snappy.h>
 #endif  // HAVE_SNAPPY
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif  // HAVE_MMAP
+#if HAVE_MBIND
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // HAVE_MBIND
 
 #include <cassert>
 #include <condition_variable>  // NOLINT
@@ -145,6 +152,62 @@ inline uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size) {
 #endif  // HAVE_CRC32C
 }
 
+inline char* AllocateLargePages(size_t size, bool huge_pages, int numa_node) {
+#if HAVE_MMAP
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void* result = MAP_FAILED;
+#if HAVE_MAP_HUGETLB
+  if (huge_pages) {
+    // Only succeeds if huge pages have been reserved by the administrator.
+    result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB,
+                    -1, 0);
+  }
+#endif  // HAVE_MAP_HUGETLB
+  if (result == MAP_FAILED) {
+    result = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (result == MAP_FAILED) {
+      return nullptr;
+    }
+#if defined(MADV_HUGEPAGE)
+    if (huge_pages) {
+      // Fall back to transparent huge pages.  Errors are ignored.
+      ::madvise(result, size, MADV_HUGEPAGE);
+    }
+#endif  // defined(MADV_HUGEPAGE)
+  }
+#if HAVE_MBIND
+  if (numa_node >= 0 && numa_node < 64) {
+    // MPOL_BIND, spelled out to avoid depending on libnuma's headers.
+    // Binding is best effort, so errors are ignored.
+    const int kMpolBind = 2;
+    unsigned long node_mask = 1UL << numa_node;
+    ::syscall(SYS_mbind, result, size, kMpolBind, &node_mask,
+              sizeof(node_mask) * 8 + 1, 0);
+  }
+#else
+  (void)numa_node;
+#endif  // HAVE_MBIND
+  return reinterpret_cast<char*>(result);
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)size;
+  (void)huge_pages;
+  (void)numa_node;
+  return nullptr;
+#endif  // HAVE_MMAP
+}
+
+inline void FreeLargePages(char* ptr, size_t size) {
+#if HAVE_MMAP
+  ::munmap(ptr, size);
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)ptr;
+  (void)size;
+  assert(false);
+#endif  // HAVE_MMAP
+}
+
 }  // namespace port
 }  // namespace leveldb
 
@@ -41,10 +41,14 @@ Block::Block(const BlockContents& contents)
 
 Block::~Block() {
   if (owned_) {
-    delete[] data_;
+    FreeBlockBuffer(data_);
   }
 }
 
+size_t Block::usage() const {
+  return owned_ ? BlockBufferUsage(data_) : size_;
+}
+
 // Helper routine: decode the next block entry starting at "p",
 // storing the number of shared key bytes, non_shared key bytes,
 // and the length of the value in "*shared", "*non_shared", and
@@ -26,6 +26,11 @@ class Block {
   ~Block();
 
   size_t size() const { return size_; }
+
+  // Returns the memory held by this block, including the slack of its
+  // pooled buffer.
+  size_t usage() const;
+
   Iterator* NewIterator(const Comparator* comparator);
 
  private:
@@ -4,14 +4,41 @@
 
 #include "table/format.h"
 
+#include <cstring>
+
 #include "leveldb/env.h"
 #include "port/port.h"
 #include "table/block.h"
+#include "util/buffer_pool.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
+#include "util/no_destructor.h"
 
 namespace leveldb {
 
+namespace {
+
+// Blocks are usually close to Options::block_size, which defaults to 4KB.
+// Larger blocks are rare enough to go straight to the heap.
+const size_t kMaxPooledBlockSize = 64 << 10;
+const size_t kMaxIdleBlockBytes = 8 << 20;
+
+BufferPool* BlockBufferPool() {
+  static NoDestructor<BufferPool> pool(kMaxPooledBlockSize,
+                                       kMaxIdleBlockBytes);
+  return pool.get();
+}
+
+}  // namespace
+
+char* AllocateBlockBuffer(size_t n) { return BlockBufferPool()->Allocate(n); }
+
+void FreeBlockBuffer(const char* buf) {
+  BlockBufferPool()->Release(const_cast<char*>(buf));
+}
+
+size_t BlockBufferUsage(const char* buf) { return BufferPool::Usage(buf); }
+
 void BlockHandle::EncodeTo(std::string* dst) const {
   // Sanity check that all fields have been set
   assert(offset_ != ~static_cast<uint64_t>(0));
@@ -61,8 +88,38 @@ Status Footer::DecodeFrom(Slice* input) {
   return result;
 }
 
+// Verify the crc of the type and contents of the "n" byte block at "data",
+// which is followed by its trailer.
+static Status VerifyBlockChecksum(const char* data, size_t n) {
+  const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
+  const uint32_t actual = crc32c::Value(data, n + 1);
+  if (actual != crc) {
+    return Status::Corruption("block checksum mismatch");
+  }
+  return Status::OK();
+}
+
+// Uncompress the "n" byte snappy-compressed block at "data" into *result.
+static Status UncompressSnappyBlock(const char* data, size_t n,
+                                    BlockContents* result) {
+  size_t ulength = 0;
+  if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+    return Status::Corruption("corrupted compressed block contents");
+  }
+  char* ubuf = AllocateBlockBuffer(ulength);
+  if (!port::Snappy_Uncompress(data, n, ubuf)) {
+    FreeBlockBuffer(ubuf);
+    return Status::Corruption("corrupted compressed block contents");
+  }
+  result->data = Slice(ubuf, ulength);
+  result->heap_allocated = true;
+  result->cachable = true;
+  return Status::OK();
+}
+
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result) {
+                 const BlockHandle& handle, BlockContents* result,
+                 std::string* raw) {
   result->data = Slice();
   result->cachable = false;
   result->heap_allocated = false;
@@ -70,29 +127,30 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
   // Read the block contents as well as the type/crc footer.
   // See table_builder.cc for the code that built this structure.
   size_t n = static_cast<size_t>(handle.size());
-  char* buf = new char[n + kBlockTrailerSize];
+  char* buf = AllocateBlockBuffer(n + kBlockTrailerSize);
   Slice contents;
   Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
   if (!s.ok()) {
-    delete[] buf;
+    FreeBlockBuffer(buf);
     return s;
   }
   if (contents.size() != n + kBlockTrailerSize) {
-    delete[] buf;
+    FreeBlockBuffer(buf);
     return Status::Corruption("truncated block read");
   }
 
   // Check the crc of the type and the block contents
   const char* data = contents.data();  // Pointer to where Read put the data
   if (options.verify_checksums) {
-    const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
-    const uint32_t actual = crc32c::Value(data, n + 1);
-    if (actual != crc) {
-      delete[] buf;
-      s = Status::Corruption("block checksum mismatch");
+    s = VerifyBlockChecksum(data, n);
+    if (!s.ok()) {
+      FreeBlockBuffer(buf);
       return s;
     }
   }
+  if (raw != nullptr) {
+    raw->assign(data, n + kBlockTrailerSize);
+  }
 
   switch (data[n]) {
     case kNoCompression:
@@ -100,7 +158,7 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
         // File implementation gave us pointer to some other data.
         // Use it directly under the assumption that it will be live
         // while the file is open.
-        delete[] buf;
+        FreeBlockBuffer(buf);
         result->data = Slice(data, n);
         result->heap_allocated = false;
         result->cachable = false;  // Do not double-cache
@@ -112,30 +170,50 @@ Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
 
       // Ok
       break;
-    case kSnappyCompression: {
-      size_t ulength = 0;
-      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-        delete[] buf;
-        return Status::Corruption("corrupted compressed block contents");
-      }
-      char* ubuf = new char[ulength];
-      if (!port::Snappy_Uncompress(data, n, ubuf)) {
-        delete[] buf;
-        delete[] ubuf;
-        return Status::Corruption("corrupted compressed block contents");
-      }
-      delete[] buf;
-      result->data = Slice(ubuf, ulength);
+    case kSnappyCompression:
+      s = UncompressSnappyBlock(data, n, result);
+      FreeBlockBuffer(buf);
+      return s;
+    default:
+      FreeBlockBuffer(buf);
+      return Status::Corruption("bad block type");
+  }
+
+  return Status::OK();
+}
+
+Status DecodeBlock(const ReadOptions& options, const Slice& raw,
+                   BlockContents* result) {
+  result->data = Slice();
+  result->cachable = false;
+  result->heap_allocated = false;
+
+  if (raw.size() < kBlockTrailerSize) {
+    return Status::Corruption("truncated block");
+  }
+  const char* data = raw.data();
+  const size_t n = raw.size() - kBlockTrailerSize;
+  if (options.verify_checksums) {
+    Status s = VerifyBlockChecksum(data, n);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  switch (data[n]) {
+    case kNoCompression: {
+      char* buf = AllocateBlockBuffer(n);
+      std::memcpy(buf, data, n);
+      result->data = Slice(buf, n);
       result->heap_allocated = true;
       result->cachable = true;
-      break;
+      return Status::OK();
     }
+    case kSnappyCompression:
+      return UncompressSnappyBlock(data, n, result);
     default:
-      delete[] buf;
       return Status::Corruption("bad block type");
   }
-
-  return Status::OK();
 }
 
 }  // namespace leveldb
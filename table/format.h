@@ -78,16 +78,37 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Key of the metaindex entry that points to the range deletion block.
+static const char kRangeDelBlockName[] = "rangedel";
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
-  bool heap_allocated;  // True iff caller should delete[] data.data()
+  bool heap_allocated;  // True iff caller should FreeBlockBuffer(data.data())
 };
 
+// Buffers for block contents are recycled through a process-wide pool so
+// that reading a block does not need a fresh heap allocation.
+char* AllocateBlockBuffer(size_t n);
+
+// Return a buffer obtained from AllocateBlockBuffer() to the pool.
+void FreeBlockBuffer(const char* buf);
+
+// Returns the heap memory held by a buffer from AllocateBlockBuffer().
+size_t BlockBufferUsage(const char* buf);
+
 // Read the block identified by "handle" from "file".  On failure
-// return non-OK.  On success fill *result and return OK.
+// return non-OK.  On success fill *result and return OK.  If "raw" is
+// non-null, also store the block as found in the file, trailer included,
+// in *raw.
 Status ReadBlock(RandomAccessFile* file, const ReadOptions& options,
-                 const BlockHandle& handle, BlockContents* result);
+                 const BlockHandle& handle, BlockContents* result,
+                 std::string* raw = nullptr);
+
+// Fill *result from "raw", a block followed by its trailer as stored in a
+// table file.  result->data never refers to "raw".
+Status DecodeBlock(const ReadOptions& options, const Slice& raw,
+                   BlockContents* result);
 
 // Implementation details follow.  Clients should ignore,
 
@@ -9,6 +9,7 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/persistent_cache.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -20,19 +21,27 @@ namespace leveldb {
 struct Table::Rep {
   ~Rep() {
     delete filter;
-    delete[] filter_data;
+    if (filter_data != nullptr) {
+      FreeBlockBuffer(filter_data);
+    }
     delete index_block;
+    delete range_del_block;
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
   uint64_t cache_id;
+  uint64_t compressed_cache_id;
+  // Entries of persistent_cache are keyed by these and the block offset.
+  uint64_t persistent_cache_id;
+  uint64_t persistent_file_number;
   FilterBlockReader* filter;
   const char* filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+  Block* range_del_block;  // nullptr if the table has no range deletions
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -70,42 +79,62 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
+    rep->compressed_cache_id = (options.compressed_block_cache
+                                    ? options.compressed_block_cache->NewId()
+                                    : 0);
+    rep->persistent_cache_id =
+        (options.persistent_cache ? options.persistent_cache->NewId() : 0);
+    rep->persistent_file_number = 0;
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->range_del_block = nullptr;
     *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    s = (*table)->ReadMeta(footer);
+    if (!s.ok()) {
+      delete *table;
+      *table = nullptr;
+    }
   }
 
   return s;
 }
 
-void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
+Status Table::ReadMeta(const Footer& footer) {
+  // An empty metaindex block holds nothing but its restart array: one
+  // restart point and the number of restart points.
+  if (footer.metaindex_handle().size() <= 2 * sizeof(uint32_t)) {
+    return Status::OK();  // No metadata
   }
 
-  // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
-  // it is an empty block.
   ReadOptions opt;
   if (rep_->options.paranoid_checks) {
     opt.verify_checksums = true;
   }
   BlockContents contents;
-  if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
-    // Do not propagate errors since meta info is not needed for operation
-    return;
+  Status s = ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents);
+  if (!s.ok()) {
+    // The filter is not needed for operation, but range deletions are and
+    // cannot be found without the metaindex.
+    return s;
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+  }
+  iter->Seek(kRangeDelBlockName);
+  if (iter->Valid() && iter->key() == Slice(kRangeDelBlockName)) {
+    s = ReadRangeDeletions(iter->value());
   }
   delete iter;
   delete meta;
+  return s;
 }
 
 void Table::ReadFilter(const Slice& filter_handle_value) {
@@ -131,6 +160,25 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+Status Table::ReadRangeDeletions(const Slice& handle_value) {
+  Slice v = handle_value;
+  BlockHandle handle;
+  Status s = handle.DecodeFrom(&v);
+  if (!s.ok()) {
+    return s;
+  }
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  s = ReadBlock(rep_->file, opt, handle, &block);
+  if (s.ok()) {
+    rep_->range_del_block = new Block(block);
+  }
+  return s;
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
@@ -148,6 +196,75 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+static void DeleteRawBlock(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+Status Table::ReadDataBlock(const ReadOptions& options,
+                            const BlockHandle& handle,
+                            BlockContents* contents) const {
+  Cache* compressed_cache = rep_->options.compressed_block_cache;
+  PersistentCache* persistent_cache = rep_->options.persistent_cache;
+  if (compressed_cache == nullptr && persistent_cache == nullptr) {
+    return ReadBlock(rep_->file, options, handle, contents);
+  }
+
+  char compressed_key[16];
+  char persistent_key[24];
+  EncodeFixed64(compressed_key, rep_->compressed_cache_id);
+  EncodeFixed64(compressed_key + 8, handle.offset());
+  EncodeFixed64(persistent_key, rep_->persistent_cache_id);
+  EncodeFixed64(persistent_key + 8, rep_->persistent_file_number);
+  EncodeFixed64(persistent_key + 16, handle.offset());
+
+  if (compressed_cache != nullptr) {
+    Cache::Handle* h =
+        compressed_cache->Lookup(Slice(compressed_key, sizeof(compressed_key)));
+    if (h != nullptr) {
+      Status s = DecodeBlock(
+          options, *reinterpret_cast<std::string*>(compressed_cache->Value(h)),
+          contents);
+      compressed_cache->Release(h);
+      return s;
+    }
+  }
+
+  // Blocks found in the persistent cache are promoted to the compressed
+  // cache.  Damaged entries are ignored and the block is read again.
+  std::string* raw = new std::string;
+  Status s;
+  bool found = false;
+  if (persistent_cache != nullptr &&
+      persistent_cache->Lookup(Slice(persistent_key, sizeof(persistent_key)),
+                               raw)
+          .ok()) {
+    s = DecodeBlock(options, *raw, contents);
+    found = s.ok();
+  }
+  if (!found) {
+    s = ReadBlock(rep_->file, options, handle, contents, raw);
+    if (s.ok() && persistent_cache != nullptr && options.fill_cache) {
+      // Errors only cost later lookups a read of the table.
+      persistent_cache->Insert(Slice(persistent_key, sizeof(persistent_key)),
+                               *raw);
+    }
+  }
+  if (s.ok() && compressed_cache != nullptr && options.fill_cache) {
+    const size_t charge = sizeof(std::string) + raw->size();
+    compressed_cache->Release(
+        compressed_cache->Insert(Slice(compressed_key, sizeof(compressed_key)),
+                                 raw, charge, &DeleteRawBlock));
+  } else {
+    delete raw;
+  }
+  return s;
+}
+
+void Table::SetPersistentCacheKey(uint64_t id, uint64_t file_number) {
+  rep_->persistent_cache_id = id;
+  rep_->persistent_file_number = file_number;
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
@@ -174,17 +291,17 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = table->ReadDataBlock(options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
+            cache_handle = block_cache->Insert(key, block, block->usage(),
                                                &DeleteCachedBlock);
           }
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = table->ReadDataBlock(options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -208,7 +325,15 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 Iterator* Table::NewIterator(const ReadOptions& options) const {
   return NewTwoLevelIterator(
       rep_->index_block->NewIterator(rep_->options.comparator),
-      &Table::BlockReader, const_cast<Table*>(this), options);
+      &Table::BlockReader, const_cast<Table*>(this), options,
+      rep_->options.comparator);
+}
+
+Iterator* Table::NewRangeDeletionIterator() const {
+  if (rep_->range_del_block == nullptr) {
+    return NewEmptyIterator();
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
 }
 
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
@@ -4,6 +4,7 @@
 
 #include "leveldb/table.h"
 
+#include <cstdio>
 #include <map>
 #include <string>
 
@@ -236,6 +237,9 @@ class TableConstructor : public Constructor {
   Iterator* NewIterator() const override {
     return table_->NewIterator(ReadOptions());
   }
+  Iterator* NewIterator(const ReadOptions& options) const {
+    return table_->NewIterator(options);
+  }
 
   uint64_t ApproximateOffsetOf(const Slice& key) const {
     return table_->ApproximateOffsetOf(key);
@@ -790,6 +794,44 @@ static bool SnappyCompressionSupported() {
   return port::Snappy_Compress(in.data(), in.size(), &out);
 }
 
+TEST(TableTest, IterateBoundsSkipBlocks) {
+  TableConstructor c(BytewiseComparator());
+  for (int i = 0; i < 1000; i++) {
+    char key[10];
+    std::snprintf(key, sizeof(key), "k%04d", i);
+    c.Add(key, std::string(100, 'x'));
+  }
+  std::vector<std::string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  c.Finish(options, &keys, &kvmap);
+
+  // Blocks past the upper bound, or before the lower one, are not read,
+  // so iteration ends within a block of the bound.
+  Slice lower("k0500");
+  Slice upper("k0600");
+  ReadOptions read_options;
+  read_options.iterate_lower_bound = &lower;
+  read_options.iterate_upper_bound = &upper;
+  Iterator* iter = c.NewIterator(read_options);
+  int count = 0;
+  for (iter->Seek(lower); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_GE(count, 100);
+  ASSERT_LE(count, 120);
+
+  count = 0;
+  for (iter->Seek(upper); iter->Valid(); iter->Prev()) {
+    count++;
+  }
+  ASSERT_GE(count, 100);
+  ASSERT_LE(count, 120);
+  delete iter;
+}
+
 TEST(TableTest, ApproximateOffsetOfCompressed) {
   if (!SnappyCompressionSupported()) {
     std::fprintf(stderr, "skipping compression tests\n");
@@ -4,6 +4,7 @@
 
 #include "table/two_level_iterator.h"
 
+#include "leveldb/comparator.h"
 #include "leveldb/table.h"
 #include "table/block.h"
 #include "table/format.h"
@@ -18,7 +19,8 @@ typedef Iterator* (*BlockFunction)(void*, const ReadOptions&, const Slice&);
 class TwoLevelIterator : public Iterator {
  public:
   TwoLevelIterator(Iterator* index_iter, BlockFunction block_function,
-                   void* arg, const ReadOptions& options);
+                   void* arg, const ReadOptions& options,
+                   const Comparator* comparator);
 
   ~TwoLevelIterator() override;
 
@@ -54,12 +56,28 @@ class TwoLevelIterator : public Iterator {
   }
   void SkipEmptyDataBlocksForward();
   void SkipEmptyDataBlocksBackward();
+
+  // Whether the blocks after the current one lie past the upper bound.
+  bool AtUpperBound() const {
+    return options_.iterate_upper_bound != nullptr &&
+           comparator_->Compare(index_iter_.key(),
+                                *options_.iterate_upper_bound) >= 0;
+  }
+
+  // Whether the current block lies before the lower bound.
+  bool BeforeLowerBound() const {
+    return options_.iterate_lower_bound != nullptr &&
+           comparator_->Compare(index_iter_.key(),
+                                *options_.iterate_lower_bound) < 0;
+  }
+
   void SetDataIterator(Iterator* data_iter);
   void InitDataBlock();
 
   BlockFunction block_function_;
   void* arg_;
   const ReadOptions options_;
+  const Comparator* const comparator_;
   Status status_;
   IteratorWrapper index_iter_;
   IteratorWrapper data_iter_;  // May be nullptr
@@ -70,10 +88,12 @@ class TwoLevelIterator : public Iterator {
 
 TwoLevelIterator::TwoLevelIterator(Iterator* index_iter,
                                    BlockFunction block_function, void* arg,
-                                   const ReadOptions& options)
+                                   const ReadOptions& options,
+                                   const Comparator* comparator)
     : block_function_(block_function),
       arg_(arg),
       options_(options),
+      comparator_(comparator),
       index_iter_(index_iter),
       data_iter_(nullptr) {}
 
@@ -115,7 +135,7 @@ void TwoLevelIterator::Prev() {
 void TwoLevelIterator::SkipEmptyDataBlocksForward() {
   while (data_iter_.iter() == nullptr || !data_iter_.Valid()) {
     // Move to next block
-    if (!index_iter_.Valid()) {
+    if (!index_iter_.Valid() || AtUpperBound()) {
       SetDataIterator(nullptr);
       return;
     }
@@ -133,6 +153,10 @@ void TwoLevelIterator::SkipEmptyDataBlocksBackward() {
       return;
     }
     index_iter_.Prev();
+    if (index_iter_.Valid() && BeforeLowerBound()) {
+      SetDataIterator(nullptr);
+      return;
+    }
     InitDataBlock();
     if (data_iter_.iter() != nullptr) data_iter_.SeekToLast();
   }
@@ -164,8 +188,10 @@ void TwoLevelIterator::InitDataBlock() {
 
 Iterator* NewTwoLevelIterator(Iterator* index_iter,
                               BlockFunction block_function, void* arg,
-                              const ReadOptions& options) {
-  return new TwoLevelIterator(index_iter, block_function, arg, options);
+                              const ReadOptions& options,
+                              const Comparator* comparator) {
+  return new TwoLevelIterator(index_iter, block_function, arg, options,
+                              comparator);
 }
 
 }  // namespace leveldb
@@ -9,6 +9,7 @@
 
 namespace leveldb {
 
+class Comparator;
 struct ReadOptions;
 
 // Return a new two level iterator.  A two-level iterator contains an
@@ -20,11 +21,16 @@ struct ReadOptions;
 //
 // Uses a supplied function to convert an index_iter value into
 // an iterator over the contents of the corresponding block.
+//
+// The keys of index_iter must be >= the keys of their block and < the
+// keys of the following blocks.  Blocks that lie entirely outside the
+// iterate bounds of "options", as ordered by "comparator", are not
+// visited.
 Iterator* NewTwoLevelIterator(
     Iterator* index_iter,
     Iterator* (*block_function)(void* arg, const ReadOptions& options,
                                 const Slice& index_value),
-    void* arg, const ReadOptions& options);
+    void* arg, const ReadOptions& options, const Comparator* comparator);
 
 }  // namespace leveldb
 
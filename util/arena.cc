@@ -4,34 +4,115 @@
 
 #include "util/arena.h"
 
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
 static const int kBlockSize = 4096;
 
-Arena::Arena()
-    : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+static const size_t kHugePageSize = 2 << 20;
+
+size_t ArenaBlockPool::RoundBlockSize(size_t block_size, bool huge_pages) {
+  if (!huge_pages) {
+    return block_size;
+  }
+  return (block_size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+ArenaBlockPool::ArenaBlockPool(size_t block_size, size_t max_cached_blocks,
+                               bool huge_pages, int numa_node)
+    : block_size_(RoundBlockSize(block_size, huge_pages)),
+      max_cached_blocks_(max_cached_blocks),
+      huge_pages_(huge_pages),
+      numa_node_(numa_node) {
+  assert(block_size_ > 0);
+}
+
+ArenaBlockPool::~ArenaBlockPool() {
+  MutexLock l(&mu_);
+  for (char* block : free_blocks_) {
+    FreeBlock(block);
+  }
+  assert(heap_blocks_.empty());
+}
+
+char* ArenaBlockPool::Allocate() {
+  {
+    MutexLock l(&mu_);
+    if (!free_blocks_.empty()) {
+      char* result = free_blocks_.back();
+      free_blocks_.pop_back();
+      return result;
+    }
+  }
+
+  // Map the block without holding mu_ since it may take a while.
+  char* result = port::AllocateLargePages(block_size_, huge_pages_, numa_node_);
+  if (result == nullptr) {
+    result = new char[block_size_];
+    MutexLock l(&mu_);
+    heap_blocks_.push_back(result);
+  }
+  return result;
+}
+
+void ArenaBlockPool::Release(char* block) {
+  MutexLock l(&mu_);
+  if (free_blocks_.size() < max_cached_blocks_) {
+    free_blocks_.push_back(block);
+  } else {
+    FreeBlock(block);
+  }
+}
+
+void ArenaBlockPool::FreeBlock(char* block) {
+  for (size_t i = 0; i < heap_blocks_.size(); i++) {
+    if (heap_blocks_[i] == block) {
+      heap_blocks_[i] = heap_blocks_.back();
+      heap_blocks_.pop_back();
+      delete[] block;
+      return;
+    }
+  }
+  port::FreeLargePages(block, block_size_);
+}
+
+Arena::Arena(ArenaBlockPool* pool)
+    : pool_(pool),
+      block_size_(pool != nullptr ? pool->block_size() : kBlockSize),
+      alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      memory_usage_(0) {}
 
 Arena::~Arena() {
   for (size_t i = 0; i < blocks_.size(); i++) {
     delete[] blocks_[i];
   }
+  for (size_t i = 0; i < pool_blocks_.size(); i++) {
+    pool_->Release(pool_blocks_[i]);
+  }
 }
 
 char* Arena::AllocateFallback(size_t bytes) {
-  if (bytes > kBlockSize / 4) {
+  if (bytes > block_size_ / 4) {
     // Object is more than a quarter of our block size.  Allocate it separately
     // to avoid wasting too much space in leftover bytes.
     char* result = AllocateNewBlock(bytes);
+    if (bytes == block_size_) {
+      // The object takes a whole block from the pool.
+      ChargePoolBytes(bytes);
+    }
     return result;
   }
 
   // We waste the remaining space in the current block.
-  alloc_ptr_ = AllocateNewBlock(kBlockSize);
-  alloc_bytes_remaining_ = kBlockSize;
+  alloc_ptr_ = AllocateNewBlock(block_size_);
+  alloc_bytes_remaining_ = block_size_;
 
   char* result = alloc_ptr_;
   alloc_ptr_ += bytes;
   alloc_bytes_remaining_ -= bytes;
+  ChargePoolBytes(bytes);
   return result;
 }
 
@@ -47,6 +128,7 @@ char* Arena::AllocateAligned(size_t bytes) {
     result = alloc_ptr_ + slop;
     alloc_ptr_ += needed;
     alloc_bytes_remaining_ -= needed;
+    ChargePoolBytes(needed);
   } else {
     // AllocateFallback always returned aligned memory
     result = AllocateFallback(bytes);
@@ -56,8 +138,16 @@ char* Arena::AllocateAligned(size_t bytes) {
 }
 
 char* Arena::AllocateNewBlock(size_t block_bytes) {
-  char* result = new char[block_bytes];
-  blocks_.push_back(result);
+  char* result;
+  if (pool_ != nullptr && block_bytes == block_size_) {
+    result = pool_->Allocate();
+    pool_blocks_.push_back(result);
+    // The bytes carved out of the block are charged as they are handed out.
+    block_bytes = 0;
+  } else {
+    result = new char[block_bytes];
+    blocks_.push_back(result);
+  }
   memory_usage_.fetch_add(block_bytes + sizeof(char*),
                           std::memory_order_relaxed);
   return result;
@@ -11,11 +11,64 @@
 #include <cstdint>
 #include <vector>
 
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
 namespace leveldb {
 
+// A thread-safe source of large, equally sized memory blocks for Arenas.
+// Blocks are obtained directly from the operating system (optionally
+// backed by huge pages and bound to a NUMA node), and blocks released by
+// an Arena are cached and handed to the next Arena instead of being
+// freed.  This keeps memtable memory in a few large, TLB-friendly chunks
+// that are recycled from one memtable to the next.
+class ArenaBlockPool {
+ public:
+  // At most "max_cached_blocks" released blocks are kept for reuse.
+  // If "huge_pages" is true, block_size is rounded up to a multiple of
+  // the huge page size.
+  ArenaBlockPool(size_t block_size, size_t max_cached_blocks, bool huge_pages,
+                 int numa_node);
+
+  ArenaBlockPool(const ArenaBlockPool&) = delete;
+  ArenaBlockPool& operator=(const ArenaBlockPool&) = delete;
+
+  // REQUIRES: All blocks have been released.
+  ~ArenaBlockPool();
+
+  // Return the size of the blocks of a pool created with "block_size" and
+  // "huge_pages".
+  static size_t RoundBlockSize(size_t block_size, bool huge_pages);
+
+  size_t block_size() const { return block_size_; }
+
+  // Return a block of block_size() bytes.
+  char* Allocate();
+
+  // Return a block obtained from Allocate() to the pool.
+  void Release(char* block);
+
+ private:
+  void FreeBlock(char* block) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const size_t block_size_;
+  const size_t max_cached_blocks_;
+  const bool huge_pages_;
+  const int numa_node_;
+
+  port::Mutex mu_;
+  std::vector<char*> free_blocks_ GUARDED_BY(mu_);
+  // Blocks that had to come from the heap because the operating system
+  // refused a direct mapping.  Usually empty.
+  std::vector<char*> heap_blocks_ GUARDED_BY(mu_);
+};
+
 class Arena {
  public:
-  Arena();
+  // If "pool" is non-null, memory is carved out of blocks taken from
+  // *pool, which must outlive the Arena.  Otherwise small blocks are
+  // allocated on the heap.
+  explicit Arena(ArenaBlockPool* pool = nullptr);
 
   Arena(const Arena&) = delete;
   Arena& operator=(const Arena&) = delete;
@@ -38,6 +91,19 @@ class Arena {
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
 
+  // Blocks from pool_ can be much larger than the memory in use, so for
+  // them only the bytes handed out are counted in memory_usage_.
+  void ChargePoolBytes(size_t bytes) {
+    if (pool_ != nullptr) {
+      // Allocation is externally synchronized, so no atomic add is needed.
+      memory_usage_.store(memory_usage_.load(std::memory_order_relaxed) + bytes,
+                          std::memory_order_relaxed);
+    }
+  }
+
+  ArenaBlockPool* const pool_;
+  const size_t block_size_;
+
   // Allocation state
   char* alloc_ptr_;
   size_t alloc_bytes_remaining_;
@@ -45,6 +111,9 @@ class Arena {
   // Array of new[] allocated memory blocks
   std::vector<char*> blocks_;
 
+  // Array of blocks taken from pool_
+  std::vector<char*> pool_blocks_;
+
   // Total memory usage of the arena.
   //
   // TODO(costan): This member is accessed via atomics, but the others are
@@ -61,6 +130,7 @@ inline char* Arena::Allocate(size_t bytes) {
     char* result = alloc_ptr_;
     alloc_ptr_ += bytes;
     alloc_bytes_remaining_ -= bytes;
+    ChargePoolBytes(bytes);
     return result;
   }
   return AllocateFallback(bytes);
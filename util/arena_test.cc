@@ -4,6 +4,8 @@
 
 #include "util/arena.h"
 
+#include <cstring>
+
 #include "gtest/gtest.h"
 #include "util/random.h"
 
@@ -58,6 +60,53 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+TEST(ArenaTest, BlockPool) {
+  ArenaBlockPool pool(64 << 10, 1, false, -1);
+  ASSERT_EQ(64 << 10, pool.block_size());
+
+  char* first;
+  {
+    Arena arena(&pool);
+    first = arena.Allocate(100);
+    std::memset(first, 'a', 100);
+    // Only the memory handed out is charged, not the whole block.
+    ASSERT_GE(arena.MemoryUsage(), 100);
+    ASSERT_LT(arena.MemoryUsage(), 1000);
+
+    // An allocation of a whole block takes one from the pool, and is
+    // charged in full.
+    char* big = arena.Allocate(pool.block_size());
+    std::memset(big, 'b', pool.block_size());
+    ASSERT_GE(arena.MemoryUsage(), pool.block_size() + 100);
+  }
+
+  // The block released by the first arena is handed to the next one.
+  Arena arena(&pool);
+  ASSERT_EQ(first, arena.Allocate(100));
+
+  // Only one block is cached, the others are returned to the system.
+  Arena other(&pool);
+  for (int i = 0; i < 4; i++) {
+    char* r = other.AllocateAligned(pool.block_size() / 4);
+    std::memset(r, 'c', pool.block_size() / 4);
+  }
+}
+
+TEST(ArenaTest, HugePagePool) {
+  // Huge pages may or may not be available; either way the pool must
+  // hand out usable memory of the rounded-up size.
+  ArenaBlockPool pool(64 << 10, 2, true, 0);
+  ASSERT_EQ(2 << 20, pool.block_size());
+  ASSERT_EQ(pool.block_size(), ArenaBlockPool::RoundBlockSize(64 << 10, true));
+  ASSERT_EQ(64 << 10, ArenaBlockPool::RoundBlockSize(64 << 10, false));
+  Arena arena(&pool);
+  for (int i = 0; i < 1000; i++) {
+    char* r = arena.AllocateAligned(1000);
+    std::memset(r, i % 256, 1000);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(r) & (sizeof(void*) - 1));
+  }
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
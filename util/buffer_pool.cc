@@ -0,0 +1,99 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/buffer_pool.h"
+
+#include "util/coding.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// Size classes are multiples of kClassGranularity.  Fine-grained classes
+// keep the rounding overhead low for the common block sizes, which
+// cluster just above the configured block_size.
+const size_t kClassGranularity = 512;
+
+// Every buffer is preceded by a header holding the size of its
+// allocation, excluding the header.  Eight bytes keep the buffer aligned.
+const size_t kHeaderSize = 8;
+
+size_t ClassIndex(size_t allocated_size) {
+  return allocated_size / kClassGranularity - 1;
+}
+
+}  // namespace
+
+BufferPool::BufferPool(size_t max_buffer_size, size_t max_idle_bytes)
+    : num_classes_((max_buffer_size + kClassGranularity - 1) /
+                   kClassGranularity),
+      max_idle_bytes_(max_idle_bytes),
+      classes_(new SizeClass[num_classes_]),
+      idle_bytes_(0) {}
+
+BufferPool::~BufferPool() {
+  for (size_t i = 0; i < num_classes_; i++) {
+    MutexLock l(&classes_[i].mu);
+    for (char* raw : classes_[i].free_list) {
+      delete[] raw;
+    }
+  }
+  delete[] classes_;
+}
+
+char* BufferPool::Allocate(size_t n) {
+  size_t allocated_size = n;
+  if (n > 0 && n <= num_classes_ * kClassGranularity) {
+    allocated_size =
+        (n + kClassGranularity - 1) / kClassGranularity * kClassGranularity;
+    SizeClass* c = &classes_[ClassIndex(allocated_size)];
+    char* raw = nullptr;
+    {
+      MutexLock l(&c->mu);
+      if (!c->free_list.empty()) {
+        raw = c->free_list.back();
+        c->free_list.pop_back();
+      }
+    }
+    if (raw != nullptr) {
+      idle_bytes_.fetch_sub(allocated_size, std::memory_order_relaxed);
+      return raw + kHeaderSize;
+    }
+  }
+
+  char* raw = new char[kHeaderSize + allocated_size];
+  EncodeFixed64(raw, allocated_size);
+  return raw + kHeaderSize;
+}
+
+void BufferPool::Release(char* buf) {
+  char* raw = buf - kHeaderSize;
+  const size_t allocated_size = DecodeFixed64(raw);
+  if (allocated_size == 0 ||
+      allocated_size > num_classes_ * kClassGranularity ||
+      allocated_size % kClassGranularity != 0) {
+    // Not a pooled size.
+    delete[] raw;
+    return;
+  }
+
+  const size_t idle =
+      idle_bytes_.fetch_add(allocated_size, std::memory_order_relaxed);
+  if (idle + allocated_size > max_idle_bytes_) {
+    // The pool is full; give the memory back.
+    idle_bytes_.fetch_sub(allocated_size, std::memory_order_relaxed);
+    delete[] raw;
+    return;
+  }
+  SizeClass* c = &classes_[ClassIndex(allocated_size)];
+  MutexLock l(&c->mu);
+  c->free_list.push_back(raw);
+}
+
+size_t BufferPool::Usage(const char* buf) {
+  return kHeaderSize + DecodeFixed64(buf - kHeaderSize);
+}
+
+}  // namespace leveldb
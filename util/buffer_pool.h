@@ -0,0 +1,65 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_BUFFER_POOL_H_
+#define STORAGE_LEVELDB_UTIL_BUFFER_POOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "port/port.h"
+#include "port/thread_annotations.h"
+
+namespace leveldb {
+
+// A thread-safe cache of heap buffers grouped into size classes.
+//
+// Short-lived buffers of similar sizes, such as the ones used to read and
+// decompress table blocks, are recycled through per-class free lists
+// instead of going back to the heap.  Each buffer remembers its size
+// class, so Release() does not need to be told how large it is.
+class BufferPool {
+ public:
+  // Buffers of up to "max_buffer_size" bytes are pooled; larger ones are
+  // allocated and freed directly.  At most "max_idle_bytes" of released
+  // buffers are kept for reuse.
+  BufferPool(size_t max_buffer_size, size_t max_idle_bytes);
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  ~BufferPool();
+
+  // Return a buffer of at least "n" bytes.
+  char* Allocate(size_t n);
+
+  // Return a buffer obtained from Allocate() to the pool.
+  void Release(char* buf);
+
+  // Returns the number of heap bytes reserved for a buffer returned by
+  // Allocate(), which may be larger than the size that was requested.
+  static size_t Usage(const char* buf);
+
+  // Returns the number of bytes held by released buffers.
+  size_t IdleBytes() const {
+    return idle_bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct SizeClass {
+    port::Mutex mu;
+    std::vector<char*> free_list GUARDED_BY(mu);
+  };
+
+  const size_t num_classes_;
+  const size_t max_idle_bytes_;
+  SizeClass* const classes_;
+  std::atomic<size_t> idle_bytes_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_BUFFER_POOL_H_
@@ -0,0 +1,68 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/buffer_pool.h"
+
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace leveldb {
+
+TEST(BufferPoolTest, ReusesReleasedBuffers) {
+  BufferPool pool(64 << 10, 1 << 20);
+  char* a = pool.Allocate(4000);
+  memset(a, 'a', 4000);
+  ASSERT_EQ(0, pool.IdleBytes());
+  pool.Release(a);
+  ASSERT_GT(pool.IdleBytes(), 0);
+
+  // A request from the same size class gets the same buffer back.
+  char* b = pool.Allocate(3900);
+  ASSERT_EQ(a, b);
+  ASSERT_EQ(0, pool.IdleBytes());
+  ASSERT_GE(BufferPool::Usage(b), 4000);
+
+  // A different size class does not.
+  char* c = pool.Allocate(100);
+  ASSERT_NE(b, c);
+  ASSERT_LT(BufferPool::Usage(c), BufferPool::Usage(b));
+  pool.Release(b);
+  pool.Release(c);
+}
+
+TEST(BufferPoolTest, LargeBuffersAreNotPooled) {
+  BufferPool pool(64 << 10, 1 << 20);
+  char* a = pool.Allocate(1 << 20);
+  memset(a, 'a', 1 << 20);
+  ASSERT_GE(BufferPool::Usage(a), 1 << 20);
+  pool.Release(a);
+  ASSERT_EQ(0, pool.IdleBytes());
+
+  char* empty = pool.Allocate(0);
+  pool.Release(empty);
+  ASSERT_EQ(0, pool.IdleBytes());
+}
+
+TEST(BufferPoolTest, IdleBytesAreBounded) {
+  const size_t kLimit = 64 << 10;
+  BufferPool pool(64 << 10, kLimit);
+  std::vector<char*> buffers;
+  for (int i = 0; i < 100; i++) {
+    buffers.push_back(pool.Allocate(4096));
+  }
+  for (char* buf : buffers) {
+    pool.Release(buf);
+  }
+  ASSERT_LE(pool.IdleBytes(), kLimit);
+  ASSERT_GT(pool.IdleBytes(), kLimit / 2);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,51 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/compaction_filter.h"
+
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+CompactionFilter::~CompactionFilter() = default;
+
+void AppendTTLTimestamp(std::string* value, uint64_t unix_seconds) {
+  PutFixed64(value, unix_seconds);
+}
+
+namespace {
+
+class TTLCompactionFilter : public CompactionFilter {
+ public:
+  TTLCompactionFilter(uint64_t ttl_seconds, Env* env)
+      : ttl_seconds_(ttl_seconds), env_(env) {}
+
+  const char* Name() const override { return "leveldb.TTLCompactionFilter"; }
+
+  bool Filter(int level, const Slice& key, const Slice& value,
+              std::string* new_value, bool* value_changed) const override {
+    if (value.size() < kTTLTimestampSize) {
+      return false;
+    }
+    const uint64_t written =
+        DecodeFixed64(value.data() + value.size() - kTTLTimestampSize);
+    const uint64_t now = env_->NowMicros() / 1000000;
+    return written < now && now - written > ttl_seconds_;
+  }
+
+ private:
+  const uint64_t ttl_seconds_;
+  Env* const env_;
+};
+
+}  // namespace
+
+const CompactionFilter* NewTTLCompactionFilter(uint64_t ttl_seconds,
+                                               Env* env) {
+  return new TTLCompactionFilter(ttl_seconds, env);
+}
+
+}  // namespace leveldb
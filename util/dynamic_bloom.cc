@@ -0,0 +1,79 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/dynamic_bloom.h"
+
+#include <cassert>
+#include <new>
+
+#include "util/arena.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+const size_t kCacheLineSize = 64;
+const uint32_t kWordsPerLine = kCacheLineSize / sizeof(uint32_t);
+const uint32_t kBitsPerLine = kCacheLineSize * 8;
+
+uint32_t BloomHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0xbc9f1d34);
+}
+
+uint32_t NumLines(size_t total_bits) {
+  size_t lines = (total_bits + kBitsPerLine - 1) / kBitsPerLine;
+  return static_cast<uint32_t>(lines == 0 ? 1 : lines);
+}
+
+}  // namespace
+
+DynamicBloom::DynamicBloom(Arena* arena, size_t total_bits, int num_probes)
+    : num_lines_(NumLines(total_bits)), num_probes_(num_probes) {
+  assert(num_probes_ > 0);
+  const size_t bytes = static_cast<size_t>(num_lines_) * kCacheLineSize;
+  // Over-allocate so that the bit array can start on a cache line boundary.
+  char* raw = arena->AllocateAligned(bytes + kCacheLineSize - 1);
+  uintptr_t addr = reinterpret_cast<uintptr_t>(raw);
+  addr = (addr + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+  data_ = reinterpret_cast<std::atomic<uint32_t>*>(addr);
+  for (size_t i = 0; i < num_lines_ * kWordsPerLine; i++) {
+    new (&data_[i]) std::atomic<uint32_t>(0);
+  }
+}
+
+void DynamicBloom::Add(const Slice& key) {
+  uint32_t h = BloomHash(key);
+  // The high bits pick the cache line, the low bits pick positions in it.
+  std::atomic<uint32_t>* line =
+      data_ + ((static_cast<uint64_t>(h) * num_lines_) >> 32) * kWordsPerLine;
+  const uint32_t delta = (h >> 17) | (h << 15);  // Rotate right 17 bits
+  for (int i = 0; i < num_probes_; i++) {
+    const uint32_t bitpos = h % kBitsPerLine;
+    std::atomic<uint32_t>* word = &line[bitpos / 32];
+    // Add() is externally synchronized, so a relaxed read-modify-write
+    // without an atomic instruction is sufficient.
+    word->store(word->load(std::memory_order_relaxed) | (1u << (bitpos % 32)),
+                std::memory_order_relaxed);
+    h += delta;
+  }
+}
+
+bool DynamicBloom::MayContain(const Slice& key) const {
+  uint32_t h = BloomHash(key);
+  const std::atomic<uint32_t>* line =
+      data_ + ((static_cast<uint64_t>(h) * num_lines_) >> 32) * kWordsPerLine;
+  const uint32_t delta = (h >> 17) | (h << 15);  // Rotate right 17 bits
+  for (int i = 0; i < num_probes_; i++) {
+    const uint32_t bitpos = h % kBitsPerLine;
+    if ((line[bitpos / 32].load(std::memory_order_relaxed) &
+         (1u << (bitpos % 32))) == 0) {
+      return false;
+    }
+    h += delta;
+  }
+  return true;
+}
+
+}  // namespace leveldb
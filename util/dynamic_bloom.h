@@ -0,0 +1,51 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// An in-memory bloom filter that can be updated incrementally.  Unlike the
+// filters built by FilterPolicy it is not serialized; it is used to answer
+// "definitely not present" questions for data structures that are still
+// being filled, such as the memtable.
+
+#ifndef STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+#define STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class Arena;
+
+// Thread safety: Add() requires external synchronization.  MayContain()
+// may be called concurrently with Add() and with other readers; a reader
+// racing with Add() for the same key may or may not observe it.
+class DynamicBloom {
+ public:
+  // Allocate a filter of approximately "total_bits" bits from "*arena".
+  // The number of bits is rounded up to a whole number of cache lines,
+  // and all probes for one key are confined to a single cache line so
+  // that a lookup costs at most one cache miss.
+  DynamicBloom(Arena* arena, size_t total_bits, int num_probes = 6);
+
+  DynamicBloom(const DynamicBloom&) = delete;
+  DynamicBloom& operator=(const DynamicBloom&) = delete;
+
+  // Record "key" in the filter.
+  void Add(const Slice& key);
+
+  // Returns false if "key" was definitely never passed to Add().
+  bool MayContain(const Slice& key) const;
+
+ private:
+  const uint32_t num_lines_;
+  const int num_probes_;
+  std::atomic<uint32_t>* data_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
@@ -0,0 +1,76 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/dynamic_bloom.h"
+
+#include "gtest/gtest.h"
+#include "util/arena.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static Slice Key(int i, char* buffer) {
+  EncodeFixed32(buffer, i);
+  return Slice(buffer, sizeof(uint32_t));
+}
+
+TEST(DynamicBloomTest, Empty) {
+  Arena arena;
+  DynamicBloom bloom(&arena, 1024);
+  ASSERT_TRUE(!bloom.MayContain("hello"));
+  ASSERT_TRUE(!bloom.MayContain("world"));
+}
+
+TEST(DynamicBloomTest, Small) {
+  Arena arena;
+  DynamicBloom bloom(&arena, 1024);
+  bloom.Add("hello");
+  bloom.Add("world");
+  ASSERT_TRUE(bloom.MayContain("hello"));
+  ASSERT_TRUE(bloom.MayContain("world"));
+  ASSERT_TRUE(!bloom.MayContain("x"));
+  ASSERT_TRUE(!bloom.MayContain("foo"));
+}
+
+TEST(DynamicBloomTest, TinyFilterStillWorks) {
+  // Requests for fewer bits than one cache line are rounded up.
+  Arena arena;
+  DynamicBloom bloom(&arena, 0);
+  bloom.Add("hello");
+  ASSERT_TRUE(bloom.MayContain("hello"));
+}
+
+TEST(DynamicBloomTest, FalsePositiveRate) {
+  char buffer[sizeof(int)];
+  for (int length = 1000; length <= 100000; length *= 10) {
+    Arena arena;
+    DynamicBloom bloom(&arena, length * 10);
+    for (int i = 0; i < length; i++) {
+      bloom.Add(Key(i, buffer));
+    }
+
+    // All added keys must match
+    for (int i = 0; i < length; i++) {
+      ASSERT_TRUE(bloom.MayContain(Key(i, buffer)))
+          << "Length " << length << "; key " << i;
+    }
+
+    int false_positives = 0;
+    for (int i = 0; i < 10000; i++) {
+      if (bloom.MayContain(Key(i + 1000000000, buffer))) {
+        false_positives++;
+      }
+    }
+    // Confining probes to a cache line costs a little accuracy compared
+    // to the table filters, so allow a slightly higher rate.
+    ASSERT_LE(false_positives / 10000.0, 0.03) << "Length " << length;
+  }
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
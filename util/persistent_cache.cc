@@ -0,0 +1,318 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+PersistentCache::~PersistentCache() {}
+
+namespace {
+
+// Every entry is stored as the masked crc32c of its contents followed by
+// the contents, so that entries damaged on the cache device are detected.
+const size_t kEntryHeaderSize = 4;
+
+const char kCacheFileSuffix[] = ".pcache";
+
+std::string CacheFileName(const std::string& dir, uint64_t number) {
+  char buf[100];
+  std::snprintf(buf, sizeof(buf), "/%06llu%s",
+                static_cast<unsigned long long>(number), kCacheFileSuffix);
+  return dir + buf;
+}
+
+bool IsCacheFileName(const std::string& name) {
+  const size_t suffix_size = sizeof(kCacheFileSuffix) - 1;
+  return name.size() > suffix_size &&
+         name.compare(name.size() - suffix_size, suffix_size,
+                      kCacheFileSuffix) == 0;
+}
+
+// Entries are appended to an in-memory buffer that is written out as one
+// cache file once it is full.  Space is reclaimed by dropping the oldest
+// file, so the device only ever sees large sequential writes.  The files
+// are written by a thread of their own, so that inserts made on the read
+// path never wait for the device.
+class FilePersistentCache : public PersistentCache {
+ public:
+  FilePersistentCache(Env* env, const std::string& dir, uint64_t capacity)
+      : env_(env),
+        dir_(dir),
+        capacity_(capacity),
+        file_size_(std::min<uint64_t>(
+            std::max<uint64_t>(capacity / 16, 64 << 10), 4 << 20)),
+        work_cv_(&mu_),
+        last_id_(0),
+        next_file_number_(1),
+        usage_(0),
+        writer_running_(false),
+        shutting_down_(false) {}
+
+  ~FilePersistentCache() override {
+    MutexLock l(&mu_);
+    shutting_down_ = true;
+    work_cv_.SignalAll();
+    while (writer_running_) {
+      work_cv_.Wait();
+    }
+    for (CacheFile* f : files_to_write_) {
+      Unref(f);
+    }
+    while (!files_.empty()) {
+      DropFile(files_.front());
+    }
+  }
+
+  // Remove the files of earlier instances and start the first file.
+  Status Open() {
+    env_->CreateDir(dir_);  // In case it does not exist
+    std::vector<std::string> children;
+    Status s = env_->GetChildren(dir_, &children);
+    if (!s.ok()) {
+      return s;
+    }
+    for (const std::string& child : children) {
+      if (IsCacheFileName(child)) {
+        env_->RemoveFile(dir_ + "/" + child);
+      }
+    }
+    MutexLock l(&mu_);
+    StartFile();
+    writer_running_ = true;
+    env_->StartThread(&FilePersistentCache::WriterMain, this);
+    return Status::OK();
+  }
+
+  Status Insert(const Slice& key, const Slice& data) override {
+    std::string k = key.ToString();
+    MutexLock l(&mu_);
+    if (index_.count(k) != 0) {
+      return Status::OK();
+    }
+
+    CacheFile* f = files_.back();
+    Location loc;
+    loc.file = f;
+    loc.offset = f->buffer.size();
+    loc.size = kEntryHeaderSize + data.size();
+    PutFixed32(&f->buffer, crc32c::Mask(crc32c::Value(data.data(),
+                                                      data.size())));
+    f->buffer.append(data.data(), data.size());
+    f->keys.push_back(k);
+    index_.emplace(std::move(k), loc);
+    usage_ += loc.size;
+
+    if (f->buffer.size() >= file_size_) {
+      StartFile();
+      f->refs++;
+      files_to_write_.push_back(f);
+      work_cv_.SignalAll();
+    }
+    while (usage_ > capacity_ && files_.size() > 1) {
+      DropFile(files_.front());
+    }
+    return Status::OK();
+  }
+
+  Status Lookup(const Slice& key, std::string* data) override {
+    std::string entry;
+    mu_.Lock();
+    auto it = index_.find(key.ToString());
+    if (it == index_.end()) {
+      mu_.Unlock();
+      return Status::NotFound(Slice());
+    }
+    const Location loc = it->second;
+    CacheFile* f = loc.file;
+    Status s;
+    if (f->reader == nullptr) {
+      // Not written out yet
+      entry.assign(f->buffer.data() + loc.offset, loc.size);
+      mu_.Unlock();
+    } else {
+      f->refs++;
+      mu_.Unlock();
+      entry.resize(loc.size);
+      Slice result;
+      s = f->reader->Read(loc.offset, loc.size, &result, &entry[0]);
+      if (s.ok() && result.size() != loc.size) {
+        s = Status::Corruption("truncated persistent cache entry");
+      } else if (s.ok() && result.data() != entry.data()) {
+        entry.assign(result.data(), result.size());
+      }
+      MutexLock l(&mu_);
+      Unref(f);
+    }
+    if (!s.ok()) {
+      return s;
+    }
+
+    const uint32_t crc = crc32c::Unmask(DecodeFixed32(entry.data()));
+    if (crc32c::Value(entry.data() + kEntryHeaderSize,
+                      entry.size() - kEntryHeaderSize) != crc) {
+      return Status::Corruption("persistent cache entry checksum mismatch");
+    }
+    data->assign(entry.data() + kEntryHeaderSize,
+                 entry.size() - kEntryHeaderSize);
+    return Status::OK();
+  }
+
+  uint64_t NewId() override {
+    MutexLock l(&mu_);
+    return ++last_id_;
+  }
+
+ private:
+  // A cache file.  Its entries are served from "buffer" until the file
+  // has been written out, and from "reader" afterwards.
+  struct CacheFile {
+    uint64_t number;
+    std::string buffer;
+    RandomAccessFile* reader;
+    std::vector<std::string> keys;  // Keys of the entries in this file
+    bool live;                      // Still in files_
+    int refs;
+  };
+
+  struct Location {
+    CacheFile* file;
+    uint64_t offset;
+    size_t size;
+  };
+
+  void StartFile() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    CacheFile* f = new CacheFile;
+    f->number = next_file_number_++;
+    f->reader = nullptr;
+    f->live = true;
+    f->refs = 1;
+    files_.push_back(f);
+  }
+
+  static void WriterMain(void* arg) {
+    reinterpret_cast<FilePersistentCache*>(arg)->WriteFiles();
+  }
+
+  // Write out the full buffers queued by Insert() until shutdown.
+  void WriteFiles() {
+    MutexLock l(&mu_);
+    while (!shutting_down_) {
+      if (files_to_write_.empty()) {
+        work_cv_.Wait();
+        continue;
+      }
+      CacheFile* f = files_to_write_.front();
+      files_to_write_.pop_front();
+      WriteFile(f);
+    }
+    writer_running_ = false;
+    work_cv_.SignalAll();
+  }
+
+  // Write out the full buffer of "f", which holds a reference for the
+  // writer.  Entries are served from the buffer until then.  The lock is
+  // released while writing.
+  void WriteFile(CacheFile* f) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const std::string fname = CacheFileName(dir_, f->number);
+    mu_.Unlock();
+
+    WritableFile* file;
+    Status s = env_->NewWritableFile(fname, &file);
+    if (s.ok()) {
+      s = file->Append(f->buffer);
+      if (s.ok()) {
+        s = file->Close();
+      }
+      delete file;
+    }
+    RandomAccessFile* reader = nullptr;
+    if (s.ok()) {
+      s = env_->NewRandomAccessFile(fname, &reader);
+    }
+    if (!s.ok()) {
+      env_->RemoveFile(fname);
+    }
+
+    mu_.Lock();
+    if (s.ok()) {
+      f->reader = reader;
+      std::string().swap(f->buffer);
+    } else if (f->live) {
+      DropFile(f);  // Its entries leave with the buffer
+    }
+    Unref(f);
+  }
+
+  // Remove the entries of "f" from the cache.
+  void DropFile(CacheFile* f) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    for (const std::string& k : f->keys) {
+      auto it = index_.find(k);
+      if (it != index_.end() && it->second.file == f) {
+        usage_ -= it->second.size;
+        index_.erase(it);
+      }
+    }
+    files_.erase(std::find(files_.begin(), files_.end(), f));
+    f->live = false;
+    Unref(f);
+  }
+
+  void Unref(CacheFile* f) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (--f->refs == 0) {
+      if (f->reader != nullptr) {
+        delete f->reader;
+        env_->RemoveFile(CacheFileName(dir_, f->number));
+      }
+      delete f;
+    }
+  }
+
+  Env* const env_;
+  const std::string dir_;
+  const uint64_t capacity_;
+  const uint64_t file_size_;  // Size at which a buffer is written out
+
+  port::Mutex mu_;
+  port::CondVar work_cv_;  // Signaled when files_to_write_ or shutdown change
+  uint64_t last_id_ GUARDED_BY(mu_);
+  uint64_t next_file_number_ GUARDED_BY(mu_);
+  uint64_t usage_ GUARDED_BY(mu_);  // Total size of the indexed entries
+  std::deque<CacheFile*> files_ GUARDED_BY(mu_);  // Oldest first
+  std::unordered_map<std::string, Location> index_ GUARDED_BY(mu_);
+  std::deque<CacheFile*> files_to_write_ GUARDED_BY(mu_);
+  bool writer_running_ GUARDED_BY(mu_);
+  bool shutting_down_ GUARDED_BY(mu_);
+};
+
+}  // namespace
+
+Status NewFilePersistentCache(Env* env, const std::string& dir,
+                              uint64_t capacity, PersistentCache** result) {
+  *result = nullptr;
+  FilePersistentCache* cache = new FilePersistentCache(env, dir, capacity);
+  Status s = cache->Open();
+  if (s.ok()) {
+    *result = cache;
+  } else {
+    delete cache;
+  }
+  return s;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,126 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/testutil.h"
+
+namespace leveldb {
+
+static std::string Key(int k) {
+  std::string result;
+  PutFixed32(&result, k);
+  return result;
+}
+
+// Entries of about 4KB, the size of a typical block.
+static std::string Value(int k) {
+  return std::string(4000 + k % 200, static_cast<char>('a' + k % 26));
+}
+
+class PersistentCacheTest : public testing::Test {
+ public:
+  PersistentCacheTest()
+      : env_(Env::Default()),
+        dir_(testing::TempDir() + "persistent_cache_test"),
+        cache_(nullptr) {}
+
+  ~PersistentCacheTest() { delete cache_; }
+
+  void Open(uint64_t capacity) {
+    delete cache_;
+    cache_ = nullptr;
+    ASSERT_LEVELDB_OK(NewFilePersistentCache(env_, dir_, capacity, &cache_));
+  }
+
+  std::string Lookup(int k) {
+    std::string data;
+    Status s = cache_->Lookup(Key(k), &data);
+    if (s.IsNotFound()) {
+      return "NOT_FOUND";
+    }
+    return s.ok() ? data : s.ToString();
+  }
+
+  int CountCacheFiles() {
+    std::vector<std::string> children;
+    env_->GetChildren(dir_, &children);
+    int count = 0;
+    for (const std::string& child : children) {
+      if (child.find(".pcache") != std::string::npos) count++;
+    }
+    return count;
+  }
+
+  Env* const env_;
+  const std::string dir_;
+  PersistentCache* cache_;
+};
+
+TEST_F(PersistentCacheTest, InsertAndLookup) {
+  Open(16 << 20);
+  ASSERT_EQ("NOT_FOUND", Lookup(1));
+  ASSERT_LEVELDB_OK(cache_->Insert(Key(1), Value(1)));
+  ASSERT_LEVELDB_OK(cache_->Insert(Key(2), Value(2)));
+  ASSERT_EQ(Value(1), Lookup(1));
+  ASSERT_EQ(Value(2), Lookup(2));
+  ASSERT_EQ("NOT_FOUND", Lookup(3));
+
+  // Blocks do not change, so a second insert is ignored.
+  ASSERT_LEVELDB_OK(cache_->Insert(Key(1), "other"));
+  ASSERT_EQ(Value(1), Lookup(1));
+  ASSERT_NE(cache_->NewId(), cache_->NewId());
+}
+
+TEST_F(PersistentCacheTest, EntriesAreWrittenToFiles) {
+  Open(16 << 20);
+  const int kNumEntries = 1000;  // About 4MB
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_LEVELDB_OK(cache_->Insert(Key(i), Value(i)));
+  }
+  // Full buffers are written out in the background.
+  for (int i = 0; i < 1000 && CountCacheFiles() <= 1; i++) {
+    env_->SleepForMicroseconds(10000);
+  }
+  ASSERT_GT(CountCacheFiles(), 1);
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(Value(i), Lookup(i));
+  }
+
+  // A new instance starts out empty.
+  Open(16 << 20);
+  ASSERT_EQ(0, CountCacheFiles());
+  ASSERT_EQ("NOT_FOUND", Lookup(0));
+}
+
+TEST_F(PersistentCacheTest, OldestEntriesAreEvicted) {
+  const uint64_t kCapacity = 1 << 20;
+  Open(kCapacity);
+  const int kNumEntries = 2000;  // About 8MB
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_LEVELDB_OK(cache_->Insert(Key(i), Value(i)));
+  }
+  ASSERT_EQ("NOT_FOUND", Lookup(0));
+  ASSERT_EQ(Value(kNumEntries - 1), Lookup(kNumEntries - 1));
+
+  int found = 0;
+  for (int i = 0; i < kNumEntries; i++) {
+    if (Lookup(i) != "NOT_FOUND") found++;
+  }
+  ASSERT_LE(found * 4000, kCapacity);
+  ASSERT_GT(found * 4200, kCapacity / 2);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}